@@ -0,0 +1,9 @@
+#!/bin/bash
+
+set -e
+mkdir -p build
+cd build
+cmake -DCMAKE_BUILD_TYPE=Release ..
+make -j4 learnopengl_bench
+cd learnopengl
+./learnopengl_bench "$@"
@@ -0,0 +1,36 @@
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+
+static void BM_CameraViewMatrix(benchmark::State &state) {
+  Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+  while (state.KeepRunning()) {
+    glm::mat4 view = camera.getViewMatrix();
+    benchmark::DoNotOptimize(view);
+  }
+}
+BENCHMARK(BM_CameraViewMatrix);
+
+static void BM_CameraProjectionMatrix(benchmark::State &state) {
+  Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+  while (state.KeepRunning()) {
+    glm::mat4 projection =
+        camera.getProjectionMatrix(800.0f / 600.0f, 0.1f, 100.0f);
+    benchmark::DoNotOptimize(projection);
+  }
+}
+BENCHMARK(BM_CameraProjectionMatrix);
+
+// processMouseMovement recomputes the camera vectors through
+// updateCameraVectors, the trigonometry dominates
+static void BM_CameraUpdateVectors(benchmark::State &state) {
+  Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
+  float offset = 1.0f;
+  while (state.KeepRunning()) {
+    camera.processMouseMovement(offset, offset * 0.5f);
+    offset = -offset;
+    benchmark::DoNotOptimize(camera.front);
+  }
+}
+BENCHMARK(BM_CameraUpdateVectors);
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "culling.h"
+#include "scene_graph.h"
+
+using namespace std;
+
+// A synthetic scene of count unit boxes scattered around the camera, of
+// which about a tenth are inside the view
+struct SyntheticScene {
+  vector<AABB> bounds;
+  vector<glm::mat4> transforms;
+  Frustum frustum;
+  glm::vec3 cameraPosition;
+
+  explicit SyntheticScene(unsigned int count) : cameraPosition(0.0f) {
+    mt19937 random(count);
+    uniform_real_distribution<float> position(-100.0f, 100.0f);
+    AABB unit;
+    unit.min = glm::vec3(-0.5f);
+    unit.max = glm::vec3(0.5f);
+    for (unsigned int i = 0; i < count; i++) {
+      glm::mat4 transform = glm::translate(
+          glm::mat4(1.0f),
+          glm::vec3(position(random), position(random), position(random)));
+      transforms.push_back(transform);
+      bounds.push_back(transformBounds(unit, transform));
+    }
+    glm::mat4 view =
+        glm::lookAt(cameraPosition, glm::vec3(0.0f, 0.0f, -1.0f),
+                    glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection =
+        glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    frustum = extractFrustum(projection * view);
+  }
+};
+
+// culling world space bounds
+static void BM_CullBounds(benchmark::State &state) {
+  SyntheticScene scene(state.range(0));
+  vector<unsigned int> visible;
+  visible.reserve(scene.bounds.size());
+  while (state.KeepRunning()) {
+    cullBounds(scene.frustum, scene.bounds, visible);
+    benchmark::DoNotOptimize(visible.data());
+  }
+  state.SetItemsProcessed(state.iterations() * scene.bounds.size());
+  state.counters["visible"] = visible.size();
+}
+BENCHMARK(BM_CullBounds)->Range(1 << 10, 1 << 20);
+
+// culling local bounds, moving each into world space first as Model::Draw
+// does
+static void BM_TransformAndCullBounds(benchmark::State &state) {
+  SyntheticScene scene(state.range(0));
+  AABB unit;
+  unit.min = glm::vec3(-0.5f);
+  unit.max = glm::vec3(0.5f);
+  unsigned int visible = 0;
+  while (state.KeepRunning()) {
+    visible = 0;
+    for (unsigned int i = 0; i < scene.transforms.size(); i++) {
+      visible += isVisible(scene.frustum,
+                           transformBounds(unit, scene.transforms[i]));
+    }
+    benchmark::DoNotOptimize(visible);
+  }
+  state.SetItemsProcessed(state.iterations() * scene.transforms.size());
+}
+BENCHMARK(BM_TransformAndCullBounds)->Range(1 << 10, 1 << 20);
+
+// the CPU side of InstanceBatch's culling: 16 meshes per instance, as many
+// as the nanosuit has
+static void BM_CullInstances(benchmark::State &state) {
+  SyntheticScene scene(state.range(0));
+  const unsigned int meshCount = 16;
+  vector<AABB> meshBounds(meshCount);
+  vector<glm::mat4> meshTransforms(meshCount);
+  for (unsigned int i = 0; i < meshCount; i++) {
+    meshBounds[i].min = glm::vec3(-0.5f);
+    meshBounds[i].max = glm::vec3(0.5f);
+    meshTransforms[i] =
+        glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, i * 0.1f, 0.0f));
+  }
+  vector<unsigned int> visible;
+  while (state.KeepRunning()) {
+    cullInstances(scene.frustum, meshBounds, meshTransforms, scene.transforms,
+                  visible);
+    benchmark::DoNotOptimize(visible.data());
+  }
+  state.SetItemsProcessed(state.iterations() * scene.transforms.size() *
+                          meshCount);
+  state.counters["visible"] = visible.size();
+}
+BENCHMARK(BM_CullInstances)->Range(1 << 10, 1 << 16);
+
+// draw items of the visible objects, 16 materials, front to back
+static vector<DrawItem> visibleDrawItems(const SyntheticScene &scene) {
+  vector<unsigned int> visible;
+  cullBounds(scene.frustum, scene.bounds, visible);
+  vector<DrawItem> items(visible.size());
+  for (unsigned int i = 0; i < visible.size(); i++) {
+    const AABB &box = scene.bounds[visible[i]];
+    glm::vec3 center = (box.min + box.max) * 0.5f;
+    items[i].key =
+        makeSortKey(visible[i] % 16, glm::length(center - scene.cameraPosition));
+    items[i].index = visible[i];
+  }
+  return items;
+}
+
+static void BM_SortDrawItems(benchmark::State &state) {
+  SyntheticScene scene(state.range(0));
+  vector<DrawItem> unsorted = visibleDrawItems(scene);
+  vector<DrawItem> items;
+  while (state.KeepRunning()) {
+    items = unsorted;
+    sortDrawItems(items);
+    benchmark::DoNotOptimize(items.data());
+  }
+  state.SetItemsProcessed(state.iterations() * unsorted.size());
+}
+BENCHMARK(BM_SortDrawItems)->Range(1 << 10, 1 << 20);
+
+static bool keyLess(const DrawItem &a, const DrawItem &b) {
+  return a.key < b.key;
+}
+
+// the comparison sort sortDrawItems replaces for larger lists, as a baseline
+static void BM_StableSortDrawItems(benchmark::State &state) {
+  SyntheticScene scene(state.range(0));
+  vector<DrawItem> unsorted = visibleDrawItems(scene);
+  vector<DrawItem> items;
+  while (state.KeepRunning()) {
+    items = unsorted;
+    stable_sort(items.begin(), items.end(), keyLess);
+    benchmark::DoNotOptimize(items.data());
+  }
+  state.SetItemsProcessed(state.iterations() * unsorted.size());
+}
+BENCHMARK(BM_StableSortDrawItems)->Range(1 << 10, 1 << 20);
+
+// nodes per object of the scene graph benchmark, about a small skeleton
+const unsigned int SCENE_GRAPH_OBJECT_NODES = 16;
+
+// A frame of moving nodes: range(0) nodes in objects of
+// SCENE_GRAPH_OBJECT_NODES, of which range(1) percent, picked at random, get
+// a new local transform before SceneGraph::update propagates them and their
+// subtrees
+static void BM_UpdateSceneGraph(benchmark::State &state) {
+  unsigned int count = state.range(0);
+  mt19937 random(count);
+  bernoulli_distribution moves(state.range(1) / 100.0);
+  SceneGraph graph;
+  graph.reserve(count);
+  vector<unsigned int> moving;
+  for (unsigned int i = 0; i < count; i++) {
+    unsigned int first = i - i % SCENE_GRAPH_OBJECT_NODES;
+    int parent = SceneGraph::NO_PARENT;
+    if (i != first) {
+      parent = uniform_int_distribution<int>(first, i - 1)(random);
+    }
+    graph.addNode(parent, glm::translate(glm::mat4(1.0f),
+                                         glm::vec3(0.0f, 0.1f, 0.0f)));
+    if (moves(random)) {
+      moving.push_back(i);
+    }
+  }
+  graph.update();
+  float angle = 0.0f;
+  while (state.KeepRunning()) {
+    angle += 0.01f;
+    glm::mat4 local =
+        glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+    for (unsigned int i = 0; i < moving.size(); i++) {
+      graph.setLocal(moving[i], local);
+    }
+    graph.update();
+    benchmark::DoNotOptimize(graph.getWorld(count - 1));
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["moving"] = moving.size();
+}
+BENCHMARK(BM_UpdateSceneGraph)
+    ->Args({100000, 0})
+    ->Args({100000, 1})
+    ->Args({100000, 10})
+    ->Args({100000, 50})
+    ->Args({100000, 100})
+    ->Unit(benchmark::kMicrosecond);
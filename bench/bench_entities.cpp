@@ -0,0 +1,104 @@
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "entities.h"
+#include "job_pool.h"
+
+using namespace std;
+
+// count unit boxes scattered around the origin, a third of them with a
+// physics body so they are split over two archetypes
+static void addEntities(EntityStore &entities, unsigned int count) {
+  mt19937 random(count);
+  uniform_real_distribution<float> position(-100.0f, 100.0f);
+  ComponentMask components = componentMask<Transform>() |
+                             componentMask<Renderable>() |
+                             componentMask<Bounds>();
+  for (unsigned int i = 0; i < count; i++) {
+    Entity entity = entities.create(
+        i % 3 == 0 ? components | componentMask<PhysicsBody>() : components);
+    entities.get<Transform>(entity)->world = glm::translate(
+        glm::mat4(1.0f),
+        glm::vec3(position(random), position(random), position(random)));
+    Bounds *bounds = entities.get<Bounds>(entity);
+    bounds->local.min = glm::vec3(-0.5f);
+    bounds->local.max = glm::vec3(0.5f);
+  }
+}
+
+// a linear pass over one component of every entity
+static void BM_IterateTransforms(benchmark::State &state) {
+  EntityStore entities;
+  addEntities(entities, state.range(0));
+  vector<ChunkView> chunks;
+  while (state.KeepRunning()) {
+    entities.chunks(componentMask<Transform>(), chunks);
+    float sum = 0.0f;
+    for (unsigned int i = 0; i < chunks.size(); i++) {
+      const Transform *transforms = chunks[i].get<Transform>();
+      for (unsigned int j = 0; j < chunks[i].size(); j++) {
+        sum += transforms[j].world[3].x;
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * entities.size());
+}
+BENCHMARK(BM_IterateTransforms)->Range(1 << 10, 1 << 18);
+
+static void BM_UpdateWorldBounds(benchmark::State &state) {
+  EntityStore entities;
+  addEntities(entities, state.range(0));
+  JobPool pool;
+  while (state.KeepRunning()) {
+    updateWorldBounds(entities, pool);
+  }
+  state.SetItemsProcessed(state.iterations() * entities.size());
+  state.counters["threads"] = pool.size() + 1;
+}
+BENCHMARK(BM_UpdateWorldBounds)->Range(1 << 10, 1 << 18);
+
+static void BM_CullEntities(benchmark::State &state) {
+  EntityStore entities;
+  addEntities(entities, state.range(0));
+  JobPool pool;
+  updateWorldBounds(entities, pool);
+  glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f),
+                               glm::vec3(0.0f, 1.0f, 0.0f));
+  glm::mat4 projection =
+      glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+  Frustum frustum = extractFrustum(projection * view);
+  vector<Entity> visible;
+  while (state.KeepRunning()) {
+    cullEntities(entities, componentMask<Renderable>(), frustum, pool,
+                 visible);
+    benchmark::DoNotOptimize(visible.data());
+  }
+  state.SetItemsProcessed(state.iterations() * entities.size());
+  state.counters["visible"] = visible.size();
+}
+BENCHMARK(BM_CullEntities)->Range(1 << 10, 1 << 18);
+
+// creating entities and destroying every other one, moving the last ones of
+// their archetype into the holes
+static void BM_CreateDestroyEntities(benchmark::State &state) {
+  vector<Entity> created(state.range(0));
+  ComponentMask components =
+      componentMask<Transform>() | componentMask<Bounds>();
+  while (state.KeepRunning()) {
+    EntityStore entities;
+    for (unsigned int i = 0; i < created.size(); i++) {
+      created[i] = entities.create(components);
+    }
+    for (unsigned int i = 0; i < created.size(); i += 2) {
+      entities.destroy(created[i]);
+    }
+    benchmark::DoNotOptimize(entities.size());
+  }
+  state.SetItemsProcessed(state.iterations() * created.size());
+}
+BENCHMARK(BM_CreateDestroyEntities)->Range(1 << 10, 1 << 18);
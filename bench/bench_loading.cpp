@@ -0,0 +1,265 @@
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <assimp/Exporter.hpp>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <benchmark/benchmark.h>
+#include <stb_image.h>
+
+#include "job_pool.h"
+#include "model.h"
+#include "obj_loader.h"
+
+using namespace std;
+
+static string resourcePath(const string &path) {
+  return string(PROJECT_SOURCE_DIR) + "/" + path;
+}
+
+// Decoding done by loadTexture, without reading the file or uploading
+static void BM_DecodeTexture(benchmark::State &state, const char *path) {
+  ifstream file(resourcePath(path).c_str(), ios::binary);
+  vector<unsigned char> bytes((istreambuf_iterator<char>(file)),
+                              istreambuf_iterator<char>());
+  if (bytes.empty()) {
+    state.SkipWithError("can't read texture");
+    return;
+  }
+  int width = 0, height = 0, components = 0;
+  while (state.KeepRunning()) {
+    unsigned char *data = stbi_load_from_memory(
+        &bytes[0], bytes.size(), &width, &height, &components, 0);
+    benchmark::DoNotOptimize(data);
+    stbi_image_free(data);
+  }
+  state.SetItemsProcessed(state.iterations() * width * height);
+  state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK_CAPTURE(BM_DecodeTexture, container_jpg,
+                  "resources/textures/container.jpg")
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DecodeTexture, container2_png,
+                  "resources/textures/container2.png")
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_DecodeTexture, nanosuit_body_png,
+                  "resources/objects/nanosuit/body_dif.png")
+    ->Unit(benchmark::kMillisecond);
+
+// Writes a grid OBJ file with about the given number of triangles, once,
+// split into bands of rows that each become an object of their own. It is
+// written under a temporary name and renamed when complete, so a run cut
+// short never leaves a truncated file behind to be reused. Returns an empty
+// string if the file can't be written.
+static string gridObj(unsigned int triangles, unsigned int objects = 1) {
+  ostringstream name;
+  name << "bench_grid_" << triangles;
+  if (objects > 1) {
+    name << "_" << objects;
+  }
+  name << ".obj";
+  if (ifstream(name.str().c_str())) {
+    return name.str();
+  }
+  unsigned int side = 2;
+  while ((side - 1) * (side - 1) * 2 < triangles) {
+    side++;
+  }
+  string partial = name.str() + ".partial";
+  FILE *file = fopen(partial.c_str(), "w");
+  if (!file) {
+    return string();
+  }
+  bool written = true;
+  for (unsigned int y = 0; y < side && written; y++) {
+    for (unsigned int x = 0; x < side && written; x++) {
+      written = fprintf(file, "v %f %f %f\nvt %f %f\n", x * 0.01f, y * 0.01f,
+                        (x * y % 7) * 0.001f, (float)x / side,
+                        (float)y / side) > 0;
+    }
+  }
+  written = written && fprintf(file, "vn 0 0 1\n") > 0;
+  unsigned int rowsPerObject = (side - 2) / objects + 1;
+  for (unsigned int y = 0; y + 1 < side && written; y++) {
+    if (y % rowsPerObject == 0) {
+      written = fprintf(file, "o grid%u\n", y / rowsPerObject) > 0;
+    }
+    for (unsigned int x = 0; x + 1 < side && written; x++) {
+      unsigned int a = y * side + x + 1, b = a + 1, c = a + side, d = c + 1;
+      written = fprintf(file,
+                        "f %u/%u/1 %u/%u/1 %u/%u/1\n"
+                        "f %u/%u/1 %u/%u/1 %u/%u/1\n",
+                        a, a, b, b, d, d, a, a, d, d, c, c) > 0;
+    }
+  }
+  // fclose flushes what is still buffered, which may fail as well
+  written = fclose(file) == 0 && written;
+  if (!written || rename(partial.c_str(), name.str().c_str()) != 0) {
+    remove(partial.c_str());
+    return string();
+  }
+  return name.str();
+}
+
+// The native OBJ path of Model::import, without the texture decoding
+static void BM_LoadObj(benchmark::State &state, const string &path) {
+  if (path.empty()) {
+    state.SkipWithError("can't write OBJ");
+    return;
+  }
+  while (state.KeepRunning()) {
+    ObjScene scene;
+    if (!loadObj(path, scene, sharedJobPool())) {
+      state.SkipWithError("can't load OBJ");
+      return;
+    }
+    benchmark::DoNotOptimize(scene.meshes.data());
+  }
+}
+
+// Assimp's import of the same file with the flags Model::import uses
+static void BM_ImportAssimp(benchmark::State &state, const string &path) {
+  if (path.empty()) {
+    state.SkipWithError("can't write OBJ");
+    return;
+  }
+  while (state.KeepRunning()) {
+    Assimp::Importer importer;
+    const aiScene *scene = importer.ReadFile(
+        path, aiProcess_Triangulate | aiProcess_FlipUVs |
+                  aiProcess_CalcTangentSpace | aiProcess_LimitBoneWeights);
+    if (!scene) {
+      state.SkipWithError("can't import");
+      return;
+    }
+    benchmark::DoNotOptimize(scene);
+  }
+}
+
+static void BM_LoadObjNanosuit(benchmark::State &state) {
+  BM_LoadObj(state, resourcePath("resources/objects/nanosuit/nanosuit.obj"));
+}
+BENCHMARK(BM_LoadObjNanosuit)->Unit(benchmark::kMillisecond);
+
+static void BM_ImportAssimpNanosuit(benchmark::State &state) {
+  BM_ImportAssimp(state,
+                  resourcePath("resources/objects/nanosuit/nanosuit.obj"));
+}
+BENCHMARK(BM_ImportAssimpNanosuit)->Unit(benchmark::kMillisecond);
+
+// synthetic models, the argument is the triangle count. The largest file is
+// close to 500 MB.
+static void BM_LoadObjGrid(benchmark::State &state) {
+  BM_LoadObj(state, gridObj(state.range(0)));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_LoadObjGrid)
+    ->Arg(100000)
+    ->Arg(1000000)
+    ->Arg(6000000)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ImportAssimpGrid(benchmark::State &state) {
+  BM_ImportAssimp(state, gridObj(state.range(0)));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ImportAssimpGrid)
+    ->Arg(100000)
+    ->Arg(1000000)
+    ->Arg(6000000)
+    ->Unit(benchmark::kMillisecond);
+
+// Writes the scene Assimp reads from source to name as an Assimp binary file,
+// once, so that Model::import goes through importAssimp rather than loadObj.
+// Returns an empty string if it can't be written.
+static string assimpCopy(const string &source, const string &name) {
+  if (ifstream(name.c_str())) {
+    return name;
+  }
+  if (source.empty()) {
+    return string();
+  }
+  Assimp::Importer importer;
+  const aiScene *scene = importer.ReadFile(source, 0);
+  if (!scene) {
+    return string();
+  }
+  string partial = name + ".partial";
+  Assimp::Exporter exporter;
+  if (exporter.Export(scene, "assbin", partial) != aiReturn_SUCCESS ||
+      rename(partial.c_str(), name.c_str()) != 0) {
+    remove(partial.c_str());
+    return string();
+  }
+  return name;
+}
+
+// Model::import without texture arrays, so without decoding textures or
+// touching OpenGL. The meshes are parsed and converted on the shared pool,
+// or all on the calling thread when range(0) is 0.
+static void BM_ImportModel(benchmark::State &state, const string &path) {
+  if (path.empty()) {
+    state.SkipWithError("can't write model");
+    return;
+  }
+  JobPool serial(NO_WORKER_THREADS);
+  JobPool &pool = state.range(0) ? sharedJobPool() : serial;
+  while (state.KeepRunning()) {
+    Model model;
+    if (!model.import(path, pool)) {
+      state.SkipWithError("can't import");
+      return;
+    }
+    benchmark::DoNotOptimize(model.cpuBytes());
+  }
+  state.counters["threads"] = pool.size() + 1;
+}
+
+// the nanosuit's 7 meshes, through the native OBJ loader and through Assimp
+static void BM_ImportModelNanosuitObj(benchmark::State &state) {
+  BM_ImportModel(state,
+                 resourcePath("resources/objects/nanosuit/nanosuit.obj"));
+}
+BENCHMARK(BM_ImportModelNanosuitObj)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ImportModelNanosuitAssimp(benchmark::State &state) {
+  BM_ImportModel(
+      state,
+      assimpCopy(resourcePath("resources/objects/nanosuit/nanosuit.obj"),
+                 "bench_nanosuit.assbin"));
+}
+BENCHMARK(BM_ImportModelNanosuitAssimp)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+// a 1M triangle grid split into 16 meshes
+const unsigned int SPLIT_GRID_TRIANGLES = 1000000;
+const unsigned int SPLIT_GRID_MESHES = 16;
+
+static void BM_ImportModelGridObj(benchmark::State &state) {
+  BM_ImportModel(state, gridObj(SPLIT_GRID_TRIANGLES, SPLIT_GRID_MESHES));
+  state.SetItemsProcessed(state.iterations() * SPLIT_GRID_TRIANGLES);
+}
+BENCHMARK(BM_ImportModelGridObj)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
+
+static void BM_ImportModelGridAssimp(benchmark::State &state) {
+  string grid = gridObj(SPLIT_GRID_TRIANGLES, SPLIT_GRID_MESHES);
+  BM_ImportModel(state, assimpCopy(grid, grid + ".assbin"));
+  state.SetItemsProcessed(state.iterations() * SPLIT_GRID_TRIANGLES);
+}
+BENCHMARK(BM_ImportModelGridAssimp)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond);
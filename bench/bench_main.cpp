@@ -0,0 +1,32 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+// Runs the benchmarks like BENCHMARK_MAIN, but also writes the results to
+// learnopengl_bench.json unless --benchmark_out is given, so that runs of
+// different commits can be diffed (e.g. with benchmark's compare.py).
+int main(int argc, char **argv) {
+  std::vector<char *> args(argv, argv + argc);
+  bool hasOutput = false;
+  for (int i = 1; i < argc; i++) {
+    hasOutput |= std::strncmp(argv[i], "--benchmark_out=", 16) == 0;
+  }
+  std::string output = "--benchmark_out=learnopengl_bench.json";
+  std::string format = "--benchmark_out_format=json";
+  if (!hasOutput) {
+    args.push_back(&output[0]);
+    args.push_back(&format[0]);
+  }
+  args.push_back(NULL);
+
+  int count = args.size() - 1;
+  benchmark::Initialize(&count, &args[0]);
+  if (benchmark::ReportUnrecognizedArguments(count, &args[0])) {
+    return 1;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include <vector>
+
+#include <assimp/scene.h>
+#include <benchmark/benchmark.h>
+
+#include "mesh.h"
+#include "model.h"
+
+using namespace std;
+
+// An aiMesh laid out like an imported one, a side x side grid of vertices
+// with normals, uvs and tangents, triangulated
+static aiMesh *createGridMesh(unsigned int side) {
+  aiMesh *mesh = new aiMesh();
+  mesh->mNumVertices = side * side;
+  mesh->mVertices = new aiVector3D[mesh->mNumVertices];
+  mesh->mNormals = new aiVector3D[mesh->mNumVertices];
+  mesh->mTangents = new aiVector3D[mesh->mNumVertices];
+  mesh->mBitangents = new aiVector3D[mesh->mNumVertices];
+  mesh->mTextureCoords[0] = new aiVector3D[mesh->mNumVertices];
+  for (unsigned int y = 0; y < side; y++) {
+    for (unsigned int x = 0; x < side; x++) {
+      unsigned int i = y * side + x;
+      mesh->mVertices[i] = aiVector3D((float)x, (float)y, 0.0f);
+      mesh->mNormals[i] = aiVector3D(0.0f, 0.0f, 1.0f);
+      mesh->mTangents[i] = aiVector3D(1.0f, 0.0f, 0.0f);
+      mesh->mBitangents[i] = aiVector3D(0.0f, 1.0f, 0.0f);
+      mesh->mTextureCoords[0][i] =
+          aiVector3D((float)x / side, (float)y / side, 0.0f);
+    }
+  }
+  mesh->mNumFaces = (side - 1) * (side - 1) * 2;
+  mesh->mFaces = new aiFace[mesh->mNumFaces];
+  unsigned int face = 0;
+  for (unsigned int y = 0; y + 1 < side; y++) {
+    for (unsigned int x = 0; x + 1 < side; x++) {
+      unsigned int a = y * side + x;
+      unsigned int corners[2][3] = {{a, a + 1, a + side + 1},
+                                    {a, a + side + 1, a + side}};
+      for (unsigned int i = 0; i < 2; i++, face++) {
+        mesh->mFaces[face].mNumIndices = 3;
+        mesh->mFaces[face].mIndices = new unsigned int[3];
+        for (unsigned int j = 0; j < 3; j++) {
+          mesh->mFaces[face].mIndices[j] = corners[i][j];
+        }
+      }
+    }
+  }
+  return mesh;
+}
+
+// convertMesh, which Model::importAssimp runs for every aiMesh, on a single
+// mesh on the calling thread. BM_ImportModel in bench_loading.cpp times the
+// conversion of whole models, parallel and serial.
+static void BM_ConvertMesh(benchmark::State &state) {
+  aiMesh *mesh = createGridMesh(state.range(0));
+  vector<unsigned int> boneMap;
+  while (state.KeepRunning()) {
+    MeshData data;
+    convertMesh(mesh, boneMap, data);
+    benchmark::DoNotOptimize(data.vertices.data());
+    benchmark::DoNotOptimize(data.indices.data());
+  }
+  state.SetItemsProcessed(state.iterations() * mesh->mNumVertices);
+  delete mesh;
+}
+BENCHMARK(BM_ConvertMesh)->Arg(32)->Arg(256)->Arg(1024);
+
+// The sampler names Mesh::Draw used to rebuild on every draw, for a material
+// with one texture of each type
+static void BM_BuildSamplerNames(benchmark::State &state) {
+  const char *types[] = {"texture_diffuse", "texture_specular",
+                         "texture_normal", "texture_height"};
+  vector<Texture> textures;
+  for (unsigned int i = 0; i < 4; i++) {
+    Texture texture;
+    texture.id = i;
+    texture.type = types[i];
+    textures.push_back(texture);
+  }
+  while (state.KeepRunning()) {
+    vector<string> names = buildSamplerNames(textures);
+    benchmark::DoNotOptimize(names.data());
+  }
+  state.SetItemsProcessed(state.iterations() * textures.size());
+}
+BENCHMARK(BM_BuildSamplerNames);
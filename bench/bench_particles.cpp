@@ -0,0 +1,45 @@
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+
+#include "job_pool.h"
+#include "particles.h"
+
+using namespace std;
+
+// the fountain in main.cpp, emitting as fast as particles die
+static ParticleEmitter fountain() {
+  ParticleEmitter emitter;
+  emitter.position = glm::vec3(-3.0f, -1.75f, -1.0f);
+  emitter.extent = glm::vec3(0.1f, 0.0f, 0.1f);
+  emitter.velocity = glm::vec3(0.0f, 4.0f, 0.0f);
+  emitter.velocitySpread = glm::vec3(1.0f);
+  emitter.minLifetime = 1.5f;
+  emitter.maxLifetime = 2.5f;
+  return emitter;
+}
+
+// A frame of a full system: emitting the particles that died in the last
+// one, moving them all and, unless range(1) is 0, writing the instances
+// rendering would upload. Runs on the shared pool as the render loop does.
+static void BM_UpdateParticles(benchmark::State &state) {
+  unsigned int count = state.range(0);
+  ParticleSystem particles(count);
+  ParticleEmitter emitter = fountain();
+  particles.emit(emitter, count);
+  vector<float> instances(state.range(1) ? count * PARTICLE_INSTANCE_FLOATS
+                                         : 0);
+  const float step = 1.0f / 60.0f;
+  while (state.KeepRunning()) {
+    particles.emit(emitter, count - particles.size());
+    particles.update(step, glm::vec3(0.0f, -2.5f, 0.0f), sharedJobPool(),
+                     instances.empty() ? NULL : &instances[0]);
+    benchmark::DoNotOptimize(particles.size());
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  state.counters["threads"] = sharedJobPool().size() + 1;
+}
+BENCHMARK(BM_UpdateParticles)
+    ->Ranges({{1 << 14, 1 << 20}, {0, 1}})
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,99 @@
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "job_pool.h"
+#include "mesh.h"
+#include "skinning.h"
+
+using namespace std;
+
+// bones in the synthetic palette, about the nanosuit's
+const unsigned int SKINNING_BENCH_BONES = 64;
+
+// A skinned mesh of count vertices with random frames and up to
+// MAX_BONE_INFLUENCE weights each, some of them for bones outside the
+// palette, and a palette of random rigid transforms
+struct SkinnedScene {
+  vector<Vertex> bindPose;
+  vector<glm::mat4> bones;
+
+  explicit SkinnedScene(unsigned int count) {
+    mt19937 random(count);
+    uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    uniform_int_distribution<int> bone(0, SKINNING_BENCH_BONES + 3);
+    for (unsigned int i = 0; i < SKINNING_BENCH_BONES; i++) {
+      glm::mat4 transform = glm::translate(
+          glm::mat4(1.0f), glm::vec3(unit(random), unit(random), unit(random)));
+      bones.push_back(glm::rotate(
+          transform, unit(random) * 3.1416f,
+          glm::normalize(glm::vec3(unit(random), unit(random), 1.0f))));
+    }
+    bindPose.resize(count);
+    for (unsigned int i = 0; i < count; i++) {
+      Vertex &vertex = bindPose[i];
+      vertex.position = glm::vec3(unit(random), unit(random), unit(random));
+      vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+      vertex.tangent = glm::vec3(1.0f, 0.0f, 0.0f);
+      vertex.bitangent = glm::vec3(0.0f, 1.0f, 0.0f);
+      vertex.texCoords = glm::vec2(unit(random), unit(random));
+      // every eighth vertex is static
+      unsigned int influences = i % 8 == 0 ? 0 : 1 + i % MAX_BONE_INFLUENCE;
+      float total = 0.0f;
+      for (unsigned int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+        vertex.boneIds[k] = k < influences ? bone(random) : 0;
+        vertex.weights[k] = k < influences ? unit(random) + 1.0f : 0.0f;
+        total += vertex.weights[k];
+      }
+      for (unsigned int k = 0; k < influences; k++) {
+        vertex.weights[k] /= total;
+      }
+    }
+  }
+};
+
+// the largest difference between the components of two skinned vertices
+static float difference(const Vertex &a, const Vertex &b) {
+  glm::vec3 differences[] = {a.position - b.position, a.normal - b.normal,
+                             a.tangent - b.tangent,
+                             a.bitangent - b.bitangent};
+  float largest = 0.0f;
+  for (unsigned int i = 0; i < 4; i++) {
+    for (unsigned int c = 0; c < 3; c++) {
+      largest = max(largest, fabs(differences[i][c]));
+    }
+  }
+  return largest;
+}
+
+// Skinning count vertices on the shared pool as skinModel does, with AVX
+// where the CPU has it unless range(1) is 0. Fails if the AVX results stray
+// from the scalar ones by more than rounding.
+static void BM_SkinVertices(benchmark::State &state) {
+  SkinnedScene scene(state.range(0));
+  bool avx = state.range(1) != 0;
+  vector<Vertex> skinned, scalar;
+  skinVertices(scene.bindPose, scene.bones, skinned, sharedJobPool(), avx);
+  skinVertices(scene.bindPose, scene.bones, scalar, sharedJobPool(), false);
+  float largest = 0.0f;
+  for (size_t i = 0; i < skinned.size(); i++) {
+    largest = max(largest, difference(skinned[i], scalar[i]));
+  }
+  if (largest > 1e-4f) {
+    state.SkipWithError("AVX skinning differs from the scalar path");
+  }
+  while (state.KeepRunning()) {
+    skinVertices(scene.bindPose, scene.bones, skinned, sharedJobPool(), avx);
+    benchmark::DoNotOptimize(skinned.data());
+  }
+  state.SetItemsProcessed(state.iterations() * scene.bindPose.size());
+  state.counters["maxDifference"] = largest;
+}
+BENCHMARK(BM_SkinVertices)
+    ->Ranges({{1 << 12, 1 << 18}, {0, 1}})
+    ->Unit(benchmark::kMicrosecond);
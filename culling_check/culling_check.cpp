@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "culling.h"
+#include "instance_batch.h"
+#include "mesh.h"
+#include "model.h"
+
+// Checks the compute shader culling of InstanceBatch against cullInstances in
+// a headless context: both must find the same meshes of the same instances
+// visible. Run from the source directory so shaders/ is found, without a GPU
+// on Mesa's llvmpipe:
+//
+//   LIBGL_ALWAYS_SOFTWARE=1 learnopengl_culling_check
+//
+// Exits with 1 if any set of instances is culled differently.
+
+// context versions to try, the newest first, all with compute shaders
+const int CONTEXT_VERSIONS[][2] = {{4, 6}, {4, 5}, {4, 3}};
+
+const unsigned int CHECKED_MESHES = 12;
+const unsigned int MAX_CHECKED_INSTANCES = 1024;
+const unsigned int CHECKED_SETS = 64;
+// instances are placed in a cube this far around the camera
+const float PLACEMENT_EXTENT = 40.0f;
+
+// creates a context without a surface on the default display and makes it
+// current, returns false if there's none with compute shaders
+static bool createContext() {
+  EGLDisplay display = EGL_NO_DISPLAY;
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay) {
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+    std::cout << "ERROR::CULLING_CHECK:: no EGL display" << std::endl;
+    return false;
+  }
+  eglBindAPI(EGL_OPENGL_API);
+
+  EGLConfig config = EGL_NO_CONFIG_KHR;
+  const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (!extensions || !strstr(extensions, "EGL_KHR_no_config_context")) {
+    const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                       EGL_NONE};
+    EGLint configs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) ||
+        configs == 0) {
+      std::cout << "ERROR::CULLING_CHECK:: no OpenGL capable EGL config"
+                << std::endl;
+      return false;
+    }
+  }
+  for (unsigned int i = 0;
+       i < sizeof(CONTEXT_VERSIONS) / sizeof(CONTEXT_VERSIONS[0]); i++) {
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, CONTEXT_VERSIONS[i][0],
+        EGL_CONTEXT_MINOR_VERSION, CONTEXT_VERSIONS[i][1],
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    EGLContext context =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context != EGL_NO_CONTEXT) {
+      return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                            context) == EGL_TRUE;
+    }
+  }
+  std::cout << "ERROR::CULLING_CHECK:: no OpenGL 4.3 context" << std::endl;
+  return false;
+}
+
+static float uniform(std::mt19937 &random, float low, float high) {
+  return std::uniform_real_distribution<float>(low, high)(random);
+}
+
+static glm::vec3 randomAxis(std::mt19937 &random) {
+  glm::vec3 axis(uniform(random, -1.0f, 1.0f), uniform(random, -1.0f, 1.0f),
+                 uniform(random, -1.0f, 1.0f));
+  float length = glm::length(axis);
+  return length > 0.001f ? axis / length : glm::vec3(0.0f, 1.0f, 0.0f);
+}
+
+// a rotated, scaled and moved transform, up to extent from the origin
+static glm::mat4 randomTransform(std::mt19937 &random, float extent,
+                                 float minScale, float maxScale) {
+  glm::mat4 transform = glm::translate(
+      glm::mat4(1.0f),
+      glm::vec3(uniform(random, -extent, extent),
+                uniform(random, -extent, extent),
+                uniform(random, -extent, extent)));
+  transform = glm::rotate(transform, uniform(random, 0.0f, 6.2832f),
+                          randomAxis(random));
+  return glm::scale(transform,
+                    glm::vec3(uniform(random, minScale, maxScale),
+                              uniform(random, minScale, maxScale),
+                              uniform(random, minScale, maxScale)));
+}
+
+// Fills model with boxes of random sizes hanging off a small node hierarchy,
+// all static and sampling texture arrays so the batch takes every one
+static void buildModel(Model &model, std::mt19937 &random) {
+  const unsigned int corners[][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0},
+                                     {1, 1, 0}, {0, 0, 1}, {1, 0, 1},
+                                     {0, 1, 1}, {1, 1, 1}};
+  const unsigned int faces[] = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6,
+                                0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+                                0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+  model.nodes.addNode(SceneGraph::NO_PARENT);
+  for (unsigned int i = 0; i < CHECKED_MESHES; i++) {
+    int parent = std::uniform_int_distribution<int>(0, i)(random);
+    model.meshNodes.push_back(
+        model.nodes.addNode(parent, randomTransform(random, 2.0f, 0.5f, 1.5f)));
+
+    glm::vec3 low(uniform(random, -2.0f, 0.0f), uniform(random, -2.0f, 0.0f),
+                  uniform(random, -2.0f, 0.0f));
+    glm::vec3 high(uniform(random, 0.1f, 2.0f), uniform(random, 0.1f, 2.0f),
+                   uniform(random, 0.1f, 2.0f));
+    // value initialized, so without normals or bone weights
+    std::vector<Vertex> vertices(8);
+    for (unsigned int j = 0; j < vertices.size(); j++) {
+      vertices[j].position = glm::vec3(corners[j][0] ? high.x : low.x,
+                                       corners[j][1] ? high.y : low.y,
+                                       corners[j][2] ? high.z : low.z);
+    }
+    std::vector<unsigned int> indices(
+        faces, faces + sizeof(faces) / sizeof(faces[0]));
+    model.meshes.push_back(Mesh(vertices, indices, std::vector<Texture>()));
+    model.meshes.back().layered = true;
+  }
+  model.nodes.update();
+}
+
+int main() {
+  if (!createContext()) {
+    return 1;
+  }
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress) ||
+      !InstanceBatch::supported()) {
+    std::cout << "ERROR::CULLING_CHECK:: OpenGL 4.3 is not supported"
+              << std::endl;
+    return 1;
+  }
+
+  std::mt19937 random(1);
+  Model model;
+  buildModel(model, random);
+  unsigned int failures = 0;
+  {
+    InstanceBatch batch(model, MAX_CHECKED_INSTANCES);
+    if (batch.skippedMeshes != 0) {
+      std::cout << "ERROR::CULLING_CHECK:: " << batch.skippedMeshes
+                << " meshes weren't batched" << std::endl;
+      failures++;
+    }
+
+    std::vector<glm::mat4> instances;
+    std::vector<unsigned int> gpuVisible, cpuVisible, differences;
+    size_t gpuTotal = 0;
+    for (unsigned int set = 0; set < CHECKED_SETS; set++) {
+      unsigned int count = std::uniform_int_distribution<unsigned int>(
+          1, MAX_CHECKED_INSTANCES)(random);
+      instances.resize(count);
+      for (unsigned int i = 0; i < count; i++) {
+        instances[i] = randomTransform(random, PLACEMENT_EXTENT, 0.2f, 3.0f);
+      }
+      batch.setInstances(instances);
+
+      glm::mat4 view = glm::lookAt(glm::vec3(0.0f), randomAxis(random),
+                                   glm::vec3(0.0f, 1.0f, 0.0f));
+      glm::mat4 projection = glm::perspective(
+          glm::radians(uniform(random, 30.0f, 90.0f)),
+          uniform(random, 0.5f, 2.0f), 0.1f, PLACEMENT_EXTENT);
+      Frustum frustum = extractFrustum(projection * view);
+
+      batch.cull(frustum);
+      batch.readVisible(gpuVisible);
+      cullInstances(frustum, batch.meshBounds, batch.meshTransforms,
+                    batch.instances, cpuVisible);
+      differences.clear();
+      std::set_symmetric_difference(gpuVisible.begin(), gpuVisible.end(),
+                                    cpuVisible.begin(), cpuVisible.end(),
+                                    std::back_inserter(differences));
+      if (!differences.empty()) {
+        std::cout << "Set " << set << ": " << gpuVisible.size()
+                  << " meshes visible on the GPU, " << cpuVisible.size()
+                  << " on the CPU, " << differences.size() << " differ"
+                  << std::endl;
+        failures++;
+      }
+      gpuTotal += gpuVisible.size();
+    }
+    std::cout << CHECKED_SETS << " sets of instances culled, "
+              << gpuTotal << " meshes visible, " << failures << " failures"
+              << std::endl;
+  }
+  model.release();
+  GLenum error = glGetError();
+  if (error != GL_NO_ERROR) {
+    std::cout << "ERROR::CULLING_CHECK:: GL error " << error << std::endl;
+    failures++;
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,985 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "gl_trace.h"
+
+// Replays a trace written with LEARNOPENGL_TRACE in a headless context, as
+// fast as possible, and reports the time spent in each frame and in each GL
+// function. Without a GPU, Mesa's llvmpipe runs it:
+//
+//   LIBGL_ALWAYS_SOFTWARE=1 learnopengl_replay trace.bin
+
+typedef std::chrono::steady_clock Clock;
+
+// size of the stand-in for the window's framebuffer until the first frame
+// tells the real one, that of the engine's window
+const int DEFAULT_WIDTH = 800;
+const int DEFAULT_HEIGHT = 600;
+
+// context versions to try, the newest first
+const int CONTEXT_VERSIONS[][2] = {{4, 6}, {4, 5}, {4, 3}, {3, 3}};
+
+// Reads the records of a trace held in memory. Reading past the end sets
+// failed and yields zeros.
+struct TraceReader {
+  const unsigned char *position;
+  const unsigned char *end;
+  bool failed;
+
+  TraceReader(const std::vector<unsigned char> &data)
+      : position(data.empty() ? NULL : &data[0]),
+        end(data.empty() ? NULL : &data[0] + data.size()), failed(false) {}
+
+  bool atEnd() const { return position == end; }
+
+  // size bytes, NULL if there aren't as many left
+  const unsigned char *bytes(size_t size) {
+    if ((size_t)(end - position) < size) {
+      failed = true;
+      position = end;
+      return NULL;
+    }
+    const unsigned char *start = position;
+    position += size;
+    return start;
+  }
+
+  template <typename T> T value() {
+    T result = T();
+    const unsigned char *data = bytes(sizeof(T));
+    if (data) {
+      memcpy(&result, data, sizeof(T));
+    }
+    return result;
+  }
+  uint16_t u16() { return value<uint16_t>(); }
+  uint32_t u32() { return value<uint32_t>(); }
+  int32_t i32() { return value<int32_t>(); }
+  float f32() { return value<float>(); }
+  uint64_t u64() { return value<uint64_t>(); }
+
+  std::string string() {
+    uint32_t length = u32();
+    const unsigned char *data = bytes(length);
+    return data ? std::string((const char *)data, length) : std::string();
+  }
+
+  // count floats, copied out as the stream doesn't align them
+  const GLfloat *floats(size_t count, std::vector<GLfloat> &scratch) {
+    scratch.resize(std::max(count, (size_t)1));
+    const unsigned char *data = bytes(count * sizeof(GLfloat));
+    if (data) {
+      memcpy(&scratch[0], data, count * sizeof(GLfloat));
+    }
+    return &scratch[0];
+  }
+};
+
+// objects of one kind, from the names the engine saw to the replay's
+typedef std::unordered_map<GLuint, GLuint> NameMap;
+
+static GLuint mapName(const NameMap &names, GLuint name) {
+  NameMap::const_iterator found = names.find(name);
+  return found != names.end() ? found->second : name;
+}
+
+struct CallStats {
+  uint64_t count;
+  double seconds;
+};
+
+// Replays records against the current context. Object names, sync objects,
+// uniform locations and block indices are mapped to the ones the replay's
+// own calls return. The window's framebuffer is replaced by an offscreen one.
+class Replayer {
+public:
+  std::vector<CallStats> calls;
+  std::vector<double> frameSeconds;
+  unsigned int errors;
+
+  Replayer()
+      : calls(TRACE_RECORDS), errors(0), currentProgram(0), window(0),
+        windowColor(0), windowDepth(0), windowWidth(0), windowHeight(0) {
+    for (unsigned int i = 0; i < calls.size(); i++) {
+      calls[i].count = 0;
+      calls[i].seconds = 0.0;
+    }
+    framebuffers[0] = 0;
+    resizeWindow(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  }
+
+  // replays the whole trace, false if it is malformed
+  bool replay(TraceReader &in) {
+    Clock::time_point frameStart = Clock::now();
+    while (!in.atEnd()) {
+      unsigned int record = in.u16();
+      if (in.failed || record >= TRACE_RECORDS) {
+        std::cout << "ERROR::REPLAY:: unknown record " << record << std::endl;
+        return false;
+      }
+      // includes decoding the arguments, a few nanoseconds
+      Clock::time_point start = Clock::now();
+      if (!execute(record, in)) {
+        std::cout << "ERROR::REPLAY:: truncated "
+                  << glTraceRecordName(record) << " record" << std::endl;
+        return false;
+      }
+      Clock::time_point now = Clock::now();
+      calls[record].count++;
+      calls[record].seconds +=
+          std::chrono::duration<double>(now - start).count();
+      if (record == TRACE_FRAME) {
+        frameSeconds.push_back(
+            std::chrono::duration<double>(now - frameStart).count());
+        frameStart = now;
+      }
+    }
+    return true;
+  }
+
+private:
+  NameMap buffers, framebuffers, queries, renderbuffers, textures,
+      vertexArrays, programs, shaders;
+  std::unordered_map<uint64_t, GLsync> syncs;
+  // where each blob is in the trace
+  std::unordered_map<uint64_t, std::pair<const unsigned char *, size_t> >
+      blobs;
+  // keyed by the replay's program and the location or index the engine saw
+  std::map<std::pair<GLuint, GLint>, GLint> uniformLocations;
+  std::map<std::pair<GLuint, GLuint>, GLuint> uniformBlocks;
+  GLuint currentProgram;
+  // stands in for the window's framebuffer
+  GLuint window, windowColor, windowDepth;
+  int windowWidth, windowHeight;
+  std::vector<GLfloat> scratch;
+  std::vector<unsigned char> readback;
+
+  void resizeWindow(int width, int height) {
+    if (width == windowWidth && height == windowHeight) {
+      return;
+    }
+    if (window == 0) {
+      glGenFramebuffers(1, &window);
+      glGenRenderbuffers(1, &windowColor);
+      glGenRenderbuffers(1, &windowDepth);
+    }
+    glBindRenderbuffer(GL_RENDERBUFFER, windowColor);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, windowDepth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width,
+                          height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    // keeps the engine's binding, which may be the window
+    GLint bound;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &bound);
+    glBindFramebuffer(GL_FRAMEBUFFER, window);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                              GL_RENDERBUFFER, windowColor);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                              GL_RENDERBUFFER, windowDepth);
+    glBindFramebuffer(GL_FRAMEBUFFER, bound);
+    framebuffers[0] = window;
+    windowWidth = width;
+    windowHeight = height;
+  }
+
+  const void *blob(uint64_t hash) {
+    if (hash == 0) {
+      return NULL;
+    }
+    return blobs[hash].first;
+  }
+
+  GLint location(GLint location) {
+    if (location < 0) {
+      return location;
+    }
+    std::map<std::pair<GLuint, GLint>, GLint>::iterator found =
+        uniformLocations.find(std::make_pair(currentProgram, location));
+    return found != uniformLocations.end() ? found->second : location;
+  }
+
+  GLsync sync(uint64_t sync) {
+    std::unordered_map<uint64_t, GLsync>::iterator found = syncs.find(sync);
+    return found != syncs.end() ? found->second : NULL;
+  }
+
+  // the names of a glGen* record, mapped to n fresh ones from gen
+  void generate(TraceReader &in, NameMap &names,
+                void(APIENTRYP gen)(GLsizei, GLuint *)) {
+    GLsizei n = in.u32();
+    std::vector<GLuint> created(std::max(n, 1));
+    gen(n, &created[0]);
+    for (GLsizei i = 0; i < n; i++) {
+      names[in.u32()] = created[i];
+    }
+  }
+
+  // the names of a glDelete* record, deleted with del
+  void remove(TraceReader &in, NameMap &names,
+              void(APIENTRYP del)(GLsizei, const GLuint *)) {
+    GLsizei n = in.u32();
+    std::vector<GLuint> deleted(std::max(n, 1));
+    for (GLsizei i = 0; i < n; i++) {
+      GLuint name = in.u32();
+      deleted[i] = mapName(names, name);
+      names.erase(name);
+    }
+    del(n, &deleted[0]);
+  }
+
+  bool execute(unsigned int record, TraceReader &in) {
+    switch (record) {
+    case TRACE_FRAME: {
+      int width = in.u32();
+      int height = in.u32();
+      // waits for the frame's rendering, like a buffer swap would
+      glFinish();
+      while (glGetError() != GL_NO_ERROR) {
+        errors++;
+      }
+      resizeWindow(width, height);
+      break;
+    }
+    case TRACE_BLOB: {
+      uint64_t hash = in.u64();
+      uint64_t size = in.u64();
+      blobs[hash] = std::make_pair(in.bytes(size), (size_t)size);
+      break;
+    }
+    case TRACE_glActiveTexture:
+      glActiveTexture(in.u32());
+      break;
+    case TRACE_glAttachShader: {
+      GLuint program = mapName(programs, in.u32());
+      glAttachShader(program, mapName(shaders, in.u32()));
+      break;
+    }
+    case TRACE_glBeginQuery: {
+      GLenum target = in.u32();
+      glBeginQuery(target, mapName(queries, in.u32()));
+      break;
+    }
+    case TRACE_glBindBuffer: {
+      GLenum target = in.u32();
+      glBindBuffer(target, mapName(buffers, in.u32()));
+      break;
+    }
+    case TRACE_glBindBufferBase: {
+      GLenum target = in.u32();
+      GLuint index = in.u32();
+      glBindBufferBase(target, index, mapName(buffers, in.u32()));
+      break;
+    }
+    case TRACE_glBindFramebuffer: {
+      GLenum target = in.u32();
+      glBindFramebuffer(target, mapName(framebuffers, in.u32()));
+      break;
+    }
+    case TRACE_glBindRenderbuffer: {
+      GLenum target = in.u32();
+      glBindRenderbuffer(target, mapName(renderbuffers, in.u32()));
+      break;
+    }
+    case TRACE_glBindTexture: {
+      GLenum target = in.u32();
+      glBindTexture(target, mapName(textures, in.u32()));
+      break;
+    }
+    case TRACE_glBindVertexArray:
+      glBindVertexArray(mapName(vertexArrays, in.u32()));
+      break;
+    case TRACE_glBlendFunc: {
+      GLenum sfactor = in.u32();
+      glBlendFunc(sfactor, in.u32());
+      break;
+    }
+    case TRACE_glBlitFramebuffer: {
+      GLint coordinates[8];
+      for (unsigned int i = 0; i < 8; i++) {
+        coordinates[i] = in.i32();
+      }
+      GLbitfield mask = in.u32();
+      GLenum filter = in.u32();
+      glBlitFramebuffer(coordinates[0], coordinates[1], coordinates[2],
+                        coordinates[3], coordinates[4], coordinates[5],
+                        coordinates[6], coordinates[7], mask, filter);
+      break;
+    }
+    case TRACE_glBufferData: {
+      GLenum target = in.u32();
+      GLsizeiptr size = in.u64();
+      const void *data = blob(in.u64());
+      glBufferData(target, size, data, in.u32());
+      break;
+    }
+    case TRACE_glBufferStorage: {
+      GLenum target = in.u32();
+      GLsizeiptr size = in.u64();
+      const void *data = blob(in.u64());
+      glBufferStorage(target, size, data, in.u32());
+      break;
+    }
+    case TRACE_glBufferSubData: {
+      GLenum target = in.u32();
+      GLintptr offset = in.u64();
+      GLsizeiptr size = in.u64();
+      glBufferSubData(target, offset, size, blob(in.u64()));
+      break;
+    }
+    case TRACE_glCheckFramebufferStatus:
+      glCheckFramebufferStatus(in.u32());
+      break;
+    case TRACE_glClear:
+      glClear(in.u32());
+      break;
+    case TRACE_glClearColor: {
+      GLfloat red = in.f32();
+      GLfloat green = in.f32();
+      GLfloat blue = in.f32();
+      glClearColor(red, green, blue, in.f32());
+      break;
+    }
+    case TRACE_glClientWaitSync: {
+      GLsync fence = sync(in.u64());
+      GLbitfield flags = in.u32();
+      GLuint64 timeout = in.u64();
+      if (fence) {
+        glClientWaitSync(fence, flags, timeout);
+      }
+      break;
+    }
+    case TRACE_glCompileShader:
+      glCompileShader(mapName(shaders, in.u32()));
+      break;
+    case TRACE_glCreateProgram:
+      programs[in.u32()] = glCreateProgram();
+      break;
+    case TRACE_glCreateShader: {
+      GLenum type = in.u32();
+      shaders[in.u32()] = glCreateShader(type);
+      break;
+    }
+    case TRACE_glCullFace:
+      glCullFace(in.u32());
+      break;
+    case TRACE_glDeleteBuffers:
+      remove(in, buffers, glDeleteBuffers);
+      break;
+    case TRACE_glDeleteFramebuffers:
+      remove(in, framebuffers, glDeleteFramebuffers);
+      break;
+    case TRACE_glDeleteProgram: {
+      GLuint program = in.u32();
+      glDeleteProgram(mapName(programs, program));
+      programs.erase(program);
+      break;
+    }
+    case TRACE_glDeleteQueries:
+      remove(in, queries, glDeleteQueries);
+      break;
+    case TRACE_glDeleteRenderbuffers:
+      remove(in, renderbuffers, glDeleteRenderbuffers);
+      break;
+    case TRACE_glDeleteShader: {
+      GLuint shader = in.u32();
+      glDeleteShader(mapName(shaders, shader));
+      shaders.erase(shader);
+      break;
+    }
+    case TRACE_glDeleteSync: {
+      uint64_t fence = in.u64();
+      if (sync(fence)) {
+        glDeleteSync(sync(fence));
+      }
+      syncs.erase(fence);
+      break;
+    }
+    case TRACE_glDeleteTextures:
+      remove(in, textures, glDeleteTextures);
+      break;
+    case TRACE_glDeleteVertexArrays:
+      remove(in, vertexArrays, glDeleteVertexArrays);
+      break;
+    case TRACE_glDepthFunc:
+      glDepthFunc(in.u32());
+      break;
+    case TRACE_glDepthMask:
+      glDepthMask(in.u32());
+      break;
+    case TRACE_glDisable:
+      glDisable(in.u32());
+      break;
+    case TRACE_glDispatchCompute: {
+      GLuint x = in.u32();
+      GLuint y = in.u32();
+      glDispatchCompute(x, y, in.u32());
+      break;
+    }
+    case TRACE_glDrawArrays: {
+      GLenum mode = in.u32();
+      GLint first = in.i32();
+      glDrawArrays(mode, first, in.i32());
+      break;
+    }
+    case TRACE_glDrawArraysInstanced: {
+      GLenum mode = in.u32();
+      GLint first = in.i32();
+      GLsizei count = in.i32();
+      glDrawArraysInstanced(mode, first, count, in.i32());
+      break;
+    }
+    case TRACE_glDrawBuffers: {
+      GLsizei n = in.u32();
+      std::vector<GLenum> bufs(std::max(n, 1));
+      for (GLsizei i = 0; i < n; i++) {
+        bufs[i] = in.u32();
+      }
+      glDrawBuffers(n, &bufs[0]);
+      break;
+    }
+    case TRACE_glDrawElements: {
+      GLenum mode = in.u32();
+      GLsizei count = in.i32();
+      GLenum type = in.u32();
+      glDrawElements(mode, count, type, (const void *)(uintptr_t)in.u64());
+      break;
+    }
+    case TRACE_glDrawElementsInstanced: {
+      GLenum mode = in.u32();
+      GLsizei count = in.i32();
+      GLenum type = in.u32();
+      const void *indices = (const void *)(uintptr_t)in.u64();
+      glDrawElementsInstanced(mode, count, type, indices, in.i32());
+      break;
+    }
+    case TRACE_glEnable:
+      glEnable(in.u32());
+      break;
+    case TRACE_glEnableVertexAttribArray:
+      glEnableVertexAttribArray(in.u32());
+      break;
+    case TRACE_glEndQuery:
+      glEndQuery(in.u32());
+      break;
+    case TRACE_glFenceSync: {
+      GLenum condition = in.u32();
+      GLbitfield flags = in.u32();
+      syncs[in.u64()] = glFenceSync(condition, flags);
+      break;
+    }
+    case TRACE_glFlushMappedBufferRange: {
+      GLenum target = in.u32();
+      GLintptr offset = in.u64();
+      GLsizeiptr length = in.u64();
+      const void *data = blob(in.u64());
+      // what the engine wrote to its mapping goes into the replay's
+      void *mapped = NULL;
+      glGetBufferPointerv(target, GL_BUFFER_MAP_POINTER, &mapped);
+      if (mapped && data) {
+        memcpy(static_cast<unsigned char *>(mapped) + offset, data, length);
+      }
+      glFlushMappedBufferRange(target, offset, length);
+      break;
+    }
+    case TRACE_glFramebufferRenderbuffer: {
+      GLenum target = in.u32();
+      GLenum attachment = in.u32();
+      GLenum renderbuffertarget = in.u32();
+      glFramebufferRenderbuffer(target, attachment, renderbuffertarget,
+                                mapName(renderbuffers, in.u32()));
+      break;
+    }
+    case TRACE_glFramebufferTexture2D: {
+      GLenum target = in.u32();
+      GLenum attachment = in.u32();
+      GLenum textarget = in.u32();
+      GLuint texture = mapName(textures, in.u32());
+      glFramebufferTexture2D(target, attachment, textarget, texture,
+                             in.i32());
+      break;
+    }
+    case TRACE_glGenBuffers:
+      generate(in, buffers, glGenBuffers);
+      break;
+    case TRACE_glGenFramebuffers:
+      generate(in, framebuffers, glGenFramebuffers);
+      break;
+    case TRACE_glGenQueries:
+      generate(in, queries, glGenQueries);
+      break;
+    case TRACE_glGenRenderbuffers:
+      generate(in, renderbuffers, glGenRenderbuffers);
+      break;
+    case TRACE_glGenTextures:
+      generate(in, textures, glGenTextures);
+      break;
+    case TRACE_glGenVertexArrays:
+      generate(in, vertexArrays, glGenVertexArrays);
+      break;
+    case TRACE_glGenerateMipmap:
+      glGenerateMipmap(in.u32());
+      break;
+    case TRACE_glGetBufferSubData: {
+      GLenum target = in.u32();
+      GLintptr offset = in.u64();
+      GLsizeiptr size = in.u64();
+      readback.resize(std::max<GLsizeiptr>(size, 1));
+      glGetBufferSubData(target, offset, size, &readback[0]);
+      break;
+    }
+    // queries, repeated for the stalls they cause
+    case TRACE_glGetInteger64v: {
+      GLint64 data[4];
+      glGetInteger64v(in.u32(), data);
+      break;
+    }
+    case TRACE_glGetProgramInfoLog: {
+      GLchar log[1024];
+      glGetProgramInfoLog(mapName(programs, in.u32()), sizeof(log), NULL,
+                          log);
+      break;
+    }
+    case TRACE_glGetProgramiv: {
+      GLuint program = mapName(programs, in.u32());
+      GLint params[4];
+      glGetProgramiv(program, in.u32(), params);
+      break;
+    }
+    case TRACE_glGetQueryObjectiv: {
+      GLuint id = mapName(queries, in.u32());
+      GLint params;
+      glGetQueryObjectiv(id, in.u32(), &params);
+      break;
+    }
+    case TRACE_glGetQueryObjectui64v: {
+      GLuint id = mapName(queries, in.u32());
+      GLuint64 params;
+      glGetQueryObjectui64v(id, in.u32(), &params);
+      break;
+    }
+    case TRACE_glGetShaderInfoLog: {
+      GLchar log[1024];
+      glGetShaderInfoLog(mapName(shaders, in.u32()), sizeof(log), NULL, log);
+      break;
+    }
+    case TRACE_glGetShaderiv: {
+      GLuint shader = mapName(shaders, in.u32());
+      GLint params[4];
+      glGetShaderiv(shader, in.u32(), params);
+      break;
+    }
+    case TRACE_glGetUniformBlockIndex: {
+      GLuint program = mapName(programs, in.u32());
+      std::string name = in.string();
+      GLuint index = in.u32();
+      uniformBlocks[std::make_pair(program, index)] =
+          glGetUniformBlockIndex(program, name.c_str());
+      break;
+    }
+    case TRACE_glGetUniformLocation: {
+      GLuint program = mapName(programs, in.u32());
+      std::string name = in.string();
+      GLint location = in.i32();
+      uniformLocations[std::make_pair(program, location)] =
+          glGetUniformLocation(program, name.c_str());
+      break;
+    }
+    case TRACE_glLinkProgram:
+      glLinkProgram(mapName(programs, in.u32()));
+      break;
+    case TRACE_glMapBufferRange: {
+      GLenum target = in.u32();
+      GLintptr offset = in.u64();
+      GLsizeiptr length = in.u64();
+      glMapBufferRange(target, offset, length, in.u32());
+      break;
+    }
+    case TRACE_glMemoryBarrier:
+      glMemoryBarrier(in.u32());
+      break;
+    case TRACE_glMultiDrawElementsIndirect: {
+      GLenum mode = in.u32();
+      GLenum type = in.u32();
+      const void *indirect = (const void *)(uintptr_t)in.u64();
+      GLsizei drawcount = in.i32();
+      glMultiDrawElementsIndirect(mode, type, indirect, drawcount, in.i32());
+      break;
+    }
+    case TRACE_glQueryCounter: {
+      GLuint id = mapName(queries, in.u32());
+      glQueryCounter(id, in.u32());
+      break;
+    }
+    case TRACE_glRenderbufferStorage: {
+      GLenum target = in.u32();
+      GLenum internalformat = in.u32();
+      GLsizei width = in.i32();
+      glRenderbufferStorage(target, internalformat, width, in.i32());
+      break;
+    }
+    case TRACE_glShaderSource: {
+      GLuint shader = mapName(shaders, in.u32());
+      uint64_t hash = in.u64();
+      const GLchar *source = (const GLchar *)blob(hash);
+      GLint length = blobs[hash].second;
+      glShaderSource(shader, 1, &source, &length);
+      break;
+    }
+    case TRACE_glTexBuffer: {
+      GLenum target = in.u32();
+      GLenum internalformat = in.u32();
+      glTexBuffer(target, internalformat, mapName(buffers, in.u32()));
+      break;
+    }
+    case TRACE_glTexImage2D: {
+      GLenum target = in.u32();
+      GLint level = in.i32();
+      GLint internalformat = in.i32();
+      GLsizei width = in.i32();
+      GLsizei height = in.i32();
+      GLint border = in.i32();
+      GLenum format = in.u32();
+      GLenum type = in.u32();
+      glTexImage2D(target, level, internalformat, width, height, border,
+                   format, type, blob(in.u64()));
+      break;
+    }
+    case TRACE_glTexImage3D: {
+      GLenum target = in.u32();
+      GLint level = in.i32();
+      GLint internalformat = in.i32();
+      GLsizei width = in.i32();
+      GLsizei height = in.i32();
+      GLsizei depth = in.i32();
+      GLint border = in.i32();
+      GLenum format = in.u32();
+      GLenum type = in.u32();
+      glTexImage3D(target, level, internalformat, width, height, depth,
+                   border, format, type, blob(in.u64()));
+      break;
+    }
+    case TRACE_glTexParameteri: {
+      GLenum target = in.u32();
+      GLenum pname = in.u32();
+      glTexParameteri(target, pname, in.i32());
+      break;
+    }
+    case TRACE_glTexSubImage3D: {
+      GLenum target = in.u32();
+      GLint level = in.i32();
+      GLint xoffset = in.i32();
+      GLint yoffset = in.i32();
+      GLint zoffset = in.i32();
+      GLsizei width = in.i32();
+      GLsizei height = in.i32();
+      GLsizei depth = in.i32();
+      GLenum format = in.u32();
+      GLenum type = in.u32();
+      glTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height,
+                      depth, format, type, blob(in.u64()));
+      break;
+    }
+    case TRACE_glUniform1f: {
+      GLint uniform = location(in.i32());
+      glUniform1f(uniform, in.f32());
+      break;
+    }
+    case TRACE_glUniform1i: {
+      GLint uniform = location(in.i32());
+      glUniform1i(uniform, in.i32());
+      break;
+    }
+    case TRACE_glUniform2f: {
+      GLint uniform = location(in.i32());
+      GLfloat v0 = in.f32();
+      glUniform2f(uniform, v0, in.f32());
+      break;
+    }
+    case TRACE_glUniform2fv: {
+      GLint uniform = location(in.i32());
+      GLsizei count = in.i32();
+      glUniform2fv(uniform, count, in.floats(count * 2, scratch));
+      break;
+    }
+    case TRACE_glUniform3f: {
+      GLint uniform = location(in.i32());
+      GLfloat v0 = in.f32();
+      GLfloat v1 = in.f32();
+      glUniform3f(uniform, v0, v1, in.f32());
+      break;
+    }
+    case TRACE_glUniform3fv: {
+      GLint uniform = location(in.i32());
+      GLsizei count = in.i32();
+      glUniform3fv(uniform, count, in.floats(count * 3, scratch));
+      break;
+    }
+    case TRACE_glUniform4f: {
+      GLint uniform = location(in.i32());
+      GLfloat v0 = in.f32();
+      GLfloat v1 = in.f32();
+      GLfloat v2 = in.f32();
+      glUniform4f(uniform, v0, v1, v2, in.f32());
+      break;
+    }
+    case TRACE_glUniform4fv: {
+      GLint uniform = location(in.i32());
+      GLsizei count = in.i32();
+      glUniform4fv(uniform, count, in.floats(count * 4, scratch));
+      break;
+    }
+    case TRACE_glUniformBlockBinding: {
+      GLuint program = mapName(programs, in.u32());
+      GLuint index = in.u32();
+      std::map<std::pair<GLuint, GLuint>, GLuint>::iterator found =
+          uniformBlocks.find(std::make_pair(program, index));
+      if (found != uniformBlocks.end()) {
+        index = found->second;
+      }
+      glUniformBlockBinding(program, index, in.u32());
+      break;
+    }
+    case TRACE_glUniformMatrix2fv: {
+      GLint uniform = location(in.i32());
+      GLsizei count = in.i32();
+      GLboolean transpose = in.u32();
+      glUniformMatrix2fv(uniform, count, transpose,
+                         in.floats(count * 4, scratch));
+      break;
+    }
+    case TRACE_glUniformMatrix3fv: {
+      GLint uniform = location(in.i32());
+      GLsizei count = in.i32();
+      GLboolean transpose = in.u32();
+      glUniformMatrix3fv(uniform, count, transpose,
+                         in.floats(count * 9, scratch));
+      break;
+    }
+    case TRACE_glUniformMatrix4fv: {
+      GLint uniform = location(in.i32());
+      GLsizei count = in.i32();
+      GLboolean transpose = in.u32();
+      glUniformMatrix4fv(uniform, count, transpose,
+                         in.floats(count * 16, scratch));
+      break;
+    }
+    case TRACE_glUnmapBuffer:
+      glUnmapBuffer(in.u32());
+      break;
+    case TRACE_glUseProgram:
+      currentProgram = mapName(programs, in.u32());
+      glUseProgram(currentProgram);
+      break;
+    case TRACE_glVertexAttribDivisor: {
+      GLuint index = in.u32();
+      glVertexAttribDivisor(index, in.u32());
+      break;
+    }
+    case TRACE_glVertexAttribI4i: {
+      GLuint index = in.u32();
+      GLint x = in.i32();
+      GLint y = in.i32();
+      GLint z = in.i32();
+      glVertexAttribI4i(index, x, y, z, in.i32());
+      break;
+    }
+    case TRACE_glVertexAttribIPointer: {
+      GLuint index = in.u32();
+      GLint size = in.i32();
+      GLenum type = in.u32();
+      GLsizei stride = in.i32();
+      glVertexAttribIPointer(index, size, type, stride,
+                             (const void *)(uintptr_t)in.u64());
+      break;
+    }
+    case TRACE_glVertexAttribPointer: {
+      GLuint index = in.u32();
+      GLint size = in.i32();
+      GLenum type = in.u32();
+      GLboolean normalized = in.u32();
+      GLsizei stride = in.i32();
+      glVertexAttribPointer(index, size, type, normalized, stride,
+                            (const void *)(uintptr_t)in.u64());
+      break;
+    }
+    case TRACE_glViewport: {
+      GLint x = in.i32();
+      GLint y = in.i32();
+      GLsizei width = in.i32();
+      glViewport(x, y, width, in.i32());
+      break;
+    }
+    }
+    return !in.failed;
+  }
+
+  Replayer(const Replayer &);
+  Replayer &operator=(const Replayer &);
+};
+
+// makes a headless context current, the newest core profile available
+static bool createContext() {
+  EGLDisplay display = EGL_NO_DISPLAY;
+  PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+      (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  if (getPlatformDisplay) {
+    display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA,
+                                 EGL_DEFAULT_DISPLAY, NULL);
+  }
+  if (display == EGL_NO_DISPLAY) {
+    display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL)) {
+    std::cout << "ERROR::REPLAY:: no EGL display" << std::endl;
+    return false;
+  }
+  eglBindAPI(EGL_OPENGL_API);
+
+  // without a surface no config is needed, where the display allows that
+  EGLConfig config = EGL_NO_CONFIG_KHR;
+  const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+  if (!extensions || !strstr(extensions, "EGL_KHR_no_config_context")) {
+    const EGLint configAttributes[] = {EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                       EGL_NONE};
+    EGLint configs = 0;
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configs) ||
+        configs == 0) {
+      std::cout << "ERROR::REPLAY:: no OpenGL capable EGL config"
+                << std::endl;
+      return false;
+    }
+  }
+  for (unsigned int i = 0;
+       i < sizeof(CONTEXT_VERSIONS) / sizeof(CONTEXT_VERSIONS[0]); i++) {
+    const EGLint contextAttributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, CONTEXT_VERSIONS[i][0],
+        EGL_CONTEXT_MINOR_VERSION, CONTEXT_VERSIONS[i][1],
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+    EGLContext context =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+    if (context != EGL_NO_CONTEXT) {
+      // no surface, everything is drawn into framebuffer objects
+      return eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                            context) == EGL_TRUE;
+    }
+  }
+  std::cout << "ERROR::REPLAY:: can't create an OpenGL 3.3 core context"
+            << std::endl;
+  return false;
+}
+
+static bool readFile(const char *path, std::vector<unsigned char> &data) {
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    return false;
+  }
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  data.resize(std::max(size, 0L));
+  bool read = size <= 0 || fread(&data[0], 1, size, file) == (size_t)size;
+  fclose(file);
+  return read;
+}
+
+static double percentile(std::vector<double> sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0.0;
+  }
+  std::sort(sorted.begin(), sorted.end());
+  return sorted[std::min((size_t)(fraction * sorted.size()),
+                         sorted.size() - 1)];
+}
+
+static void report(const Replayer &replayer, double seconds) {
+  const std::vector<double> &frames = replayer.frameSeconds;
+  printf("replayed %u frames in %.3f s\n", (unsigned int)frames.size(),
+         seconds);
+  if (!frames.empty()) {
+    double total = 0.0;
+    for (unsigned int i = 0; i < frames.size(); i++) {
+      total += frames[i];
+    }
+    printf("frame ms: mean %.3f  median %.3f  p95 %.3f  max %.3f\n",
+           total / frames.size() * 1e3, percentile(frames, 0.5) * 1e3,
+           percentile(frames, 0.95) * 1e3, percentile(frames, 1.0) * 1e3);
+  }
+  if (replayer.errors != 0) {
+    printf("GL errors: %u\n", replayer.errors);
+  }
+
+  // the most expensive calls first. Frame records include the wait for the
+  // frame's rendering.
+  std::vector<std::pair<double, unsigned int> > order;
+  for (unsigned int i = 0; i < replayer.calls.size(); i++) {
+    if (replayer.calls[i].count != 0 && i != TRACE_BLOB) {
+      order.push_back(std::make_pair(replayer.calls[i].seconds, i));
+    }
+  }
+  std::sort(order.rbegin(), order.rend());
+  printf("%-28s %10s %12s %10s\n", "call", "count", "total ms", "mean us");
+  for (unsigned int i = 0; i < order.size(); i++) {
+    const CallStats &stats = replayer.calls[order[i].second];
+    printf("%-28s %10llu %12.3f %10.3f\n",
+           order[i].second == TRACE_FRAME ? "glFinish (frame end)"
+                                          : glTraceRecordName(order[i].second),
+           (unsigned long long)stats.count, stats.seconds * 1e3,
+           stats.seconds / stats.count * 1e6);
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    std::cout << "usage: " << argv[0] << " trace" << std::endl;
+    return 1;
+  }
+  std::vector<unsigned char> data;
+  if (!readFile(argv[1], data)) {
+    std::cout << "ERROR::REPLAY:: can't read " << argv[1] << std::endl;
+    return 1;
+  }
+  TraceReader in(data);
+  const unsigned char *magic = in.bytes(sizeof(GL_TRACE_MAGIC));
+  uint32_t version = in.u32();
+  if (!magic || memcmp(magic, GL_TRACE_MAGIC, sizeof(GL_TRACE_MAGIC)) != 0 ||
+      version != GL_TRACE_VERSION) {
+    std::cout << "ERROR::REPLAY:: " << argv[1]
+              << " is not a version " << GL_TRACE_VERSION << " GL trace"
+              << std::endl;
+    return 1;
+  }
+
+  if (!createContext()) {
+    return 1;
+  }
+  if (!gladLoadGLLoader((GLADloadproc)eglGetProcAddress)) {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    return 1;
+  }
+  std::cout << "replaying on " << glGetString(GL_RENDERER) << std::endl;
+
+  Replayer replayer;
+  Clock::time_point start = Clock::now();
+  bool complete = replayer.replay(in);
+  glFinish();
+  report(replayer,
+         std::chrono::duration<double>(Clock::now() - start).count());
+  return complete ? 0 : 1;
+}
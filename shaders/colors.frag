@@ -1,8 +1,6 @@
 #version 330 core
 
 struct Material {
-  sampler2D diffuse;
-  sampler2D specular;
   float shininess;
 };
 
@@ -42,11 +40,50 @@ uniform vec3 viewPos;
 uniform Material material;
 #define NUM_DIRECTION_LIGHTS 1
 uniform DirectionLight directionLights[NUM_DIRECTION_LIGHTS];
-#define NUM_POINT_LIGHTS 4
-uniform PointLight pointLights[NUM_POINT_LIGHTS];
+// point lights live in a texture buffer, 4 texels per light (see
+// POINT_LIGHT_TEXELS in src/light.h), so their number is not bounded by the
+// available uniform space
+uniform samplerBuffer pointLightData;
+uniform int numPointLights;
 #define NUM_SPOT_LIGHTS 1
 uniform SpotLight spotLights[NUM_SPOT_LIGHTS];
 
+#ifdef MATERIAL_ARRAYS
+flat in ivec4 MaterialLayers;
+uniform sampler2DArray diffuseLayers;
+uniform sampler2DArray specularLayers;
+
+// added to layers that clamp to the edge, MATERIAL_LAYER_CLAMPED in
+// material_arrays.h
+const int CLAMPED_LAYER = 65536;
+
+// Missing textures have a negative layer and read as black. The arrays
+// repeat, clamped layers keep their coordinates half a texel of the finest
+// resident level inside the edges instead.
+vec4 sampleLayer(sampler2DArray layers, int layer) {
+  if (layer < 0) {
+    return vec4(0.0);
+  }
+  vec2 coords = TexCoords;
+  if (layer >= CLAMPED_LAYER) {
+    vec2 halfTexel = 0.5 / vec2(textureSize(layers, 0).xy);
+    coords = clamp(coords, halfTexel, 1.0 - halfTexel);
+    layer -= CLAMPED_LAYER;
+  }
+  return texture(layers, vec3(coords, layer));
+}
+
+vec4 diffuseTexel() { return sampleLayer(diffuseLayers, MaterialLayers.x); }
+vec4 specularTexel() { return sampleLayer(specularLayers, MaterialLayers.y); }
+#else
+// samplers follow the texture_<type>N convention used by Mesh::Draw
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_specular1;
+
+vec4 diffuseTexel() { return texture(texture_diffuse1, TexCoords); }
+vec4 specularTexel() { return texture(texture_specular1, TexCoords); }
+#endif
+
 vec3 calcBaseLight(BaseLight light, vec3 normal, vec3 viewDir, vec3 lightDir) {
   // diffuse shading
   float diff = max(dot(normal, lightDir), 0.0);
@@ -54,11 +91,11 @@ vec3 calcBaseLight(BaseLight light, vec3 normal, vec3 viewDir, vec3 lightDir) {
   vec3 reflectDir = reflect(-lightDir, normal);
   float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
   // combine results
-  vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
+  vec3 ambient = light.ambient * vec3(diffuseTexel());
   vec3 diffuse =
-      light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
+      light.diffuse * diff * vec3(diffuseTexel());
   vec3 specular =
-      light.specular * spec * vec3(texture(material.specular, TexCoords));
+      light.specular * spec * vec3(specularTexel());
   return ambient + diffuse + specular;
 }
 
@@ -78,6 +115,17 @@ vec3 calcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 fragPos) {
   return attenuation * baseLight;
 }
 
+PointLight fetchPointLight(int index) {
+  vec4 positionConstant = texelFetch(pointLightData, index * 4);
+  vec4 ambientLinear = texelFetch(pointLightData, index * 4 + 1);
+  vec4 diffuseQuadratic = texelFetch(pointLightData, index * 4 + 2);
+  vec4 specularRadius = texelFetch(pointLightData, index * 4 + 3);
+  BaseLight base = BaseLight(ambientLinear.rgb, diffuseQuadratic.rgb,
+                             specularRadius.rgb);
+  return PointLight(base, positionConstant.xyz, positionConstant.w,
+                    ambientLinear.w, diffuseQuadratic.w);
+}
+
 vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 fragPos) {
   vec3 pointLight = calcPointLight(light.point, normal, viewDir, fragPos);
   // spotlight intensity
@@ -92,12 +140,12 @@ void main() {
   vec3 norm = normalize(Normal);
   vec3 viewDir = normalize(viewPos - FragPos);
 
-  vec3 result;
+  vec3 result = vec3(0.0);
   for (int i = 0; i < NUM_DIRECTION_LIGHTS; i++) {
     result += calcDirectionLight(directionLights[i], norm, viewDir);
   }
-  for (int i = 0; i < NUM_POINT_LIGHTS; i++) {
-    result += calcPointLight(pointLights[i], norm, viewDir, FragPos);
+  for (int i = 0; i < numPointLights; i++) {
+    result += calcPointLight(fetchPointLight(i), norm, viewDir, FragPos);
   }
   for (int i = 0; i < NUM_SPOT_LIGHTS; i++) {
     result += calcSpotLight(spotLights[i], norm, viewDir, FragPos);
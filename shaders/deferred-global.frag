@@ -0,0 +1,122 @@
+#version 330 core
+
+struct BaseLight {
+  vec3 ambient;
+  vec3 diffuse;
+  vec3 specular;
+};
+
+struct DirectionLight {
+  BaseLight base;
+  vec3 direction;
+};
+
+struct PointLight {
+  BaseLight base;
+  vec3 position;
+  float constant;
+  float linear;
+  float quadratic;
+};
+
+struct SpotLight {
+  PointLight point;
+  vec3 direction;
+  float cutOff;
+  float outerCutOff;
+};
+
+out vec4 FragColor;
+
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gDepth;
+
+uniform mat4 inverseViewProjection;
+uniform vec2 viewportSize;
+uniform vec3 viewPos;
+uniform float shininess;
+#define NUM_DIRECTION_LIGHTS 1
+uniform DirectionLight directionLights[NUM_DIRECTION_LIGHTS];
+#define NUM_SPOT_LIGHTS 1
+uniform SpotLight spotLights[NUM_SPOT_LIGHTS];
+
+vec2 signNotZero(vec2 v) {
+  return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 decodeNormal(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+  return normalize(n);
+}
+
+vec3 reconstructPosition(float depth) {
+  vec2 uv = gl_FragCoord.xy / viewportSize;
+  vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+  return world.xyz / world.w;
+}
+
+vec3 calcBaseLight(BaseLight light, vec3 normal, vec3 viewDir, vec3 lightDir,
+                   vec3 albedo, float specularIntensity) {
+  // diffuse shading
+  float diff = max(dot(normal, lightDir), 0.0);
+  // specular shading
+  vec3 reflectDir = reflect(-lightDir, normal);
+  float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+  // combine results
+  vec3 ambient = light.ambient * albedo;
+  vec3 diffuse = light.diffuse * diff * albedo;
+  vec3 specular = light.specular * spec * specularIntensity;
+  return ambient + diffuse + specular;
+}
+
+vec3 calcDirectionLight(DirectionLight light, vec3 normal, vec3 viewDir,
+                        vec3 albedo, float specularIntensity) {
+  vec3 lightDir = normalize(-light.direction);
+  return calcBaseLight(light.base, normal, viewDir, lightDir, albedo,
+                       specularIntensity);
+}
+
+vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 fragPos,
+                   vec3 albedo, float specularIntensity) {
+  vec3 lightDir = normalize(light.point.position - fragPos);
+  vec3 baseLight = calcBaseLight(light.point.base, normal, viewDir, lightDir,
+                                 albedo, specularIntensity);
+  // attenuation
+  float distance = length(light.point.position - fragPos);
+  float attenuation =
+      1.0 / (light.point.constant + light.point.linear * distance +
+             light.point.quadratic * (distance * distance));
+  // spotlight intensity
+  float theta = dot(lightDir, normalize(-light.direction));
+  float epsilon = light.cutOff - light.outerCutOff;
+  float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+  return intensity * attenuation * baseLight;
+}
+
+void main() {
+  ivec2 coord = ivec2(gl_FragCoord.xy);
+  float depth = texelFetch(gDepth, coord, 0).r;
+  // nothing was drawn here, leave it to the skybox
+  if (depth == 1.0)
+    discard;
+
+  vec3 fragPos = reconstructPosition(depth);
+  vec3 norm = decodeNormal(texelFetch(gNormal, coord, 0).xy);
+  vec4 albedoSpec = texelFetch(gAlbedoSpec, coord, 0);
+  vec3 viewDir = normalize(viewPos - fragPos);
+
+  vec3 result = vec3(0.0);
+  for (int i = 0; i < NUM_DIRECTION_LIGHTS; i++) {
+    result += calcDirectionLight(directionLights[i], norm, viewDir,
+                                 albedoSpec.rgb, albedoSpec.a);
+  }
+  for (int i = 0; i < NUM_SPOT_LIGHTS; i++) {
+    result += calcSpotLight(spotLights[i], norm, viewDir, fragPos,
+                            albedoSpec.rgb, albedoSpec.a);
+  }
+
+  FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,68 @@
+#version 330 core
+out vec4 FragColor;
+
+flat in int LightIndex;
+
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedoSpec;
+uniform sampler2D gDepth;
+// 4 texels per light, see POINT_LIGHT_TEXELS in src/light.h
+uniform samplerBuffer pointLightData;
+
+uniform mat4 inverseViewProjection;
+uniform vec2 viewportSize;
+uniform vec3 viewPos;
+uniform float shininess;
+
+vec2 signNotZero(vec2 v) {
+  return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec3 decodeNormal(vec2 e) {
+  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+  if (n.z < 0.0)
+    n.xy = (1.0 - abs(n.yx)) * signNotZero(n.xy);
+  return normalize(n);
+}
+
+vec3 reconstructPosition(float depth) {
+  vec2 uv = gl_FragCoord.xy / viewportSize;
+  vec4 world = inverseViewProjection * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+  return world.xyz / world.w;
+}
+
+void main() {
+  ivec2 coord = ivec2(gl_FragCoord.xy);
+  vec3 fragPos = reconstructPosition(texelFetch(gDepth, coord, 0).r);
+
+  vec4 positionConstant = texelFetch(pointLightData, LightIndex * 4);
+  vec4 ambientLinear = texelFetch(pointLightData, LightIndex * 4 + 1);
+  vec4 diffuseQuadratic = texelFetch(pointLightData, LightIndex * 4 + 2);
+  vec4 specularRadius = texelFetch(pointLightData, LightIndex * 4 + 3);
+
+  // the surface is in front of the light volume
+  float distance = length(positionConstant.xyz - fragPos);
+  if (distance > specularRadius.w)
+    discard;
+
+  vec3 norm = decodeNormal(texelFetch(gNormal, coord, 0).xy);
+  vec4 albedoSpec = texelFetch(gAlbedoSpec, coord, 0);
+  vec3 viewDir = normalize(viewPos - fragPos);
+  vec3 lightDir = (positionConstant.xyz - fragPos) / distance;
+
+  // diffuse shading
+  float diff = max(dot(norm, lightDir), 0.0);
+  // specular shading
+  vec3 reflectDir = reflect(-lightDir, norm);
+  float spec = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+  // combine results
+  vec3 ambient = ambientLinear.rgb * albedoSpec.rgb;
+  vec3 diffuse = diffuseQuadratic.rgb * diff * albedoSpec.rgb;
+  vec3 specular = specularRadius.rgb * spec * albedoSpec.a;
+  // attenuation
+  float attenuation =
+      1.0 / (positionConstant.w + ambientLinear.w * distance +
+             diffuseQuadratic.w * (distance * distance));
+
+  FragColor = vec4(attenuation * (ambient + diffuse + specular), 1.0);
+}
@@ -0,0 +1,17 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+
+flat out int LightIndex;
+
+// 4 texels per light, see POINT_LIGHT_TEXELS in src/light.h
+uniform samplerBuffer pointLightData;
+uniform mat4 view;
+uniform mat4 projection;
+
+void main() {
+  LightIndex = gl_InstanceID;
+  vec3 position = texelFetch(pointLightData, gl_InstanceID * 4).xyz;
+  float radius = texelFetch(pointLightData, gl_InstanceID * 4 + 3).w;
+
+  gl_Position = projection * view * vec4(position + aPos * radius, 1.0);
+}
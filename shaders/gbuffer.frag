@@ -0,0 +1,59 @@
+#version 330 core
+layout(location = 0) out vec2 gNormal;
+layout(location = 1) out vec4 gAlbedoSpec;
+
+in vec3 Normal;
+in vec2 TexCoords;
+
+#ifdef MATERIAL_ARRAYS
+flat in ivec4 MaterialLayers;
+uniform sampler2DArray diffuseLayers;
+uniform sampler2DArray specularLayers;
+
+// added to layers that clamp to the edge, MATERIAL_LAYER_CLAMPED in
+// material_arrays.h
+const int CLAMPED_LAYER = 65536;
+
+// Missing textures have a negative layer and read as black. The arrays
+// repeat, clamped layers keep their coordinates half a texel of the finest
+// resident level inside the edges instead.
+vec4 sampleLayer(sampler2DArray layers, int layer) {
+  if (layer < 0) {
+    return vec4(0.0);
+  }
+  vec2 coords = TexCoords;
+  if (layer >= CLAMPED_LAYER) {
+    vec2 halfTexel = 0.5 / vec2(textureSize(layers, 0).xy);
+    coords = clamp(coords, halfTexel, 1.0 - halfTexel);
+    layer -= CLAMPED_LAYER;
+  }
+  return texture(layers, vec3(coords, layer));
+}
+
+vec4 diffuseTexel() { return sampleLayer(diffuseLayers, MaterialLayers.x); }
+vec4 specularTexel() { return sampleLayer(specularLayers, MaterialLayers.y); }
+#else
+// samplers follow the texture_<type>N convention used by Mesh::Draw
+uniform sampler2D texture_diffuse1;
+uniform sampler2D texture_specular1;
+
+vec4 diffuseTexel() { return texture(texture_diffuse1, TexCoords); }
+vec4 specularTexel() { return texture(texture_specular1, TexCoords); }
+#endif
+
+vec2 signNotZero(vec2 v) {
+  return vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+// octahedral encoding: project onto the octahedron |x| + |y| + |z| = 1 and
+// fold the lower hemisphere over the upper one
+vec2 encodeNormal(vec3 n) {
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  return n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * signNotZero(n.xy);
+}
+
+void main() {
+  gNormal = encodeNormal(normalize(Normal));
+  gAlbedoSpec.rgb = diffuseTexel().rgb;
+  gAlbedoSpec.a = specularTexel().r;
+}
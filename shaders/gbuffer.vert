@@ -0,0 +1,47 @@
+#version 330 core
+layout(location = 0) in vec3 aPos;
+layout(location = 1) in vec3 aNormal;
+layout(location = 2) in vec2 aTexCoords;
+layout(location = 5) in ivec4 aBoneIds;
+layout(location = 6) in vec4 aWeights;
+#ifdef MATERIAL_ARRAYS
+// the mesh's diffuse, specular, normal and height layers, see MaterialArrays
+// in src/material_arrays.h
+layout(location = 7) in ivec4 aMaterialLayers;
+flat out ivec4 MaterialLayers;
+#endif
+
+out vec3 Normal;
+out vec2 TexCoords;
+
+#ifdef INSTANCE_TRANSFORMS
+// one per instance, see InstanceBatch in src/instance_batch.h
+layout(location = 8) in mat4 model;
+#else
+uniform mat4 model;
+#endif
+uniform mat4 view;
+uniform mat4 projection;
+
+// bone palette for GPU skinning, see BoneBuffer in src/animation.h
+#define MAX_BONES 100
+layout(std140) uniform Bones { mat4 bones[MAX_BONES]; };
+
+// static vertices have no weights and keep their bind pose
+mat4 skinMatrix() {
+  if (aWeights == vec4(0.0))
+    return mat4(1.0);
+  return bones[aBoneIds.x] * aWeights.x + bones[aBoneIds.y] * aWeights.y +
+         bones[aBoneIds.z] * aWeights.z + bones[aBoneIds.w] * aWeights.w;
+}
+
+void main() {
+  mat4 skinnedModel = model * skinMatrix();
+  Normal = mat3(transpose(inverse(skinnedModel))) * aNormal;
+  TexCoords = aTexCoords;
+#ifdef MATERIAL_ARRAYS
+  MaterialLayers = aMaterialLayers;
+#endif
+
+  gl_Position = projection * view * skinnedModel * vec4(aPos, 1.0);
+}
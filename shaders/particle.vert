@@ -0,0 +1,20 @@
+#version 330 core
+// A quad facing the camera per particle, see src/particle_renderer.h
+layout(location = 0) in vec2 aCorner;
+// the position and how far through its life the particle is
+layout(location = 1) in vec4 aParticle;
+
+out vec2 TexCoords;
+
+uniform mat4 view;
+uniform mat4 projection;
+uniform float particleSize;
+
+void main() {
+  // shrinks away towards the end of its life
+  float size = particleSize * (1.0 - aParticle.w);
+  vec4 center = view * vec4(aParticle.xyz, 1.0);
+  gl_Position = projection * (center + vec4(aCorner * size, 0.0, 0.0));
+  // images are stored top row first
+  TexCoords = vec2(aCorner.x + 0.5, 0.5 - aCorner.y);
+}
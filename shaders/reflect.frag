@@ -6,16 +6,19 @@ in vec3 Position;
 
 uniform vec3 cameraPos;
 uniform samplerCube skybox;
+// rougher surfaces sample blurrier mip levels, up to maxLod
+uniform float roughness;
+uniform float maxLod;
 
 void main() {
   // reflect
   // vec3 I = normalize(Position - cameraPos);
   // vec3 R = reflect(I, normalize(Normal));
-  // FragColor = vec4(texture(skybox, R).rgb, 1.0);
+  // FragColor = vec4(textureLod(skybox, R, roughness * maxLod).rgb, 1.0);
 
   // refract
   float ratio = 1.00 / 1.52;
   vec3 I = normalize(Position - cameraPos);
   vec3 R = refract(I, normalize(Normal), ratio);
-  FragColor = vec4(texture(skybox, R).rgb, 1.0);
+  FragColor = vec4(textureLod(skybox, R, roughness * maxLod).rgb, 1.0);
 }
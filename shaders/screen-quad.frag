@@ -4,6 +4,11 @@ out vec4 FragColor;
 in vec2 TexCoords;
 
 uniform sampler2D screenTexture;
+// part of screenTexture that was rendered to, and the size of its texels
+uniform vec2 uvScale;
+uniform vec2 texelSize;
+// strength of the sharpening applied when upscaling
+uniform float sharpness;
 
 const float offset = 1.0 / 300.0;
 vec2 offsets[9] = vec2[](vec2(-offset, offset),  // top-left
@@ -17,10 +22,17 @@ vec2 offsets[9] = vec2[](vec2(-offset, offset),  // top-left
                          vec2(offset, -offset)   // bottom-right
 );
 
-vec3 runKernel(float[9] kernel) {
+// samples the rendered part only, the rest of the texture holds stale pixels
+vec3 sampleScreen(vec2 uv) {
+  return texture(screenTexture,
+                 clamp(uv, 0.5 * texelSize, uvScale - 0.5 * texelSize))
+      .rgb;
+}
+
+vec3 runKernel(vec2 uv, float[9] kernel) {
   vec3 sampleTex[9];
   for (int i = 0; i < 9; i++) {
-    sampleTex[i] = vec3(texture(screenTexture, TexCoords.st + offsets[i]));
+    sampleTex[i] = sampleScreen(uv + offsets[i]);
   }
   vec3 col = vec3(0.0);
   for (int i = 0; i < 9; i++)
@@ -28,21 +40,39 @@ vec3 runKernel(float[9] kernel) {
   return col;
 }
 
+// Bilinear upsample followed by a sharpening filter that restores some of
+// the detail lost by rendering at a lower resolution. The result is clamped
+// to the range of the neighbours so that edges don't ring.
+vec3 sharpenedUpsample(vec2 uv) {
+  vec3 center = sampleScreen(uv);
+  vec3 north = sampleScreen(uv + vec2(0.0, texelSize.y));
+  vec3 south = sampleScreen(uv - vec2(0.0, texelSize.y));
+  vec3 east = sampleScreen(uv + vec2(texelSize.x, 0.0));
+  vec3 west = sampleScreen(uv - vec2(texelSize.x, 0.0));
+  vec3 minimum = min(center, min(min(north, south), min(east, west)));
+  vec3 maximum = max(center, max(max(north, south), max(east, west)));
+  vec3 sharpened =
+      center + sharpness * (4.0 * center - north - south - east - west);
+  return clamp(sharpened, minimum, maximum);
+}
+
 void main() {
+  vec2 uv = TexCoords * uvScale;
+
   // normal
-  vec3 col = texture(screenTexture, TexCoords).rgb;
+  vec3 col = sharpenedUpsample(uv);
   FragColor = vec4(col, 1.0);
 
   // inverted
-  // FragColor = vec4(vec3(1.0 - texture(screenTexture, TexCoords)), 1.0);
+  // FragColor = vec4(1.0 - sampleScreen(uv), 1.0);
 
   // greyscale
-  // FragColor = texture(screenTexture, TexCoords);
+  // FragColor = vec4(sampleScreen(uv), 1.0);
   // float average = (FragColor.r + FragColor.g + FragColor.b) / 3.0;
   // FragColor = vec4(average, average, average, 1.0);
 
   // better greyscale
-  // FragColor = texture(screenTexture, TexCoords);
+  // FragColor = vec4(sampleScreen(uv), 1.0);
   // float average =
   // 0.2126 * FragColor.r + 0.7152 * FragColor.g + 0.0722 * FragColor.b;
   // FragColor = vec4(average, average, average, 1.0);
@@ -52,7 +82,7 @@ void main() {
   //-1, 9, -1,  //
   //-1, -1, -1  //
   //);
-  // vec3 col = runKernel(kernel);
+  // vec3 col = runKernel(uv, kernel);
   // FragColor = vec4(col, 1.0);
 
   // blur
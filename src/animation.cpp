@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "animation.h"
+#include "scene_graph.h"
+#include "shader.h"
+
+template <typename Key> static bool keyBefore(float time, const Key &key) {
+  return time < key.time;
+}
+
+// finds the keys surrounding time and how far between them it lies
+template <typename Key>
+static void findKeys(const std::vector<Key> &keys, float time,
+                     unsigned int &first, unsigned int &second,
+                     float &factor) {
+  typename std::vector<Key>::const_iterator next =
+      std::upper_bound(keys.begin(), keys.end(), time, keyBefore<Key>);
+  if (next == keys.begin()) {
+    first = second = 0;
+    factor = 0.0f;
+    return;
+  }
+  if (next == keys.end()) {
+    first = second = keys.size() - 1;
+    factor = 0.0f;
+    return;
+  }
+  second = next - keys.begin();
+  first = second - 1;
+  float span = keys[second].time - keys[first].time;
+  factor = span > 0.0f ? (time - keys[first].time) / span : 0.0f;
+}
+
+static glm::vec3 sampleVector(const std::vector<VectorKey> &keys, float time,
+                              const glm::vec3 &fallback) {
+  if (keys.empty()) {
+    return fallback;
+  }
+  unsigned int first, second;
+  float factor;
+  findKeys(keys, time, first, second, factor);
+  return glm::mix(keys[first].value, keys[second].value, factor);
+}
+
+static glm::quat sampleRotation(const std::vector<RotationKey> &keys,
+                                float time) {
+  if (keys.empty()) {
+    return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+  }
+  unsigned int first, second;
+  float factor;
+  findKeys(keys, time, first, second, factor);
+  return glm::normalize(
+      glm::slerp(keys[first].value, keys[second].value, factor));
+}
+
+void sampleClip(const AnimationClip &clip, float time, SceneGraph &pose) {
+  if (clip.duration > 0.0f) {
+    time = std::fmod(time, clip.duration);
+    if (time < 0.0f) {
+      time += clip.duration;
+    }
+  }
+  for (unsigned int i = 0; i < clip.channels.size(); i++) {
+    const AnimationChannel &channel = clip.channels[i];
+    glm::vec3 position =
+        sampleVector(channel.positions, time, glm::vec3(0.0f));
+    glm::quat rotation = sampleRotation(channel.rotations, time);
+    glm::vec3 scale = sampleVector(channel.scales, time, glm::vec3(1.0f));
+
+    glm::mat4 local = glm::translate(glm::mat4(1.0f), position) *
+                      glm::mat4_cast(rotation) *
+                      glm::scale(glm::mat4(1.0f), scale);
+    pose.setLocal(channel.node, local);
+  }
+}
+
+void computeBoneMatrices(const Skeleton &skeleton, const SceneGraph &pose,
+                         std::vector<glm::mat4> &bones) {
+  bones.resize(skeleton.boneNodes.size());
+  glm::mat4 world;
+  for (unsigned int i = 0; i < skeleton.boneNodes.size(); i++) {
+    multiplyMatrices(skeleton.globalInverse,
+                     pose.getWorld(skeleton.boneNodes[i]), world);
+    multiplyMatrices(world, skeleton.boneOffsets[i], bones[i]);
+  }
+}
+
+PoseCache::PoseCache(const Skeleton &skeleton, const SceneGraph &bindPose,
+                     const std::vector<AnimationClip> &clips, float sampleRate)
+    : skeleton(skeleton), clips(clips), pose(bindPose), sampleRate(sampleRate),
+      frames(clips.size()) {}
+
+const std::vector<glm::mat4> &PoseCache::frame(unsigned int clip,
+                                               unsigned int index) {
+  std::vector<std::vector<glm::mat4> > &clipFrames = frames[clip];
+  if (clipFrames.empty()) {
+    unsigned int count =
+        (unsigned int)std::ceil(clips[clip].duration * sampleRate) + 1;
+    clipFrames.resize(count);
+  }
+  index = std::min<unsigned int>(index, clipFrames.size() - 1);
+  std::vector<glm::mat4> &palette = clipFrames[index];
+  if (palette.empty()) {
+    sampleClip(clips[clip], index / sampleRate, pose);
+    pose.update();
+    computeBoneMatrices(skeleton, pose, palette);
+  }
+  return palette;
+}
+
+void PoseCache::evaluate(unsigned int clip, float time,
+                         std::vector<glm::mat4> &bones) {
+  float duration = clips[clip].duration;
+  if (duration > 0.0f) {
+    time = std::fmod(time, duration);
+    if (time < 0.0f) {
+      time += duration;
+    }
+  }
+  float position = time * sampleRate;
+  unsigned int index = (unsigned int)position;
+  float factor = position - index;
+
+  const std::vector<glm::mat4> &first = frame(clip, index);
+  const std::vector<glm::mat4> &second = frame(clip, index + 1);
+  bones.resize(first.size());
+  for (unsigned int i = 0; i < first.size(); i++) {
+    bones[i] = first[i] * (1.0f - factor) + second[i] * factor;
+  }
+}
+
+Animator::Animator(PoseCache &cache, unsigned int clip)
+    : cache(cache), clip(clip), time(0.0f) {
+  cache.evaluate(clip, time, bones);
+}
+
+void Animator::play(unsigned int clip) {
+  this->clip = clip;
+  time = 0.0f;
+}
+
+void Animator::update(float deltaTime) {
+  time += deltaTime;
+  cache.evaluate(clip, time, bones);
+}
+
+BoneBuffer::BoneBuffer() {
+  glGenBuffers(1, &UBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  // start out with identity matrices so that binding it is always safe
+  std::vector<glm::mat4> identity(MAX_BONES, glm::mat4(1.0f));
+  glBufferData(GL_UNIFORM_BUFFER, MAX_BONES * sizeof(glm::mat4), &identity[0],
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+BoneBuffer::~BoneBuffer() { glDeleteBuffers(1, &UBO); }
+
+void BoneBuffer::upload(const std::vector<glm::mat4> &bones) {
+  unsigned int count = std::min<unsigned int>(bones.size(), MAX_BONES);
+  glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+  if (count > 0) {
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, count * sizeof(glm::mat4),
+                    &bones[0]);
+  }
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  bind();
+}
+
+void BoneBuffer::bind() {
+  glBindBufferBase(GL_UNIFORM_BUFFER, BONE_BUFFER_BINDING, UBO);
+}
+
+void BoneBuffer::attach(const Shader &shader) {
+  unsigned int index = glGetUniformBlockIndex(shader.ID, "Bones");
+  if (index != GL_INVALID_INDEX) {
+    glUniformBlockBinding(shader.ID, index, BONE_BUFFER_BINDING);
+  }
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "scene_graph.h"
+#include "shader.h"
+
+// Maximum number of bones in a skeleton. Must match MAX_BONES in the vertex
+// shaders' Bones uniform block.
+const unsigned int MAX_BONES = 100;
+
+// Uniform buffer binding point of the Bones block
+const unsigned int BONE_BUFFER_BINDING = 0;
+
+struct Skeleton {
+  // scene graph node driving each bone
+  std::vector<unsigned int> boneNodes;
+  // transforms from mesh space into each bone's bind pose space
+  std::vector<glm::mat4> boneOffsets;
+  std::map<std::string, unsigned int> boneIndices;
+  // inverse of the root node's transform
+  glm::mat4 globalInverse;
+};
+
+struct VectorKey {
+  float time;
+  glm::vec3 value;
+};
+
+struct RotationKey {
+  float time;
+  glm::quat value;
+};
+
+// Keyframes of a single node, times are in seconds
+struct AnimationChannel {
+  unsigned int node;
+  std::vector<VectorKey> positions;
+  std::vector<RotationKey> rotations;
+  std::vector<VectorKey> scales;
+};
+
+struct AnimationClip {
+  std::string name;
+  // in seconds
+  float duration;
+  std::vector<AnimationChannel> channels;
+};
+
+// Writes the local transforms of the nodes animated by clip at the given time
+// (in seconds, wrapped around the clip's duration) into pose
+void sampleClip(const AnimationClip &clip, float time, SceneGraph &pose);
+
+// Computes the skinning matrix of every bone from an updated pose
+void computeBoneMatrices(const Skeleton &skeleton, const SceneGraph &pose,
+                         std::vector<glm::mat4> &bones);
+
+// Caches bone palettes sampled at a fixed rate, so that all characters
+// playing the same clip share the keyframe sampling and hierarchy update.
+// Palettes between two samples are blended linearly. A clip's frames are
+// only computed the first time they are requested.
+class PoseCache {
+public:
+  // skeleton, bindPose and clips must outlive the cache
+  PoseCache(const Skeleton &skeleton, const SceneGraph &bindPose,
+            const std::vector<AnimationClip> &clips,
+            float sampleRate = 30.0f);
+
+  void evaluate(unsigned int clip, float time, std::vector<glm::mat4> &bones);
+
+private:
+  const Skeleton &skeleton;
+  const std::vector<AnimationClip> &clips;
+  SceneGraph pose;
+  float sampleRate;
+  // palette of every sampled frame of every clip, empty until requested
+  std::vector<std::vector<std::vector<glm::mat4> > > frames;
+
+  const std::vector<glm::mat4> &frame(unsigned int clip, unsigned int index);
+};
+
+// Playback state of a single animated character
+class Animator {
+public:
+  // current skinning matrices, updated by update()
+  std::vector<glm::mat4> bones;
+
+  Animator(PoseCache &cache, unsigned int clip = 0);
+
+  void play(unsigned int clip);
+
+  void update(float deltaTime);
+
+private:
+  PoseCache &cache;
+  unsigned int clip;
+  float time;
+};
+
+// Bone palette stored in a uniform buffer for GPU skinning
+class BoneBuffer {
+public:
+  BoneBuffer();
+  ~BoneBuffer();
+
+  // uploads at most MAX_BONES matrices and binds the buffer to
+  // BONE_BUFFER_BINDING
+  void upload(const std::vector<glm::mat4> &bones);
+
+  void bind();
+
+  // connects the shader's Bones block (if any) to BONE_BUFFER_BINDING
+  static void attach(const Shader &shader);
+
+private:
+  unsigned int UBO;
+
+  BoneBuffer(const BoneBuffer &);
+  BoneBuffer &operator=(const BoneBuffer &);
+};
@@ -23,6 +23,10 @@ glm::mat4 Camera::getViewMatrix() {
   return glm::lookAt(position, position + front, up);
 }
 
+glm::mat4 Camera::getViewMatrix(const glm::vec3 &eye) {
+  return glm::lookAt(eye, eye + front, up);
+}
+
 glm::mat4 Camera::getProjectionMatrix(float aspect, float near, float far) {
   return glm::perspective(glm::radians(zoom), aspect, near, far);
 }
@@ -31,6 +31,9 @@ public:
 
   // Returns the view matrix calculated using Euler Angles and the LookAt Matrix
   glm::mat4 getViewMatrix();
+  // Returns the view matrix looking from another position, such as one
+  // interpolated between simulation steps
+  glm::mat4 getViewMatrix(const glm::vec3 &eye);
 
   // Returns the projection matrix with a given aspect, near and far
   glm::mat4 getProjectionMatrix(float aspect, float near, float far);
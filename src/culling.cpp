@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "scene_graph.h"
+
+// below this many items a comparison sort beats the radix sort's passes
+const size_t RADIX_SORT_THRESHOLD = 256;
+
+AABB computeBounds(const glm::vec3 *points, size_t count, size_t stride) {
+  AABB box;
+  if (count == 0) {
+    box.min = box.max = glm::vec3(0.0f);
+    return box;
+  }
+  const char *bytes = (const char *)points;
+  box.min = box.max = points[0];
+  for (size_t i = 1; i < count; i++) {
+    const glm::vec3 &p = *(const glm::vec3 *)(bytes + i * stride);
+    box.min.x = std::min(box.min.x, p.x);
+    box.min.y = std::min(box.min.y, p.y);
+    box.min.z = std::min(box.min.z, p.z);
+    box.max.x = std::max(box.max.x, p.x);
+    box.max.y = std::max(box.max.y, p.y);
+    box.max.z = std::max(box.max.z, p.z);
+  }
+  return box;
+}
+
+AABB transformBounds(const AABB &box, const glm::mat4 &transform) {
+  // transform the center and add up the extents projected onto each axis
+  glm::vec3 center = (box.min + box.max) * 0.5f;
+  glm::vec3 extent = (box.max - box.min) * 0.5f;
+  glm::vec3 newCenter(transform * glm::vec4(center, 1.0f));
+  glm::vec3 newExtent(0.0f);
+  for (int row = 0; row < 3; row++) {
+    for (int column = 0; column < 3; column++) {
+      newExtent[row] += std::abs(transform[column][row]) * extent[column];
+    }
+  }
+  AABB result;
+  result.min = newCenter - newExtent;
+  result.max = newCenter + newExtent;
+  return result;
+}
+
+Frustum extractFrustum(const glm::mat4 &viewProjection) {
+  // each plane is the last row of the matrix plus or minus one of the others
+  // (Gribb & Hartmann). glm is column-major, so row i is m[0..3][i].
+  const glm::mat4 &m = viewProjection;
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++) {
+    rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  }
+  Frustum frustum;
+  frustum.planes[0] = rows[3] + rows[0]; // left
+  frustum.planes[1] = rows[3] - rows[0]; // right
+  frustum.planes[2] = rows[3] + rows[1]; // bottom
+  frustum.planes[3] = rows[3] - rows[1]; // top
+  frustum.planes[4] = rows[3] + rows[2]; // near
+  frustum.planes[5] = rows[3] - rows[2]; // far
+  return frustum;
+}
+
+bool isVisible(const Frustum &frustum, const AABB &box) {
+  for (int i = 0; i < 6; i++) {
+    const glm::vec4 &plane = frustum.planes[i];
+    // the corner furthest along the plane's normal
+    float x = plane.x >= 0.0f ? box.max.x : box.min.x;
+    float y = plane.y >= 0.0f ? box.max.y : box.min.y;
+    float z = plane.z >= 0.0f ? box.max.z : box.min.z;
+    if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0.0f) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void cullBounds(const Frustum &frustum, const std::vector<AABB> &boxes,
+                std::vector<unsigned int> &visible) {
+  visible.clear();
+  for (unsigned int i = 0; i < boxes.size(); i++) {
+    if (isVisible(frustum, boxes[i])) {
+      visible.push_back(i);
+    }
+  }
+}
+
+void cullInstances(const Frustum &frustum, const std::vector<AABB> &meshBounds,
+                   const std::vector<glm::mat4> &meshTransforms,
+                   const std::vector<glm::mat4> &instances,
+                   std::vector<unsigned int> &visible) {
+  visible.clear();
+  glm::mat4 world;
+  for (unsigned int mesh = 0; mesh < meshBounds.size(); mesh++) {
+    for (unsigned int i = 0; i < instances.size(); i++) {
+      multiplyMatrices(instances[i], meshTransforms[mesh], world);
+      if (isVisible(frustum, transformBounds(meshBounds[mesh], world))) {
+        visible.push_back(mesh * instances.size() + i);
+      }
+    }
+  }
+}
+
+uint64_t makeSortKey(uint32_t state, float depth) {
+  // the bits of non-negative floats sort in the same order as their values
+  depth = std::max(depth, 0.0f);
+  uint32_t depthBits;
+  std::memcpy(&depthBits, &depth, sizeof(depthBits));
+  return (uint64_t)state << 32 | depthBits;
+}
+
+static bool keyLess(const DrawItem &a, const DrawItem &b) {
+  return a.key < b.key;
+}
+
+void sortDrawItems(std::vector<DrawItem> &items) {
+  if (items.size() < RADIX_SORT_THRESHOLD) {
+    std::stable_sort(items.begin(), items.end(), keyLess);
+    return;
+  }
+  // least significant digit first radix sort on bytes, skipping the bytes
+  // every key has in common
+  std::vector<DrawItem> scratch(items.size());
+  std::vector<DrawItem> *from = &items;
+  std::vector<DrawItem> *to = &scratch;
+  for (unsigned int shift = 0; shift < 64; shift += 8) {
+    size_t offsets[257] = {0};
+    for (size_t i = 0; i < from->size(); i++) {
+      offsets[(((*from)[i].key >> shift) & 0xff) + 1]++;
+    }
+    if (offsets[(((*from)[0].key >> shift) & 0xff) + 1] == from->size()) {
+      continue;
+    }
+    for (unsigned int digit = 0; digit < 256; digit++) {
+      offsets[digit + 1] += offsets[digit];
+    }
+    for (size_t i = 0; i < from->size(); i++) {
+      const DrawItem &item = (*from)[i];
+      (*to)[offsets[(item.key >> shift) & 0xff]++] = item;
+    }
+    std::swap(from, to);
+  }
+  if (from != &items) {
+    items.swap(scratch);
+  }
+}
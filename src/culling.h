@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box
+struct AABB {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// The six planes bounding the visible volume, as (normal, distance) with the
+// normals pointing inwards. Not normalized, which doesn't matter for
+// checking which side of a plane something lies on.
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+// Bounds of count points stride bytes apart, such as the positions in an
+// array of vertices. An empty box at the origin if there are none.
+AABB computeBounds(const glm::vec3 *points, size_t count,
+                   size_t stride = sizeof(glm::vec3));
+
+// Bounds of box after transforming it by transform. Encloses the transformed
+// box, which may make it larger than the tightest bounds of the contents.
+AABB transformBounds(const AABB &box, const glm::mat4 &transform);
+
+// Extracts the frustum planes from a projection * view matrix
+Frustum extractFrustum(const glm::mat4 &viewProjection);
+
+// Returns false only if box lies entirely outside one of the planes. Boxes
+// near the corners of the frustum may be reported visible when they aren't.
+bool isVisible(const Frustum &frustum, const AABB &box);
+
+// Collects the indices of the visible boxes in visible, in order
+void cullBounds(const Frustum &frustum, const std::vector<AABB> &boxes,
+                std::vector<unsigned int> &visible);
+
+// Culls every instance of a set of meshes, each with its bounds and the
+// transform placing it in the instance, the way Model::Draw culls a static
+// mesh. Collects mesh * instances.size() + instance for the visible ones in
+// visible, in order.
+void cullInstances(const Frustum &frustum, const std::vector<AABB> &meshBounds,
+                   const std::vector<glm::mat4> &meshTransforms,
+                   const std::vector<glm::mat4> &instances,
+                   std::vector<unsigned int> &visible);
+
+// A draw to be ordered by its key
+struct DrawItem {
+  uint64_t key;
+  unsigned int index;
+};
+
+// Builds a key ordering draws by state first (e.g. shader and material) and
+// then front to back by view depth within the same state
+uint64_t makeSortKey(uint32_t state, float depth);
+
+// Sorts draws by ascending key. Stable, so draws with equal keys keep their
+// submission order.
+void sortDrawItems(std::vector<DrawItem> &items);
@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "animation.h"
+#include "deferred.h"
+#include "instance_batch.h"
+#include "light.h"
+#include "material_arrays.h"
+#include "shader.h"
+#include "telemetry.h"
+
+// texture units used by the lighting passes
+const unsigned int GBUFFER_NORMAL_UNIT = 0;
+const unsigned int GBUFFER_ALBEDO_SPEC_UNIT = 1;
+const unsigned int GBUFFER_DEPTH_UNIT = 2;
+const unsigned int POINT_LIGHT_DATA_UNIT = 3;
+
+// tessellation of the light volume sphere
+const unsigned int SPHERE_SLICES = 16;
+const unsigned int SPHERE_STACKS = 12;
+
+GBuffer::GBuffer(int width, int height) : width(width), height(height) {
+  create();
+}
+
+GBuffer::~GBuffer() { destroy(); }
+
+void GBuffer::resize(int width, int height) {
+  if (width == this->width && height == this->height) {
+    return;
+  }
+  destroy();
+  this->width = width;
+  this->height = height;
+  create();
+}
+
+static unsigned int createAttachment(GLenum internalFormat, GLenum format,
+                                     GLenum type, int width, int height) {
+  unsigned int texture;
+  glGenTextures(1, &texture);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, format,
+               type, NULL);
+  // the lighting passes use texelFetch, but keep the textures complete
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  return texture;
+}
+
+void GBuffer::create() {
+  glGenFramebuffers(1, &FBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+  normal = createAttachment(GL_RG16F, GL_RG, GL_FLOAT, width, height);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         normal, 0);
+  albedoSpec =
+      createAttachment(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, width, height);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D,
+                         albedoSpec, 0);
+  depth = createAttachment(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL,
+                           GL_UNSIGNED_INT_24_8, width, height);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                         GL_TEXTURE_2D, depth, 0);
+
+  unsigned int attachments[2] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
+  glDrawBuffers(2, attachments);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "ERROR::FRAMEBUFFER:: G-buffer is not complete!" << std::endl;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void GBuffer::destroy() {
+  glDeleteFramebuffers(1, &FBO);
+  glDeleteTextures(1, &normal);
+  glDeleteTextures(1, &albedoSpec);
+  glDeleteTextures(1, &depth);
+}
+
+DeferredRenderer::DeferredRenderer(int width, int height)
+    : gbuffer(width, height), shininess(32.0f), viewportWidth(width),
+      viewportHeight(height),
+      // drawn models must pack their textures into arrays, see
+      // Model::textureArrays
+      geometryShader("shaders/gbuffer.vert", "shaders/gbuffer.frag",
+                     MATERIAL_ARRAYS_DEFINE),
+      instancedGeometryShader("shaders/gbuffer.vert", "shaders/gbuffer.frag",
+                              std::string(MATERIAL_ARRAYS_DEFINE) +
+                                  INSTANCE_TRANSFORMS_DEFINE),
+      globalLightShader("shaders/screen-quad.vert",
+                        "shaders/deferred-global.frag"),
+      pointLightShader("shaders/deferred-point.vert",
+                       "shaders/deferred-point.frag") {
+  setupQuad();
+  setupSphere();
+
+  BoneBuffer::attach(geometryShader);
+  MaterialArrays::attach(geometryShader);
+  BoneBuffer::attach(instancedGeometryShader);
+  MaterialArrays::attach(instancedGeometryShader);
+
+  globalLightShader.use();
+  globalLightShader.setInt("gNormal", GBUFFER_NORMAL_UNIT);
+  globalLightShader.setInt("gAlbedoSpec", GBUFFER_ALBEDO_SPEC_UNIT);
+  globalLightShader.setInt("gDepth", GBUFFER_DEPTH_UNIT);
+
+  pointLightShader.use();
+  pointLightShader.setInt("gNormal", GBUFFER_NORMAL_UNIT);
+  pointLightShader.setInt("gAlbedoSpec", GBUFFER_ALBEDO_SPEC_UNIT);
+  pointLightShader.setInt("gDepth", GBUFFER_DEPTH_UNIT);
+  pointLightShader.setInt("pointLightData", POINT_LIGHT_DATA_UNIT);
+}
+
+DeferredRenderer::~DeferredRenderer() {
+  glDeleteVertexArrays(1, &quadVAO);
+  glDeleteBuffers(1, &quadVBO);
+  glDeleteVertexArrays(1, &sphereVAO);
+  glDeleteBuffers(1, &sphereVBO);
+  glDeleteBuffers(1, &sphereEBO);
+  glDeleteProgram(geometryShader.ID);
+  glDeleteProgram(instancedGeometryShader.ID);
+  glDeleteProgram(globalLightShader.ID);
+  glDeleteProgram(pointLightShader.ID);
+  telemetry().programs -= 4;
+}
+
+void DeferredRenderer::setViewport(int width, int height) {
+  viewportWidth = std::min(width, gbuffer.width);
+  viewportHeight = std::min(height, gbuffer.height);
+}
+
+Shader &DeferredRenderer::beginGeometryPass(const glm::mat4 &view,
+                                            const glm::mat4 &projection) {
+  glBindFramebuffer(GL_FRAMEBUFFER, gbuffer.FBO);
+  glViewport(0, 0, viewportWidth, viewportHeight);
+  glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+
+  instancedGeometryShader.use();
+  instancedGeometryShader.setMat4("view", view);
+  instancedGeometryShader.setMat4("projection", projection);
+  geometryShader.use();
+  geometryShader.setMat4("view", view);
+  geometryShader.setMat4("projection", projection);
+  return geometryShader;
+}
+
+void DeferredRenderer::lightingPass(unsigned int targetFBO,
+                                    const glm::mat4 &view,
+                                    const glm::mat4 &projection,
+                                    const glm::vec3 &viewPos,
+                                    const DirectionLight &direction,
+                                    const SpotLight &spot,
+                                    LightBuffer &pointLights) {
+  // the light volumes are depth tested against the scene, so the target needs
+  // the G-buffer's depth
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, gbuffer.FBO);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, targetFBO);
+  glBlitFramebuffer(0, 0, viewportWidth, viewportHeight, 0, 0, viewportWidth,
+                    viewportHeight,
+                    GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+  glViewport(0, 0, viewportWidth, viewportHeight);
+
+  glActiveTexture(GL_TEXTURE0 + GBUFFER_NORMAL_UNIT);
+  glBindTexture(GL_TEXTURE_2D, gbuffer.normal);
+  glActiveTexture(GL_TEXTURE0 + GBUFFER_ALBEDO_SPEC_UNIT);
+  glBindTexture(GL_TEXTURE_2D, gbuffer.albedoSpec);
+  glActiveTexture(GL_TEXTURE0 + GBUFFER_DEPTH_UNIT);
+  glBindTexture(GL_TEXTURE_2D, gbuffer.depth);
+  pointLights.bind(POINT_LIGHT_DATA_UNIT);
+
+  glm::mat4 inverseViewProjection = glm::inverse(projection * view);
+  glm::vec2 viewportSize((float)viewportWidth, (float)viewportHeight);
+
+  glDepthMask(GL_FALSE);
+
+  // 1. directional and spot lights cover the whole screen. This pass replaces
+  // whatever the target was cleared to wherever there is geometry.
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_BLEND);
+  globalLightShader.use();
+  globalLightShader.setMat4("inverseViewProjection", inverseViewProjection);
+  globalLightShader.setVec2("viewportSize", viewportSize);
+  globalLightShader.setVec3("viewPos", viewPos);
+  globalLightShader.setFloat("shininess", shininess);
+  setGlobalLights(globalLightShader, direction, spot);
+  glBindVertexArray(quadVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  renderStats.drawCalls++;
+  renderStats.stateChanges++;
+  renderStats.triangles += 2;
+
+  // 2. point lights only shade pixels inside their volume, each adding its
+  // contribution on top of the others. Drawing the back faces with a GEQUAL
+  // depth test rejects pixels whose surface lies behind the volume; the
+  // fragment shader rejects those in front of it. This also works when the
+  // camera is inside a volume.
+  if (pointLights.count > 0) {
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_GEQUAL);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_FRONT);
+
+    pointLightShader.use();
+    pointLightShader.setMat4("view", view);
+    pointLightShader.setMat4("projection", projection);
+    pointLightShader.setMat4("inverseViewProjection", inverseViewProjection);
+    pointLightShader.setVec2("viewportSize", viewportSize);
+    pointLightShader.setVec3("viewPos", viewPos);
+    pointLightShader.setFloat("shininess", shininess);
+    glBindVertexArray(sphereVAO);
+    glDrawElementsInstanced(GL_TRIANGLES, sphereIndexCount, GL_UNSIGNED_INT,
+                            0, pointLights.count);
+    renderStats.drawCalls++;
+    renderStats.stateChanges++;
+    renderStats.triangles +=
+        (uint64_t)sphereIndexCount / 3 * pointLights.count;
+
+    glCullFace(GL_BACK);
+    glDisable(GL_CULL_FACE);
+  }
+
+  // restore defaults for the forward passes that follow
+  glBindVertexArray(0);
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_BLEND);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void DeferredRenderer::setupQuad() {
+  float quadVertices[] = {
+      // positions   // texCoords
+      -1.0f, 1.0f,  0.0f, 1.0f, //
+      -1.0f, -1.0f, 0.0f, 0.0f, //
+      1.0f,  -1.0f, 1.0f, 0.0f, //
+
+      -1.0f, 1.0f,  0.0f, 1.0f, //
+      1.0f,  -1.0f, 1.0f, 0.0f, //
+      1.0f,  1.0f,  1.0f, 1.0f  //
+  };
+  glGenVertexArrays(1, &quadVAO);
+  glGenBuffers(1, &quadVBO);
+  glBindVertexArray(quadVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices,
+               GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                        (void *)(2 * sizeof(float)));
+  glBindVertexArray(0);
+}
+
+void DeferredRenderer::setupSphere() {
+  const float pi = 3.14159265f;
+  // the tessellated sphere is inscribed in the unit sphere, so push its
+  // vertices out far enough for the faces to contain the light's radius
+  const float inflate = 1.0f / std::cos(pi / SPHERE_SLICES);
+
+  std::vector<glm::vec3> positions;
+  for (unsigned int i = 0; i <= SPHERE_STACKS; i++) {
+    float phi = pi * i / SPHERE_STACKS;
+    for (unsigned int j = 0; j <= SPHERE_SLICES; j++) {
+      float theta = 2.0f * pi * j / SPHERE_SLICES;
+      positions.push_back(inflate * glm::vec3(std::sin(phi) * std::cos(theta),
+                                              std::cos(phi),
+                                              std::sin(phi) * std::sin(theta)));
+    }
+  }
+  std::vector<unsigned int> indices;
+  for (unsigned int i = 0; i < SPHERE_STACKS; i++) {
+    for (unsigned int j = 0; j < SPHERE_SLICES; j++) {
+      unsigned int a = i * (SPHERE_SLICES + 1) + j;
+      unsigned int b = a + SPHERE_SLICES + 1;
+      // counter-clockwise when seen from outside
+      indices.push_back(a);
+      indices.push_back(b + 1);
+      indices.push_back(b);
+      indices.push_back(a);
+      indices.push_back(a + 1);
+      indices.push_back(b + 1);
+    }
+  }
+  sphereIndexCount = indices.size();
+
+  glGenVertexArrays(1, &sphereVAO);
+  glGenBuffers(1, &sphereVBO);
+  glGenBuffers(1, &sphereEBO);
+  glBindVertexArray(sphereVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, sphereVBO);
+  glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3),
+               &positions[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sphereEBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+               &indices[0], GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3),
+                        (void *)0);
+  glBindVertexArray(0);
+}
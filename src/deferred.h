@@ -0,0 +1,95 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "light.h"
+#include "shader.h"
+
+// Selects how lit geometry is shaded. Plain forward rendering keeps the scene's
+// nanosuit environment mapped (shaders/reflect.frag). Lit forward shading
+// evaluates every light for every rasterised fragment (shaders/colors.frag);
+// deferred shading writes surface attributes to a G-buffer once and then only
+// shades pixels covered by each light's volume.
+enum RenderMode { RENDER_FORWARD, RENDER_FORWARD_LIT, RENDER_DEFERRED };
+
+// A compact geometry buffer (12 bytes per pixel):
+//   normal:     RG16F, octahedral-encoded world space normal
+//   albedoSpec: RGBA8, diffuse albedo and specular intensity
+//   depth:      DEPTH24_STENCIL8, world positions are reconstructed from it
+class GBuffer {
+public:
+  unsigned int FBO;
+  unsigned int normal;
+  unsigned int albedoSpec;
+  unsigned int depth;
+  int width;
+  int height;
+
+  GBuffer(int width, int height);
+  ~GBuffer();
+
+  // reallocates the attachments if the size changed
+  void resize(int width, int height);
+
+private:
+  void create();
+  void destroy();
+
+  GBuffer(const GBuffer &);
+  GBuffer &operator=(const GBuffer &);
+};
+
+class DeferredRenderer {
+public:
+  GBuffer gbuffer;
+  // specular exponent applied to every surface, as material.shininess is in
+  // the forward path
+  float shininess;
+
+  DeferredRenderer(int width, int height);
+  ~DeferredRenderer();
+
+  // reallocates the G-buffer for the largest size that will be rendered
+  void resize(int width, int height) { gbuffer.resize(width, height); }
+
+  // Renders to the lower left width x height pixels of the G-buffer only,
+  // for rendering at a reduced resolution without reallocating. Clamped to
+  // the G-buffer's size.
+  void setViewport(int width, int height);
+
+  // Binds and clears the G-buffer and returns the shader opaque geometry
+  // should be drawn with. Only the model matrix is left for the caller to set.
+  Shader &beginGeometryPass(const glm::mat4 &view,
+                            const glm::mat4 &projection);
+
+  // the shader InstanceBatch::draw needs in the geometry pass, with the view
+  // and projection beginGeometryPass set
+  Shader &getInstancedGeometryShader() { return instancedGeometryShader; }
+
+  // Accumulates lighting into the framebuffer targetFBO. The G-buffer depth is
+  // copied into the target first so that forward passes (transparent or
+  // unlit objects, the skybox) can be drawn on top afterwards.
+  void lightingPass(unsigned int targetFBO, const glm::mat4 &view,
+                    const glm::mat4 &projection, const glm::vec3 &viewPos,
+                    const DirectionLight &direction, const SpotLight &spot,
+                    LightBuffer &pointLights);
+
+private:
+  int viewportWidth, viewportHeight;
+
+  Shader geometryShader;
+  Shader instancedGeometryShader;
+  Shader globalLightShader;
+  Shader pointLightShader;
+
+  unsigned int quadVAO, quadVBO;
+  unsigned int sphereVAO, sphereVBO, sphereEBO;
+  unsigned int sphereIndexCount;
+
+  void setupQuad();
+  void setupSphere();
+
+  DeferredRenderer(const DeferredRenderer &);
+  DeferredRenderer &operator=(const DeferredRenderer &);
+};
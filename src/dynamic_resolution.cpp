@@ -0,0 +1,189 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "dynamic_resolution.h"
+#include "gpu_timer.h"
+#include "shader.h"
+#include "telemetry.h"
+
+// render scales are multiples of this, so that noise in the measurements
+// doesn't change the resolution every time
+const float RESOLUTION_SCALE_STEP = 1.0f / 64.0f;
+// the scale is only raised when the GPU time falls below this part of the
+// budget, and then at most by RESOLUTION_SCALE_MAX_GROWTH at a time
+const float RESOLUTION_HEADROOM = 0.85f;
+const float RESOLUTION_SCALE_MAX_GROWTH = 1.05f;
+
+RenderTarget::RenderTarget(int width, int height)
+    : width(width), height(height) {
+  create();
+}
+
+RenderTarget::~RenderTarget() { destroy(); }
+
+void RenderTarget::resize(int width, int height) {
+  if (width == this->width && height == this->height) {
+    return;
+  }
+  destroy();
+  this->width = width;
+  this->height = height;
+  create();
+}
+
+void RenderTarget::create() {
+  glGenFramebuffers(1, &FBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+  glGenTextures(1, &color);
+  glBindTexture(GL_TEXTURE_2D, color);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, NULL);
+  // the upscale relies on bilinear filtering
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         color, 0);
+
+  glGenRenderbuffers(1, &depthStencil);
+  glBindRenderbuffer(GL_RENDERBUFFER, depthStencil);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, depthStencil);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "ERROR::FRAMEBUFFER:: render target is not complete!"
+              << std::endl;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void RenderTarget::destroy() {
+  glDeleteFramebuffers(1, &FBO);
+  glDeleteTextures(1, &color);
+  glDeleteRenderbuffers(1, &depthStencil);
+}
+
+DynamicResolution::DynamicResolution(int width, int height)
+    : target(width, height), enabled(true),
+      budgetMilliseconds(DEFAULT_GPU_BUDGET_MS), currentScale(1.0f),
+      filteredMilliseconds(0.0f), cooldown(0),
+      upscaleShader("shaders/screen-quad.vert", "shaders/screen-quad.frag") {
+  setupQuad();
+  upscaleShader.use();
+  upscaleShader.setInt("screenTexture", 0);
+}
+
+DynamicResolution::~DynamicResolution() {
+  glDeleteVertexArrays(1, &quadVAO);
+  glDeleteBuffers(1, &quadVBO);
+  glDeleteProgram(upscaleShader.ID);
+  telemetry().programs--;
+}
+
+void DynamicResolution::update(float gpuMilliseconds) {
+  if (gpuMilliseconds <= 0.0f) {
+    return;
+  }
+  filteredMilliseconds =
+      filteredMilliseconds == 0.0f
+          ? gpuMilliseconds
+          : filteredMilliseconds +
+                (gpuMilliseconds - filteredMilliseconds) * 0.25f;
+  if (!enabled || cooldown > 0) {
+    cooldown -= cooldown > 0;
+    return;
+  }
+
+  // GPU time is taken to grow with the pixel count, the square of the scale.
+  // Going over budget is corrected at once, spare time is used up slowly.
+  float scale = currentScale;
+  if (filteredMilliseconds > budgetMilliseconds) {
+    scale *= std::sqrt(budgetMilliseconds / filteredMilliseconds);
+  } else if (filteredMilliseconds < budgetMilliseconds * RESOLUTION_HEADROOM) {
+    scale *= std::min(std::sqrt(budgetMilliseconds * RESOLUTION_HEADROOM /
+                                filteredMilliseconds),
+                      RESOLUTION_SCALE_MAX_GROWTH);
+  }
+  scale = std::floor(scale / RESOLUTION_SCALE_STEP + 0.5f) *
+          RESOLUTION_SCALE_STEP;
+  scale = std::max(MIN_RESOLUTION_SCALE, std::min(scale, 1.0f));
+  if (scale != currentScale) {
+    currentScale = scale;
+    // the timer reports frames GPU_TIMER_QUERIES late, wait for the first
+    // ones rendered at the new scale
+    cooldown = GPU_TIMER_QUERIES;
+  }
+}
+
+int DynamicResolution::renderWidth() const {
+  return std::max(1, (int)(target.width * scale() + 0.5f));
+}
+
+int DynamicResolution::renderHeight() const {
+  return std::max(1, (int)(target.height * scale() + 0.5f));
+}
+
+void DynamicResolution::begin() {
+  glBindFramebuffer(GL_FRAMEBUFFER, target.FBO);
+  glViewport(0, 0, renderWidth(), renderHeight());
+}
+
+void DynamicResolution::present(unsigned int targetFBO) {
+  glBindFramebuffer(GL_FRAMEBUFFER, targetFBO);
+  glViewport(0, 0, target.width, target.height);
+  glDisable(GL_DEPTH_TEST);
+
+  upscaleShader.use();
+  upscaleShader.setVec2("uvScale",
+                        glm::vec2((float)renderWidth() / target.width,
+                                  (float)renderHeight() / target.height));
+  upscaleShader.setVec2("texelSize",
+                        glm::vec2(1.0f / target.width, 1.0f / target.height));
+  // nothing to restore at native resolution
+  upscaleShader.setFloat("sharpness",
+                         scale() < 1.0f ? UPSCALE_SHARPNESS : 0.0f);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, target.color);
+  glBindVertexArray(quadVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glBindVertexArray(0);
+  renderStats.drawCalls++;
+  renderStats.stateChanges += 2;
+  renderStats.triangles += 2;
+
+  glEnable(GL_DEPTH_TEST);
+}
+
+void DynamicResolution::setupQuad() {
+  float quadVertices[] = {
+      // positions   // texCoords
+      -1.0f, 1.0f,  0.0f, 1.0f, //
+      -1.0f, -1.0f, 0.0f, 0.0f, //
+      1.0f,  -1.0f, 1.0f, 0.0f, //
+
+      -1.0f, 1.0f,  0.0f, 1.0f, //
+      1.0f,  -1.0f, 1.0f, 0.0f, //
+      1.0f,  1.0f,  1.0f, 1.0f  //
+  };
+  glGenVertexArrays(1, &quadVAO);
+  glGenBuffers(1, &quadVBO);
+  glBindVertexArray(quadVAO);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices,
+               GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void *)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float),
+                        (void *)(2 * sizeof(float)));
+  glBindVertexArray(0);
+}
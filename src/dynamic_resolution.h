@@ -0,0 +1,84 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "shader.h"
+
+// Lowest render scale per axis, a quarter of the pixels
+const float MIN_RESOLUTION_SCALE = 0.5f;
+// GPU time per frame the scale is adjusted to, leaving headroom below 60 Hz
+const float DEFAULT_GPU_BUDGET_MS = 14.0f;
+// Strength of the sharpening applied when upscaling, 0 disables it
+const float UPSCALE_SHARPNESS = 0.5f;
+
+// An offscreen color target with a depth/stencil renderbuffer matching the
+// G-buffer's format, so that depth can be blitted into it
+class RenderTarget {
+public:
+  unsigned int FBO;
+  unsigned int color;
+  unsigned int depthStencil;
+  int width;
+  int height;
+
+  RenderTarget(int width, int height);
+  ~RenderTarget();
+
+  // reallocates the attachments if the size changed
+  void resize(int width, int height);
+
+private:
+  void create();
+  void destroy();
+
+  RenderTarget(const RenderTarget &);
+  RenderTarget &operator=(const RenderTarget &);
+};
+
+// Renders the scene into the lower left part of an offscreen target sized
+// for the output, picking the size of that part from GPU frame times so
+// that they stay within a budget, and upscales the result to the output with
+// shaders/screen-quad.frag. Changing the render size never reallocates.
+class DynamicResolution {
+public:
+  RenderTarget target;
+  // when disabled the scene is rendered at the output resolution
+  bool enabled;
+  float budgetMilliseconds;
+
+  DynamicResolution(int width, int height);
+  ~DynamicResolution();
+
+  // sets the output size, which is also the largest render size
+  void resize(int width, int height) { target.resize(width, height); }
+
+  // Adjusts the render scale to a measured GPU frame time. Only pass fresh
+  // GpuTimer results.
+  void update(float gpuMilliseconds);
+
+  float scale() const { return enabled ? currentScale : 1.0f; }
+  int renderWidth() const;
+  int renderHeight() const;
+
+  // Binds the target and sets the viewport to the render size
+  void begin();
+
+  // Upscales the rendered region into the framebuffer targetFBO, which must
+  // be as large as the output
+  void present(unsigned int targetFBO);
+
+private:
+  float currentScale;
+  // smoothed GPU frame time, 0 until the first measurement
+  float filteredMilliseconds;
+  // measurements to skip while the timer still reports the old scale
+  unsigned int cooldown;
+
+  Shader upscaleShader;
+  unsigned int quadVAO, quadVBO;
+
+  void setupQuad();
+
+  DynamicResolution(const DynamicResolution &);
+  DynamicResolution &operator=(const DynamicResolution &);
+};
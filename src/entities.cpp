@@ -0,0 +1,319 @@
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#include "entities.h"
+#include "frame_arena.h"
+
+// archetype of destroyed entities
+static const unsigned int NO_ARCHETYPE = ~0u;
+
+static const size_t componentSizes[COMPONENT_TYPES] = {
+    sizeof(Transform), sizeof(Renderable), sizeof(Bounds),
+    sizeof(PhysicsBody)};
+
+// rounds value up to a multiple of alignment, a power of two
+static size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static void constructComponent(ComponentType type, void *component) {
+  switch (type) {
+  case TRANSFORM_COMPONENT:
+    new (component) Transform();
+    break;
+  case RENDERABLE_COMPONENT:
+    new (component) Renderable();
+    break;
+  case BOUNDS_COMPONENT:
+    new (component) Bounds();
+    break;
+  case PHYSICS_BODY_COMPONENT:
+    new (component) PhysicsBody();
+    break;
+  default:
+    break;
+  }
+}
+
+struct EntityStore::Archetype {
+  ComponentMask mask;
+  // rows of each chunk
+  unsigned int capacity;
+  // where each component array starts in a chunk, then the entities
+  size_t offsets[COMPONENT_TYPES + 1];
+  // aligned to cache lines, each allocated at blocks[i]
+  std::vector<unsigned char *> chunks;
+  std::vector<void *> blocks;
+  size_t count;
+
+  explicit Archetype(ComponentMask components)
+      : mask(components), count(0) {
+    size_t rowBytes = sizeof(Entity);
+    size_t arrays = 1;
+    for (unsigned int type = 0; type < COMPONENT_TYPES; type++) {
+      if (mask & (1u << type)) {
+        rowBytes += componentSizes[type];
+        arrays++;
+      }
+    }
+    // every array starts on a cache line of its own
+    capacity = (ENTITY_CHUNK_BYTES - arrays * CACHE_LINE_SIZE) / rowBytes;
+    size_t offset = 0;
+    for (unsigned int type = 0; type < COMPONENT_TYPES; type++) {
+      offsets[type] = offset;
+      if (mask & (1u << type)) {
+        offset = alignUp(offset + capacity * componentSizes[type],
+                         CACHE_LINE_SIZE);
+      }
+    }
+    offsets[COMPONENT_TYPES] = offset;
+  }
+
+  ~Archetype() {
+    for (unsigned int i = 0; i < blocks.size(); i++) {
+      free(blocks[i]);
+    }
+  }
+
+  unsigned int rows(unsigned int chunk) const {
+    size_t first = (size_t)chunk * capacity;
+    return count - first < capacity ? count - first : capacity;
+  }
+
+  void *component(unsigned int chunk, unsigned int row,
+                  ComponentType type) const {
+    return chunks[chunk] + offsets[type] + row * componentSizes[type];
+  }
+
+  Entity &entity(unsigned int chunk, unsigned int row) const {
+    return reinterpret_cast<Entity *>(chunks[chunk] +
+                                      offsets[COMPONENT_TYPES])[row];
+  }
+
+  ChunkView view(unsigned int chunk) const {
+    ChunkView view;
+    view.data = chunks[chunk];
+    view.rows = rows(chunk);
+    view.mask = mask;
+    view.offsets = offsets;
+    return view;
+  }
+};
+
+EntityStore::EntityStore() : liveEntities(0) {}
+
+EntityStore::~EntityStore() {}
+
+unsigned int EntityStore::findArchetype(ComponentMask components) {
+  for (unsigned int i = 0; i < archetypes.size(); i++) {
+    if (archetypes[i]->mask == components) {
+      return i;
+    }
+  }
+  archetypes.push_back(
+      std::unique_ptr<Archetype>(new Archetype(components)));
+  return archetypes.size() - 1;
+}
+
+EntityStore::Record EntityStore::appendRow(unsigned int archetype,
+                                           Entity entity) {
+  Archetype &type = *archetypes[archetype];
+  if (type.count == type.chunks.size() * type.capacity) {
+    void *block = malloc(ENTITY_CHUNK_BYTES + CACHE_LINE_SIZE);
+    type.blocks.push_back(block);
+    type.chunks.push_back(reinterpret_cast<unsigned char *>(
+        alignUp(reinterpret_cast<uintptr_t>(block), CACHE_LINE_SIZE)));
+  }
+  Record record;
+  record.archetype = archetype;
+  record.chunk = type.count / type.capacity;
+  record.row = type.count % type.capacity;
+  record.generation = entity.generation;
+  type.count++;
+
+  for (unsigned int component = 0; component < COMPONENT_TYPES;
+       component++) {
+    if (type.mask & (1u << component)) {
+      constructComponent(
+          ComponentType(component),
+          type.component(record.chunk, record.row, ComponentType(component)));
+    }
+  }
+  type.entity(record.chunk, record.row) = entity;
+  return record;
+}
+
+void EntityStore::removeRow(const Record &record) {
+  Archetype &type = *archetypes[record.archetype];
+  unsigned int lastChunk = (type.count - 1) / type.capacity;
+  unsigned int lastRow = (type.count - 1) % type.capacity;
+  if (record.chunk != lastChunk || record.row != lastRow) {
+    for (unsigned int component = 0; component < COMPONENT_TYPES;
+         component++) {
+      if (type.mask & (1u << component)) {
+        memcpy(
+            type.component(record.chunk, record.row,
+                           ComponentType(component)),
+            type.component(lastChunk, lastRow, ComponentType(component)),
+            componentSizes[component]);
+      }
+    }
+    Entity moved = type.entity(lastChunk, lastRow);
+    type.entity(record.chunk, record.row) = moved;
+    records[moved.index].chunk = record.chunk;
+    records[moved.index].row = record.row;
+  }
+  type.count--;
+  if (lastRow == 0) {
+    free(type.blocks.back());
+    type.blocks.pop_back();
+    type.chunks.pop_back();
+  }
+}
+
+Entity EntityStore::create(ComponentMask components) {
+  Entity entity;
+  if (!freeIndices.empty()) {
+    entity.index = freeIndices.back();
+    freeIndices.pop_back();
+    entity.generation = records[entity.index].generation;
+  } else {
+    entity.index = records.size();
+    entity.generation = 0;
+    records.push_back(Record());
+  }
+  records[entity.index] = appendRow(findArchetype(components), entity);
+  liveEntities++;
+  return entity;
+}
+
+void EntityStore::destroy(Entity entity) {
+  if (!alive(entity)) {
+    return;
+  }
+  Record &record = records[entity.index];
+  removeRow(record);
+  record.archetype = NO_ARCHETYPE;
+  // invalidates the handles still referring to the entity
+  record.generation++;
+  freeIndices.push_back(entity.index);
+  liveEntities--;
+}
+
+bool EntityStore::alive(Entity entity) const {
+  return entity.index < records.size() &&
+         records[entity.index].archetype != NO_ARCHETYPE &&
+         records[entity.index].generation == entity.generation;
+}
+
+void EntityStore::setComponents(Entity entity, ComponentMask components) {
+  if (!alive(entity)) {
+    return;
+  }
+  Record old = records[entity.index];
+  const Archetype &from = *archetypes[old.archetype];
+  if (from.mask == components) {
+    return;
+  }
+  Record moved = appendRow(findArchetype(components), entity);
+  // findArchetype may have added an archetype, but they are kept behind
+  // pointers so from is still valid
+  const Archetype &to = *archetypes[moved.archetype];
+  ComponentMask kept = from.mask & to.mask;
+  for (unsigned int component = 0; component < COMPONENT_TYPES;
+       component++) {
+    if (kept & (1u << component)) {
+      memcpy(to.component(moved.chunk, moved.row, ComponentType(component)),
+             from.component(old.chunk, old.row, ComponentType(component)),
+             componentSizes[component]);
+    }
+  }
+  removeRow(old);
+  records[entity.index] = moved;
+}
+
+ComponentMask EntityStore::components(Entity entity) const {
+  if (!alive(entity)) {
+    return 0;
+  }
+  return archetypes[records[entity.index].archetype]->mask;
+}
+
+void *EntityStore::component(Entity entity, ComponentType type) const {
+  if (!alive(entity)) {
+    return NULL;
+  }
+  const Record &record = records[entity.index];
+  const Archetype &archetype = *archetypes[record.archetype];
+  if (!(archetype.mask & (1u << type))) {
+    return NULL;
+  }
+  return archetype.component(record.chunk, record.row, type);
+}
+
+void EntityStore::chunks(ComponentMask components,
+                         std::vector<ChunkView> &views) const {
+  views.clear();
+  for (unsigned int i = 0; i < archetypes.size(); i++) {
+    const Archetype &archetype = *archetypes[i];
+    if ((archetype.mask & components) != components) {
+      continue;
+    }
+    for (unsigned int chunk = 0; chunk < archetype.chunks.size(); chunk++) {
+      views.push_back(archetype.view(chunk));
+    }
+  }
+}
+
+void EntityStore::parallelForEachChunk(
+    ComponentMask components, JobPool &pool,
+    const std::function<void(const ChunkView &, size_t)> &fn) const {
+  std::vector<ChunkView> views;
+  chunks(components, views);
+  pool.parallelFor(views.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      fn(views[i], i);
+    }
+  });
+}
+
+void updateWorldBounds(EntityStore &entities, JobPool &pool) {
+  entities.parallelForEachChunk(
+      componentMask<Transform>() | componentMask<Bounds>(), pool,
+      [](const ChunkView &chunk, size_t) {
+        const Transform *transforms = chunk.get<Transform>();
+        Bounds *bounds = chunk.get<Bounds>();
+        for (unsigned int i = 0; i < chunk.size(); i++) {
+          bounds[i].world =
+              transformBounds(bounds[i].local, transforms[i].world);
+        }
+      });
+}
+
+void cullEntities(const EntityStore &entities, ComponentMask components,
+                  const Frustum &frustum, JobPool &pool,
+                  std::vector<Entity> &visible) {
+  components |= componentMask<Bounds>();
+  std::vector<ChunkView> views;
+  entities.chunks(components, views);
+  // each chunk collects its own, so the result doesn't depend on the order
+  // the threads finish in
+  std::vector<std::vector<Entity> > found(views.size());
+  pool.parallelFor(views.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t chunk = begin; chunk < end; chunk++) {
+      const Bounds *bounds = views[chunk].get<Bounds>();
+      const Entity *ids = views[chunk].entities();
+      for (unsigned int i = 0; i < views[chunk].size(); i++) {
+        if (isVisible(frustum, bounds[i].world)) {
+          found[chunk].push_back(ids[i]);
+        }
+      }
+    }
+  });
+  visible.clear();
+  for (unsigned int chunk = 0; chunk < found.size(); chunk++) {
+    visible.insert(visible.end(), found[chunk].begin(), found[chunk].end());
+  }
+}
@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "job_pool.h"
+
+// Bytes of a chunk, the unit entities are stored and iterated in. Small
+// enough that a chunk's arrays stay in L1/L2 while a system works on them.
+const size_t ENTITY_CHUNK_BYTES = 16u << 10;
+
+// Components, plain data copied with memcpy when entities move
+
+// where an entity is in the world
+struct Transform {
+  glm::mat4 world;
+
+  Transform() : world(1.0f) {}
+};
+
+// what an entity draws, as handles into the application's tables of meshes
+// and materials
+struct Renderable {
+  unsigned int mesh;
+  unsigned int material;
+};
+
+// an entity's bounds in its own space and, once updateWorldBounds ran, in
+// the world
+struct Bounds {
+  AABB local;
+  AABB world;
+};
+
+// the entity's body in a physics world
+struct PhysicsBody {
+  unsigned int body;
+};
+
+enum ComponentType {
+  TRANSFORM_COMPONENT,
+  RENDERABLE_COMPONENT,
+  BOUNDS_COMPONENT,
+  PHYSICS_BODY_COMPONENT,
+  COMPONENT_TYPES
+};
+
+// a set of component types, one bit per ComponentType
+typedef unsigned int ComponentMask;
+
+template <typename T> struct ComponentTraits;
+template <> struct ComponentTraits<Transform> {
+  static const ComponentType type = TRANSFORM_COMPONENT;
+};
+template <> struct ComponentTraits<Renderable> {
+  static const ComponentType type = RENDERABLE_COMPONENT;
+};
+template <> struct ComponentTraits<Bounds> {
+  static const ComponentType type = BOUNDS_COMPONENT;
+};
+template <> struct ComponentTraits<PhysicsBody> {
+  static const ComponentType type = PHYSICS_BODY_COMPONENT;
+};
+
+template <typename T> ComponentMask componentMask() {
+  return 1u << ComponentTraits<T>::type;
+}
+
+// Refers to an entity. Stays invalid once the entity is destroyed, even
+// after its index is reused.
+struct Entity {
+  unsigned int index;
+  unsigned int generation;
+
+  bool operator==(const Entity &other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const Entity &other) const { return !(*this == other); }
+};
+
+// The entities of one chunk: the components of each type in an array of
+// their own, in the same order as entities().
+class ChunkView {
+public:
+  unsigned int size() const { return rows; }
+  ComponentMask components() const { return mask; }
+  const Entity *entities() const {
+    return reinterpret_cast<const Entity *>(data + offsets[COMPONENT_TYPES]);
+  }
+
+  // the chunk's array of T, NULL if its entities don't have T
+  template <typename T> T *get() const {
+    if (!(mask & componentMask<T>())) {
+      return NULL;
+    }
+    return reinterpret_cast<T *>(data + offsets[ComponentTraits<T>::type]);
+  }
+
+private:
+  friend class EntityStore;
+  unsigned char *data;
+  unsigned int rows;
+  ComponentMask mask;
+  // where each component array starts in data, then the entities
+  const size_t *offsets;
+};
+
+// Entities and their components, stored by archetype: the entities with the
+// same set of components share fixed size chunks, holding a structure of
+// arrays with one array per component type. Systems go over the chunks of
+// every archetype including the components they need, reading contiguous
+// arrays without a pointer per entity, and can give each worker thread
+// chunks of its own.
+//
+// The chunks of an archetype are full except for the last one: destroying
+// an entity moves the archetype's last entity into its place. Component
+// pointers are valid until the next entity is created, destroyed or changes
+// components.
+class EntityStore {
+public:
+  EntityStore();
+  ~EntityStore();
+
+  // an entity with the components, default constructed
+  Entity create(ComponentMask components);
+  void destroy(Entity entity);
+  bool alive(Entity entity) const;
+
+  // Adds and removes components, keeping the ones the entity still has
+  void setComponents(Entity entity, ComponentMask components);
+  ComponentMask components(Entity entity) const;
+
+  // the entity's T, NULL if it has none or is dead
+  template <typename T> T *get(Entity entity) {
+    return static_cast<T *>(component(entity, ComponentTraits<T>::type));
+  }
+
+  size_t size() const { return liveEntities; }
+
+  // the chunks holding entities with at least the components, in a stable
+  // order
+  void chunks(ComponentMask components, std::vector<ChunkView> &views) const;
+
+  // Calls fn for every chunk holding entities with at least the components,
+  // with the chunk's position in the order of chunks(). Chunks are split
+  // among the pool's threads: fn may only write to the chunk it is given,
+  // and must not create, destroy or change entities.
+  void parallelForEachChunk(
+      ComponentMask components, JobPool &pool,
+      const std::function<void(const ChunkView &, size_t)> &fn) const;
+
+private:
+  struct Archetype;
+  struct Record {
+    unsigned int archetype;
+    unsigned int chunk;
+    unsigned int row;
+    unsigned int generation;
+  };
+
+  std::vector<std::unique_ptr<Archetype> > archetypes;
+  std::vector<Record> records;
+  // indices of destroyed entities, for reuse
+  std::vector<unsigned int> freeIndices;
+  size_t liveEntities;
+
+  unsigned int findArchetype(ComponentMask components);
+  // appends a row for entity to the archetype, returns the record for it
+  Record appendRow(unsigned int archetype, Entity entity);
+  // fills the row with the archetype's last entity and drops that one
+  void removeRow(const Record &record);
+  void *component(Entity entity, ComponentType type) const;
+
+  EntityStore(const EntityStore &);
+  EntityStore &operator=(const EntityStore &);
+};
+
+// Systems
+
+// Moves the local bounds of every entity with a transform into the world
+void updateWorldBounds(EntityStore &entities, JobPool &pool);
+
+// Collects the entities with world bounds inside frustum and at least the
+// components, in chunk order
+void cullEntities(const EntityStore &entities, ComponentMask components,
+                  const Frustum &frustum, JobPool &pool,
+                  std::vector<Entity> &visible);
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include "frame_arena.h"
+#include "telemetry.h"
+
+// rounds value up to a multiple of alignment, a power of two
+static uintptr_t alignUp(uintptr_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+FrameArena::FrameArena(size_t capacity)
+    : size(capacity), offset(0), overflowBytes(0), peakBytes(0),
+      overflowCount(0) {
+  memory = static_cast<unsigned char *>(malloc(capacity + CACHE_LINE_SIZE));
+  block = reinterpret_cast<unsigned char *>(
+      alignUp(reinterpret_cast<uintptr_t>(memory), CACHE_LINE_SIZE));
+}
+
+FrameArena::~FrameArena() {
+  reset();
+  free(memory);
+}
+
+void *FrameArena::allocate(size_t bytes, size_t alignment) {
+  uintptr_t start = alignUp(reinterpret_cast<uintptr_t>(block) + offset,
+                            alignment);
+  size_t end = start - reinterpret_cast<uintptr_t>(block) + bytes;
+  if (end <= size) {
+    offset = end;
+    peakBytes = std::max(peakBytes, used());
+    return reinterpret_cast<void *>(start);
+  }
+  // over-allocated so the pointer can be aligned, the original is kept to
+  // be freed
+  void *overflow = malloc(bytes + alignment);
+  overflowBlocks.push_back(overflow);
+  overflowBytes += bytes;
+  overflowCount++;
+  peakBytes = std::max(peakBytes, used());
+  return reinterpret_cast<void *>(
+      alignUp(reinterpret_cast<uintptr_t>(overflow), alignment));
+}
+
+void FrameArena::deallocate(void *pointer, size_t bytes) {
+  unsigned char *start = static_cast<unsigned char *>(pointer);
+  if (start + bytes == block + offset) {
+    offset = start - block;
+  }
+}
+
+void FrameArena::reset() {
+  for (unsigned int i = 0; i < overflowBlocks.size(); i++) {
+    free(overflowBlocks[i]);
+  }
+  overflowBlocks.clear();
+  offset = 0;
+  overflowBytes = 0;
+}
+
+// the arenas of all threads, for resetFrameArenas
+struct FrameArenaRegistry {
+  std::mutex mutex;
+  std::vector<FrameArena *> arenas;
+  size_t peakFrameBytes;
+};
+
+// Never destroyed: job pool workers may still unregister their arenas while
+// other statics are torn down at exit.
+static FrameArenaRegistry &registry() {
+  static FrameArenaRegistry *instance = new FrameArenaRegistry();
+  return *instance;
+}
+
+// a thread's arena, registered for as long as the thread lives
+struct ThreadFrameArena {
+  FrameArena arena;
+
+  ThreadFrameArena() : arena(FRAME_ARENA_BYTES) {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    registry().arenas.push_back(&arena);
+  }
+  ~ThreadFrameArena() {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    std::vector<FrameArena *> &arenas = registry().arenas;
+    arenas.erase(std::remove(arenas.begin(), arenas.end(), &arena),
+                 arenas.end());
+  }
+};
+
+FrameArena &frameArena() {
+  static thread_local ThreadFrameArena instance;
+  return instance.arena;
+}
+
+FrameArenaStats resetFrameArenas() {
+  FrameArenaStats stats;
+  stats.frameBytes = 0;
+  stats.overflows = 0;
+  {
+    std::lock_guard<std::mutex> lock(registry().mutex);
+    std::vector<FrameArena *> &arenas = registry().arenas;
+    for (unsigned int i = 0; i < arenas.size(); i++) {
+      stats.frameBytes += arenas[i]->used();
+      stats.overflows += arenas[i]->overflows();
+      arenas[i]->reset();
+    }
+    registry().peakFrameBytes =
+        std::max(registry().peakFrameBytes, stats.frameBytes);
+    stats.peakBytes = registry().peakFrameBytes;
+  }
+  telemetry().frameArenaBytes.store(stats.frameBytes,
+                                    std::memory_order_relaxed);
+  telemetry().frameArenaPeakBytes.store(stats.peakBytes,
+                                        std::memory_order_relaxed);
+  telemetry().frameArenaOverflows.store(stats.overflows,
+                                        std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+const size_t CACHE_LINE_SIZE = 64;
+// Size of each thread's arena. Frames that need more fall back to the heap
+// and count as overflows, see FrameArenaStats.
+const size_t FRAME_ARENA_BYTES = 1u << 20;
+
+// A bump allocator for data that lives no longer than a frame. Allocations
+// start on cache lines; freeing is a no-op except for the most recent
+// allocation, which is rolled back so growing vectors reuse their space.
+// When the block runs out, allocations come from the heap until reset().
+class FrameArena {
+public:
+  explicit FrameArena(size_t capacity);
+  ~FrameArena();
+
+  void *allocate(size_t bytes, size_t alignment = CACHE_LINE_SIZE);
+  void deallocate(void *pointer, size_t bytes);
+
+  // Frees everything allocated since the last reset. Nothing allocated
+  // from the arena may be used afterwards.
+  void reset();
+
+  size_t capacity() const { return size; }
+  // bytes allocated since the last reset, including overflow
+  size_t used() const { return offset + overflowBytes; }
+  // most bytes allocated between two resets
+  size_t peak() const { return peakBytes; }
+  // allocations that didn't fit since the arena was created
+  uint64_t overflows() const { return overflowCount; }
+
+private:
+  unsigned char *memory;
+  // memory rounded up to a cache line
+  unsigned char *block;
+  size_t size;
+  size_t offset;
+  size_t overflowBytes;
+  size_t peakBytes;
+  uint64_t overflowCount;
+  std::vector<void *> overflowBlocks;
+
+  FrameArena(const FrameArena &);
+  FrameArena &operator=(const FrameArena &);
+};
+
+// The calling thread's arena, created on first use. Threads get arenas of
+// their own, so job pool workers allocate without locking or sharing cache
+// lines with the render thread.
+FrameArena &frameArena();
+
+struct FrameArenaStats {
+  // bytes allocated by all threads during the last frame
+  size_t frameBytes;
+  // the largest frame so far
+  size_t peakBytes;
+  // allocations that had to go to the heap so far
+  uint64_t overflows;
+};
+
+// Resets the arenas of all threads and publishes their statistics to
+// telemetry. Call at the top of each frame on the render thread, while no
+// job is running. Arenas hold render thread data and that of the jobs it
+// waits for; loader threads outliving a frame must not use them.
+FrameArenaStats resetFrameArenas();
+
+// STL allocator handing out memory of a FrameArena, the calling thread's by
+// default. Containers using it must not outlive the frame.
+template <typename T> class FrameAllocator {
+public:
+  typedef T value_type;
+
+  FrameAllocator() : arena(&frameArena()) {}
+  explicit FrameAllocator(FrameArena &arena) : arena(&arena) {}
+  template <typename U>
+  FrameAllocator(const FrameAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t count) {
+    size_t alignment =
+        alignof(T) > CACHE_LINE_SIZE ? alignof(T) : CACHE_LINE_SIZE;
+    return static_cast<T *>(arena->allocate(count * sizeof(T), alignment));
+  }
+  void deallocate(T *pointer, size_t count) {
+    arena->deallocate(pointer, count * sizeof(T));
+  }
+
+  template <typename U> bool operator==(const FrameAllocator<U> &other) const {
+    return arena == other.arena;
+  }
+  template <typename U> bool operator!=(const FrameAllocator<U> &other) const {
+    return arena != other.arena;
+  }
+
+private:
+  template <typename U> friend class FrameAllocator;
+  FrameArena *arena;
+};
+
+template <typename T> using FrameVector = std::vector<T, FrameAllocator<T> >;
+typedef std::basic_string<char, std::char_traits<char>, FrameAllocator<char> >
+    FrameString;
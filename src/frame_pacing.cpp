@@ -0,0 +1,182 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include <glad/glad.h>
+// prevent clang-format reordering
+#include <GLFW/glfw3.h>
+
+#include "frame_pacing.h"
+
+FixedTimestep::FixedTimestep() : accumulator(0.0) {}
+
+unsigned int FixedTimestep::advance(double frameTime) {
+  accumulator += std::max(frameTime, 0.0);
+  unsigned int steps = (unsigned int)(accumulator / SIMULATION_STEP);
+  if (steps > MAX_SIMULATION_STEPS) {
+    // drop the time that can't be caught up on, keeping the phase
+    steps = MAX_SIMULATION_STEPS;
+    accumulator = std::fmod(accumulator, SIMULATION_STEP);
+  } else {
+    accumulator -= steps * SIMULATION_STEP;
+  }
+  return steps;
+}
+
+FrameLatencyLimiter::FrameLatencyLimiter() : submitted(0), limit(0) {
+  for (unsigned int i = 0; i < MAX_FRAME_LATENCY; i++) {
+    fences[i] = 0;
+  }
+}
+
+FrameLatencyLimiter::~FrameLatencyLimiter() { clear(); }
+
+void FrameLatencyLimiter::clear() {
+  for (unsigned int i = 0; i < MAX_FRAME_LATENCY; i++) {
+    if (fences[i]) {
+      glDeleteSync(fences[i]);
+      fences[i] = 0;
+    }
+  }
+  submitted = 0;
+}
+
+void FrameLatencyLimiter::setMaxFrames(unsigned int frames) {
+  clear();
+  limit = std::min(frames, MAX_FRAME_LATENCY);
+}
+
+void FrameLatencyLimiter::wait() {
+  if (limit == 0 || submitted < limit) {
+    return;
+  }
+  GLsync &fence = fences[(submitted - limit) % MAX_FRAME_LATENCY];
+  if (!fence) {
+    return;
+  }
+  // a second is far longer than any frame, it only guards against hangs
+  GLenum result =
+      glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+  if (result == GL_WAIT_FAILED) {
+    std::cout << "ERROR::FRAME_PACING:: waiting for a frame fence failed"
+              << std::endl;
+  }
+  glDeleteSync(fence);
+  fence = 0;
+}
+
+void FrameLatencyLimiter::frameSubmitted() {
+  if (limit == 0) {
+    return;
+  }
+  GLsync &fence = fences[submitted % MAX_FRAME_LATENCY];
+  if (fence) {
+    glDeleteSync(fence);
+  }
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  submitted++;
+}
+
+LatencyProbe::LatencyProbe()
+    : queries(LATENCY_MEASURED_FRAMES), frame(LATENCY_MEASURED_FRAMES),
+      resolved(LATENCY_MEASURED_FRAMES), latencyLimit(0), clockOffset(0.0) {
+  glGenQueries(LATENCY_MEASURED_FRAMES, &queries[0]);
+}
+
+LatencyProbe::~LatencyProbe() {
+  glDeleteQueries(LATENCY_MEASURED_FRAMES, &queries[0]);
+}
+
+void LatencyProbe::start(unsigned int latencyLimit) {
+  this->latencyLimit = latencyLimit;
+  frame = 0;
+  resolved = 0;
+  inputTimes.assign(LATENCY_MEASURED_FRAMES, 0.0);
+  frameTimes.assign(LATENCY_MEASURED_FRAMES, 0.0);
+  latencies.assign(LATENCY_MEASURED_FRAMES, 0.0);
+
+  // the GPU clock has an unspecified origin, so pair it with the CPU clock
+  GLint64 gpuTime = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpuTime);
+  clockOffset = glfwGetTime() - gpuTime * 1e-9;
+  std::cout << "Measuring input latency..." << std::endl;
+}
+
+void LatencyProbe::frameSubmitted(double inputTime, double frameTime) {
+  if (!running()) {
+    return;
+  }
+  glQueryCounter(queries[frame], GL_TIMESTAMP);
+  inputTimes[frame] = inputTime;
+  frameTimes[frame] = frameTime;
+  frame++;
+  resolve(!running());
+  if (!running()) {
+    report();
+  }
+}
+
+void LatencyProbe::resolve(bool wait) {
+  for (; resolved < frame; resolved++) {
+    if (!wait) {
+      GLint available = 0;
+      glGetQueryObjectiv(queries[resolved], GL_QUERY_RESULT_AVAILABLE,
+                         &available);
+      if (!available) {
+        return;
+      }
+    }
+    GLuint64 gpuTime = 0;
+    glGetQueryObjectui64v(queries[resolved], GL_QUERY_RESULT, &gpuTime);
+    latencies[resolved] = gpuTime * 1e-9 + clockOffset - inputTimes[resolved];
+  }
+}
+
+// value below which the given fraction of the sorted values lies
+static double percentile(const std::vector<double> &sorted, double fraction) {
+  size_t index = (size_t)(fraction * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void LatencyProbe::report() {
+  // the first interval spans the key press that started the measurement
+  std::vector<double> intervals(frameTimes.begin() + 1, frameTimes.end());
+  double mean = 0.0;
+  for (unsigned int i = 0; i < intervals.size(); i++) {
+    mean += intervals[i];
+  }
+  mean /= intervals.size();
+  double variance = 0.0;
+  unsigned int hitches = 0;
+  for (unsigned int i = 0; i < intervals.size(); i++) {
+    variance += (intervals[i] - mean) * (intervals[i] - mean);
+    hitches += intervals[i] > mean * 1.5;
+  }
+  variance /= intervals.size();
+
+  std::sort(intervals.begin(), intervals.end());
+  std::sort(latencies.begin(), latencies.end());
+  double meanLatency = 0.0;
+  for (unsigned int i = 0; i < latencies.size(); i++) {
+    meanLatency += latencies[i];
+  }
+  meanLatency /= latencies.size();
+
+  std::printf("frame latency limit: ");
+  if (latencyLimit == 0) {
+    std::printf("off\n");
+  } else {
+    std::printf("%u\n", latencyLimit);
+  }
+  std::printf("input to present: mean %.2f ms, p50 %.2f ms, p99 %.2f ms, "
+              "max %.2f ms\n",
+              meanLatency * 1e3, percentile(latencies, 0.5) * 1e3,
+              percentile(latencies, 0.99) * 1e3, latencies.back() * 1e3);
+  std::printf("frame time: mean %.2f ms, std dev %.3f ms, p99 %.2f ms, "
+              "%u frames over 1.5x mean\n",
+              mean * 1e3, std::sqrt(variance) * 1e3,
+              percentile(intervals, 0.99) * 1e3, hitches);
+  std::fflush(stdout);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Simulation rate of the fixed timestep, independent of the display rate
+const double SIMULATION_STEP = 1.0 / 120.0;
+// Steps run at most per frame. After a longer stall the simulation slows
+// down instead of trying to catch up all at once.
+const unsigned int MAX_SIMULATION_STEPS = 8;
+
+// Most frames the latency limiter lets the GPU fall behind the CPU
+const unsigned int MAX_FRAME_LATENCY = 3;
+
+// Frames recorded by a latency measurement
+const unsigned int LATENCY_MEASURED_FRAMES = 600;
+
+// A value updated at the simulation rate and drawn at the display rate. The
+// value of the previous and the current step are kept so that frames falling
+// between two steps can blend them.
+template <typename T> class Interpolated {
+public:
+  T previous;
+  T current;
+
+  Interpolated() {}
+  explicit Interpolated(const T &value) : previous(value), current(value) {}
+
+  // Call at the start of every simulation step, before changing current
+  void beginStep() { previous = current; }
+
+  // Jumps to value without blending from the old one
+  void reset(const T &value) { previous = current = value; }
+
+  // alpha is FixedTimestep::alpha(), 0 is the previous step and 1 the current
+  T at(float alpha) const { return previous + (current - previous) * alpha; }
+};
+
+// Accumulates frame time and hands it out in steps of SIMULATION_STEP
+class FixedTimestep {
+public:
+  FixedTimestep();
+
+  // Adds the time the last frame took and returns how many steps to run
+  unsigned int advance(double frameTime);
+
+  // How far the display time lies between the last two steps
+  float alpha() const { return accumulator / SIMULATION_STEP; }
+
+private:
+  double accumulator;
+};
+
+// Keeps the CPU from queueing up more than a set number of frames ahead of
+// the GPU. The driver would otherwise buffer several frames, each of which
+// adds a frame of delay between reading input and showing its result.
+class FrameLatencyLimiter {
+public:
+  FrameLatencyLimiter();
+  ~FrameLatencyLimiter();
+
+  // Frames allowed in flight, 0 disables limiting
+  void setMaxFrames(unsigned int frames);
+  unsigned int maxFrames() const { return limit; }
+
+  // Blocks until at most maxFrames() - 1 submitted frames are unfinished.
+  // Call before sampling input for the next frame.
+  void wait();
+
+  // Call right after the frame's glfwSwapBuffers
+  void frameSubmitted();
+
+private:
+  GLsync fences[MAX_FRAME_LATENCY];
+  unsigned int submitted;
+  unsigned int limit;
+
+  void clear();
+
+  FrameLatencyLimiter(const FrameLatencyLimiter &);
+  FrameLatencyLimiter &operator=(const FrameLatencyLimiter &);
+};
+
+// Measures, for LATENCY_MEASURED_FRAMES frames, the time between sampling
+// input and the GPU finishing the frame's swap, and how evenly frames are
+// paced. The swap is timestamped with a GL_TIMESTAMP query converted to the
+// CPU clock, so the latency excludes the compositor and scanout and is a
+// lower bound of what the user sees. Prints a report when done.
+class LatencyProbe {
+public:
+  LatencyProbe();
+  ~LatencyProbe();
+
+  // latencyLimit is only printed with the report
+  void start(unsigned int latencyLimit);
+
+  bool running() const { return frame < LATENCY_MEASURED_FRAMES; }
+
+  // inputTime is when input was sampled for the frame and frameTime the
+  // interval since the previous frame, both in seconds. Call after
+  // glfwSwapBuffers.
+  void frameSubmitted(double inputTime, double frameTime);
+
+private:
+  // timestamp query issued after each frame's swap, read back when done
+  std::vector<unsigned int> queries;
+  std::vector<double> inputTimes;
+  std::vector<double> frameTimes;
+  std::vector<double> latencies;
+  unsigned int frame;
+  unsigned int resolved;
+  unsigned int latencyLimit;
+  // CPU time minus GPU time, in seconds
+  double clockOffset;
+
+  void resolve(bool wait);
+  void report();
+
+  LatencyProbe(const LatencyProbe &);
+  LatencyProbe &operator=(const LatencyProbe &);
+};
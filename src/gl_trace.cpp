@@ -0,0 +1,1042 @@
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "gl_trace.h"
+
+#define GL_TRACE_RECORD_NAME(name) "gl" #name,
+static const char *const RECORD_NAMES[TRACE_RECORDS] = {
+    "frame", "blob", GL_TRACE_FUNCTIONS(GL_TRACE_RECORD_NAME)};
+#undef GL_TRACE_RECORD_NAME
+
+const char *glTraceRecordName(unsigned int record) {
+  return record < TRACE_RECORDS ? RECORD_NAMES[record] : "unknown";
+}
+
+uint64_t glTraceHash(const void *data, size_t size) {
+  const unsigned char *bytes = static_cast<const unsigned char *>(data);
+  uint64_t hash = 0x9e3779b97f4a7c15ull ^ size;
+  size_t i = 0;
+  // a word at a time, textures run to megabytes
+  for (; i + 8 <= size; i += 8) {
+    uint64_t word;
+    memcpy(&word, bytes + i, 8);
+    hash = (hash ^ word) * 0xff51afd7ed558ccdull;
+    hash ^= hash >> 32;
+  }
+  for (; i < size; i++) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+  }
+  hash ^= hash >> 33;
+  hash *= 0xc4ceb9fe1a85ec53ull;
+  hash ^= hash >> 33;
+  return hash != 0 ? hash : 1;
+}
+
+// blobs this large skip the record buffer
+const size_t LARGE_BLOB_BYTES = 64u << 10;
+
+// The trace being written. Records collect in buffer and are written out at
+// the end of each frame. GL calls are made on the render thread only, so it
+// needs no lock.
+struct TraceWriter {
+  FILE *file;
+  std::vector<unsigned char> buffer;
+  // hashes of the blobs written so far
+  std::unordered_set<uint64_t> blobs;
+  unsigned int frames;
+  unsigned int maxFrames;
+
+  TraceWriter() : file(NULL), frames(0), maxFrames(0) {}
+
+  void bytes(const void *data, size_t size) {
+    const unsigned char *begin = static_cast<const unsigned char *>(data);
+    buffer.insert(buffer.end(), begin, begin + size);
+  }
+  void u16(uint16_t value) { bytes(&value, sizeof(value)); }
+  void u32(uint32_t value) { bytes(&value, sizeof(value)); }
+  void i32(int32_t value) { bytes(&value, sizeof(value)); }
+  void f32(float value) { bytes(&value, sizeof(value)); }
+  void u64(uint64_t value) { bytes(&value, sizeof(value)); }
+  void record(GlTraceRecord id) { u16(id); }
+  void string(const char *value) {
+    uint32_t length = strlen(value);
+    u32(length);
+    bytes(value, length);
+  }
+
+  // writes data unless an identical blob was, returns its hash
+  uint64_t blob(const void *data, size_t size) {
+    if (data == NULL) {
+      return 0;
+    }
+    uint64_t hash = glTraceHash(data, size);
+    if (!blobs.insert(hash).second) {
+      return hash;
+    }
+    record(TRACE_BLOB);
+    u64(hash);
+    u64(size);
+    if (size < LARGE_BLOB_BYTES) {
+      bytes(data, size);
+    } else {
+      flush();
+      fwrite(data, 1, size, file);
+    }
+    return hash;
+  }
+
+  void flush() {
+    if (!buffer.empty()) {
+      fwrite(&buffer[0], 1, buffer.size(), file);
+      buffer.clear();
+    }
+  }
+};
+
+static TraceWriter trace;
+
+// bytes of pixels an upload reads, with the default unpack alignment of 4
+static size_t imageBytes(GLsizei width, GLsizei height, GLsizei depth,
+                         GLenum format, GLenum type) {
+  size_t components = 4;
+  if (format == GL_RED || format == GL_DEPTH_COMPONENT) {
+    components = 1;
+  } else if (format == GL_RG) {
+    components = 2;
+  } else if (format == GL_RGB || format == GL_BGR) {
+    components = 3;
+  }
+  size_t componentBytes = 1;
+  if (type == GL_FLOAT || type == GL_UNSIGNED_INT || type == GL_INT) {
+    componentBytes = 4;
+  } else if (type == GL_HALF_FLOAT || type == GL_UNSIGNED_SHORT ||
+             type == GL_SHORT) {
+    componentBytes = 2;
+  }
+  size_t row = (width * components * componentBytes + 3) & ~(size_t)3;
+  return row * height * depth;
+}
+
+#define GL_TRACE_REAL(name) static decltype(glad_gl##name) real##name;
+GL_TRACE_FUNCTIONS(GL_TRACE_REAL)
+#undef GL_TRACE_REAL
+
+static void APIENTRY traceActiveTexture(GLenum texture) {
+  trace.record(TRACE_glActiveTexture);
+  trace.u32(texture);
+  realActiveTexture(texture);
+}
+
+static void APIENTRY traceAttachShader(GLuint program, GLuint shader) {
+  trace.record(TRACE_glAttachShader);
+  trace.u32(program);
+  trace.u32(shader);
+  realAttachShader(program, shader);
+}
+
+static void APIENTRY traceBeginQuery(GLenum target, GLuint id) {
+  trace.record(TRACE_glBeginQuery);
+  trace.u32(target);
+  trace.u32(id);
+  realBeginQuery(target, id);
+}
+
+static void APIENTRY traceBindBuffer(GLenum target, GLuint buffer) {
+  trace.record(TRACE_glBindBuffer);
+  trace.u32(target);
+  trace.u32(buffer);
+  realBindBuffer(target, buffer);
+}
+
+static void APIENTRY traceBindBufferBase(GLenum target, GLuint index,
+                                         GLuint buffer) {
+  trace.record(TRACE_glBindBufferBase);
+  trace.u32(target);
+  trace.u32(index);
+  trace.u32(buffer);
+  realBindBufferBase(target, index, buffer);
+}
+
+static void APIENTRY traceBindFramebuffer(GLenum target, GLuint framebuffer) {
+  trace.record(TRACE_glBindFramebuffer);
+  trace.u32(target);
+  trace.u32(framebuffer);
+  realBindFramebuffer(target, framebuffer);
+}
+
+static void APIENTRY traceBindRenderbuffer(GLenum target,
+                                           GLuint renderbuffer) {
+  trace.record(TRACE_glBindRenderbuffer);
+  trace.u32(target);
+  trace.u32(renderbuffer);
+  realBindRenderbuffer(target, renderbuffer);
+}
+
+static void APIENTRY traceBindTexture(GLenum target, GLuint texture) {
+  trace.record(TRACE_glBindTexture);
+  trace.u32(target);
+  trace.u32(texture);
+  realBindTexture(target, texture);
+}
+
+static void APIENTRY traceBindVertexArray(GLuint array) {
+  trace.record(TRACE_glBindVertexArray);
+  trace.u32(array);
+  realBindVertexArray(array);
+}
+
+static void APIENTRY traceBlendFunc(GLenum sfactor, GLenum dfactor) {
+  trace.record(TRACE_glBlendFunc);
+  trace.u32(sfactor);
+  trace.u32(dfactor);
+  realBlendFunc(sfactor, dfactor);
+}
+
+static void APIENTRY traceBlitFramebuffer(GLint srcX0, GLint srcY0,
+                                          GLint srcX1, GLint srcY1,
+                                          GLint dstX0, GLint dstY0,
+                                          GLint dstX1, GLint dstY1,
+                                          GLbitfield mask, GLenum filter) {
+  trace.record(TRACE_glBlitFramebuffer);
+  trace.i32(srcX0);
+  trace.i32(srcY0);
+  trace.i32(srcX1);
+  trace.i32(srcY1);
+  trace.i32(dstX0);
+  trace.i32(dstY0);
+  trace.i32(dstX1);
+  trace.i32(dstY1);
+  trace.u32(mask);
+  trace.u32(filter);
+  realBlitFramebuffer(srcX0, srcY0, srcX1, srcY1, dstX0, dstY0, dstX1, dstY1,
+                      mask, filter);
+}
+
+static void APIENTRY traceBufferData(GLenum target, GLsizeiptr size,
+                                     const void *data, GLenum usage) {
+  uint64_t hash = trace.blob(data, size);
+  trace.record(TRACE_glBufferData);
+  trace.u32(target);
+  trace.u64(size);
+  trace.u64(hash);
+  trace.u32(usage);
+  realBufferData(target, size, data, usage);
+}
+
+static void APIENTRY traceBufferStorage(GLenum target, GLsizeiptr size,
+                                        const void *data, GLbitfield flags) {
+  uint64_t hash = trace.blob(data, size);
+  trace.record(TRACE_glBufferStorage);
+  trace.u32(target);
+  trace.u64(size);
+  trace.u64(hash);
+  trace.u32(flags);
+  realBufferStorage(target, size, data, flags);
+}
+
+static void APIENTRY traceBufferSubData(GLenum target, GLintptr offset,
+                                        GLsizeiptr size, const void *data) {
+  uint64_t hash = trace.blob(data, size);
+  trace.record(TRACE_glBufferSubData);
+  trace.u32(target);
+  trace.u64(offset);
+  trace.u64(size);
+  trace.u64(hash);
+  realBufferSubData(target, offset, size, data);
+}
+
+static GLenum APIENTRY traceCheckFramebufferStatus(GLenum target) {
+  trace.record(TRACE_glCheckFramebufferStatus);
+  trace.u32(target);
+  return realCheckFramebufferStatus(target);
+}
+
+static void APIENTRY traceClear(GLbitfield mask) {
+  trace.record(TRACE_glClear);
+  trace.u32(mask);
+  realClear(mask);
+}
+
+static void APIENTRY traceClearColor(GLfloat red, GLfloat green, GLfloat blue,
+                                     GLfloat alpha) {
+  trace.record(TRACE_glClearColor);
+  trace.f32(red);
+  trace.f32(green);
+  trace.f32(blue);
+  trace.f32(alpha);
+  realClearColor(red, green, blue, alpha);
+}
+
+static GLenum APIENTRY traceClientWaitSync(GLsync sync, GLbitfield flags,
+                                           GLuint64 timeout) {
+  trace.record(TRACE_glClientWaitSync);
+  trace.u64((uint64_t)(uintptr_t)sync);
+  trace.u32(flags);
+  trace.u64(timeout);
+  return realClientWaitSync(sync, flags, timeout);
+}
+
+static void APIENTRY traceCompileShader(GLuint shader) {
+  trace.record(TRACE_glCompileShader);
+  trace.u32(shader);
+  realCompileShader(shader);
+}
+
+static GLuint APIENTRY traceCreateProgram() {
+  GLuint program = realCreateProgram();
+  trace.record(TRACE_glCreateProgram);
+  trace.u32(program);
+  return program;
+}
+
+static GLuint APIENTRY traceCreateShader(GLenum type) {
+  GLuint shader = realCreateShader(type);
+  trace.record(TRACE_glCreateShader);
+  trace.u32(type);
+  trace.u32(shader);
+  return shader;
+}
+
+static void APIENTRY traceCullFace(GLenum mode) {
+  trace.record(TRACE_glCullFace);
+  trace.u32(mode);
+  realCullFace(mode);
+}
+
+// the count and the names of a glGen* or glDelete* call
+static void traceNames(GlTraceRecord record, GLsizei n, const GLuint *names) {
+  trace.record(record);
+  trace.u32(n);
+  for (GLsizei i = 0; i < n; i++) {
+    trace.u32(names[i]);
+  }
+}
+
+static void APIENTRY traceDeleteBuffers(GLsizei n, const GLuint *buffers) {
+  traceNames(TRACE_glDeleteBuffers, n, buffers);
+  realDeleteBuffers(n, buffers);
+}
+
+static void APIENTRY traceDeleteFramebuffers(GLsizei n,
+                                             const GLuint *framebuffers) {
+  traceNames(TRACE_glDeleteFramebuffers, n, framebuffers);
+  realDeleteFramebuffers(n, framebuffers);
+}
+
+static void APIENTRY traceDeleteProgram(GLuint program) {
+  trace.record(TRACE_glDeleteProgram);
+  trace.u32(program);
+  realDeleteProgram(program);
+}
+
+static void APIENTRY traceDeleteQueries(GLsizei n, const GLuint *ids) {
+  traceNames(TRACE_glDeleteQueries, n, ids);
+  realDeleteQueries(n, ids);
+}
+
+static void APIENTRY traceDeleteRenderbuffers(GLsizei n,
+                                              const GLuint *renderbuffers) {
+  traceNames(TRACE_glDeleteRenderbuffers, n, renderbuffers);
+  realDeleteRenderbuffers(n, renderbuffers);
+}
+
+static void APIENTRY traceDeleteShader(GLuint shader) {
+  trace.record(TRACE_glDeleteShader);
+  trace.u32(shader);
+  realDeleteShader(shader);
+}
+
+static void APIENTRY traceDeleteSync(GLsync sync) {
+  trace.record(TRACE_glDeleteSync);
+  trace.u64((uint64_t)(uintptr_t)sync);
+  realDeleteSync(sync);
+}
+
+static void APIENTRY traceDeleteTextures(GLsizei n, const GLuint *textures) {
+  traceNames(TRACE_glDeleteTextures, n, textures);
+  realDeleteTextures(n, textures);
+}
+
+static void APIENTRY traceDeleteVertexArrays(GLsizei n,
+                                             const GLuint *arrays) {
+  traceNames(TRACE_glDeleteVertexArrays, n, arrays);
+  realDeleteVertexArrays(n, arrays);
+}
+
+static void APIENTRY traceDepthFunc(GLenum func) {
+  trace.record(TRACE_glDepthFunc);
+  trace.u32(func);
+  realDepthFunc(func);
+}
+
+static void APIENTRY traceDepthMask(GLboolean flag) {
+  trace.record(TRACE_glDepthMask);
+  trace.u32(flag);
+  realDepthMask(flag);
+}
+
+static void APIENTRY traceDisable(GLenum cap) {
+  trace.record(TRACE_glDisable);
+  trace.u32(cap);
+  realDisable(cap);
+}
+
+static void APIENTRY traceDispatchCompute(GLuint num_groups_x,
+                                          GLuint num_groups_y,
+                                          GLuint num_groups_z) {
+  trace.record(TRACE_glDispatchCompute);
+  trace.u32(num_groups_x);
+  trace.u32(num_groups_y);
+  trace.u32(num_groups_z);
+  realDispatchCompute(num_groups_x, num_groups_y, num_groups_z);
+}
+
+static void APIENTRY traceDrawArrays(GLenum mode, GLint first,
+                                     GLsizei count) {
+  trace.record(TRACE_glDrawArrays);
+  trace.u32(mode);
+  trace.i32(first);
+  trace.i32(count);
+  realDrawArrays(mode, first, count);
+}
+
+static void APIENTRY traceDrawArraysInstanced(GLenum mode, GLint first,
+                                              GLsizei count,
+                                              GLsizei instancecount) {
+  trace.record(TRACE_glDrawArraysInstanced);
+  trace.u32(mode);
+  trace.i32(first);
+  trace.i32(count);
+  trace.i32(instancecount);
+  realDrawArraysInstanced(mode, first, count, instancecount);
+}
+
+static void APIENTRY traceDrawBuffers(GLsizei n, const GLenum *bufs) {
+  trace.record(TRACE_glDrawBuffers);
+  trace.u32(n);
+  for (GLsizei i = 0; i < n; i++) {
+    trace.u32(bufs[i]);
+  }
+  realDrawBuffers(n, bufs);
+}
+
+static void APIENTRY traceDrawElements(GLenum mode, GLsizei count,
+                                       GLenum type, const void *indices) {
+  trace.record(TRACE_glDrawElements);
+  trace.u32(mode);
+  trace.i32(count);
+  trace.u32(type);
+  // an offset into the bound element buffer
+  trace.u64((uint64_t)(uintptr_t)indices);
+  realDrawElements(mode, count, type, indices);
+}
+
+static void APIENTRY traceDrawElementsInstanced(GLenum mode, GLsizei count,
+                                                GLenum type,
+                                                const void *indices,
+                                                GLsizei instancecount) {
+  trace.record(TRACE_glDrawElementsInstanced);
+  trace.u32(mode);
+  trace.i32(count);
+  trace.u32(type);
+  trace.u64((uint64_t)(uintptr_t)indices);
+  trace.i32(instancecount);
+  realDrawElementsInstanced(mode, count, type, indices, instancecount);
+}
+
+static void APIENTRY traceEnable(GLenum cap) {
+  trace.record(TRACE_glEnable);
+  trace.u32(cap);
+  realEnable(cap);
+}
+
+static void APIENTRY traceEnableVertexAttribArray(GLuint index) {
+  trace.record(TRACE_glEnableVertexAttribArray);
+  trace.u32(index);
+  realEnableVertexAttribArray(index);
+}
+
+static void APIENTRY traceEndQuery(GLenum target) {
+  trace.record(TRACE_glEndQuery);
+  trace.u32(target);
+  realEndQuery(target);
+}
+
+static GLsync APIENTRY traceFenceSync(GLenum condition, GLbitfield flags) {
+  GLsync sync = realFenceSync(condition, flags);
+  trace.record(TRACE_glFenceSync);
+  trace.u32(condition);
+  trace.u32(flags);
+  trace.u64((uint64_t)(uintptr_t)sync);
+  return sync;
+}
+
+// Records the flushed bytes, the only point at which the writes to a mapping
+// are known to be complete. offset is from the start of the mapped range.
+static void APIENTRY traceFlushMappedBufferRange(GLenum target,
+                                                 GLintptr offset,
+                                                 GLsizeiptr length) {
+  void *mapped = NULL;
+  glGetBufferPointerv(target, GL_BUFFER_MAP_POINTER, &mapped);
+  uint64_t hash =
+      mapped ? trace.blob(static_cast<unsigned char *>(mapped) + offset,
+                          length)
+             : 0;
+  trace.record(TRACE_glFlushMappedBufferRange);
+  trace.u32(target);
+  trace.u64(offset);
+  trace.u64(length);
+  trace.u64(hash);
+  realFlushMappedBufferRange(target, offset, length);
+}
+
+static void APIENTRY traceFramebufferRenderbuffer(GLenum target,
+                                                  GLenum attachment,
+                                                  GLenum renderbuffertarget,
+                                                  GLuint renderbuffer) {
+  trace.record(TRACE_glFramebufferRenderbuffer);
+  trace.u32(target);
+  trace.u32(attachment);
+  trace.u32(renderbuffertarget);
+  trace.u32(renderbuffer);
+  realFramebufferRenderbuffer(target, attachment, renderbuffertarget,
+                              renderbuffer);
+}
+
+static void APIENTRY traceFramebufferTexture2D(GLenum target,
+                                               GLenum attachment,
+                                               GLenum textarget,
+                                               GLuint texture, GLint level) {
+  trace.record(TRACE_glFramebufferTexture2D);
+  trace.u32(target);
+  trace.u32(attachment);
+  trace.u32(textarget);
+  trace.u32(texture);
+  trace.i32(level);
+  realFramebufferTexture2D(target, attachment, textarget, texture, level);
+}
+
+static void APIENTRY traceGenBuffers(GLsizei n, GLuint *buffers) {
+  realGenBuffers(n, buffers);
+  traceNames(TRACE_glGenBuffers, n, buffers);
+}
+
+static void APIENTRY traceGenFramebuffers(GLsizei n, GLuint *framebuffers) {
+  realGenFramebuffers(n, framebuffers);
+  traceNames(TRACE_glGenFramebuffers, n, framebuffers);
+}
+
+static void APIENTRY traceGenQueries(GLsizei n, GLuint *ids) {
+  realGenQueries(n, ids);
+  traceNames(TRACE_glGenQueries, n, ids);
+}
+
+static void APIENTRY traceGenRenderbuffers(GLsizei n, GLuint *renderbuffers) {
+  realGenRenderbuffers(n, renderbuffers);
+  traceNames(TRACE_glGenRenderbuffers, n, renderbuffers);
+}
+
+static void APIENTRY traceGenTextures(GLsizei n, GLuint *textures) {
+  realGenTextures(n, textures);
+  traceNames(TRACE_glGenTextures, n, textures);
+}
+
+static void APIENTRY traceGenVertexArrays(GLsizei n, GLuint *arrays) {
+  realGenVertexArrays(n, arrays);
+  traceNames(TRACE_glGenVertexArrays, n, arrays);
+}
+
+static void APIENTRY traceGenerateMipmap(GLenum target) {
+  trace.record(TRACE_glGenerateMipmap);
+  trace.u32(target);
+  realGenerateMipmap(target);
+}
+
+// Readbacks are recorded without the data, a replay repeats them for the
+// stalls they cause
+static void APIENTRY traceGetBufferSubData(GLenum target, GLintptr offset,
+                                           GLsizeiptr size, void *data) {
+  trace.record(TRACE_glGetBufferSubData);
+  trace.u32(target);
+  trace.u64(offset);
+  trace.u64(size);
+  realGetBufferSubData(target, offset, size, data);
+}
+
+// Queries are recorded without their results, a replay repeats them for
+// the stalls they cause
+static void APIENTRY traceGetInteger64v(GLenum pname, GLint64 *data) {
+  trace.record(TRACE_glGetInteger64v);
+  trace.u32(pname);
+  realGetInteger64v(pname, data);
+}
+
+static void APIENTRY traceGetProgramInfoLog(GLuint program, GLsizei bufSize,
+                                            GLsizei *length,
+                                            GLchar *infoLog) {
+  trace.record(TRACE_glGetProgramInfoLog);
+  trace.u32(program);
+  realGetProgramInfoLog(program, bufSize, length, infoLog);
+}
+
+static void APIENTRY traceGetProgramiv(GLuint program, GLenum pname,
+                                       GLint *params) {
+  trace.record(TRACE_glGetProgramiv);
+  trace.u32(program);
+  trace.u32(pname);
+  realGetProgramiv(program, pname, params);
+}
+
+static void APIENTRY traceGetQueryObjectiv(GLuint id, GLenum pname,
+                                           GLint *params) {
+  trace.record(TRACE_glGetQueryObjectiv);
+  trace.u32(id);
+  trace.u32(pname);
+  realGetQueryObjectiv(id, pname, params);
+}
+
+static void APIENTRY traceGetQueryObjectui64v(GLuint id, GLenum pname,
+                                              GLuint64 *params) {
+  trace.record(TRACE_glGetQueryObjectui64v);
+  trace.u32(id);
+  trace.u32(pname);
+  realGetQueryObjectui64v(id, pname, params);
+}
+
+static void APIENTRY traceGetShaderInfoLog(GLuint shader, GLsizei bufSize,
+                                           GLsizei *length, GLchar *infoLog) {
+  trace.record(TRACE_glGetShaderInfoLog);
+  trace.u32(shader);
+  realGetShaderInfoLog(shader, bufSize, length, infoLog);
+}
+
+static void APIENTRY traceGetShaderiv(GLuint shader, GLenum pname,
+                                      GLint *params) {
+  trace.record(TRACE_glGetShaderiv);
+  trace.u32(shader);
+  trace.u32(pname);
+  realGetShaderiv(shader, pname, params);
+}
+
+// the results are recorded, a replay maps them to its own
+static GLuint APIENTRY traceGetUniformBlockIndex(GLuint program,
+                                                 const GLchar *name) {
+  GLuint index = realGetUniformBlockIndex(program, name);
+  trace.record(TRACE_glGetUniformBlockIndex);
+  trace.u32(program);
+  trace.string(name);
+  trace.u32(index);
+  return index;
+}
+
+static GLint APIENTRY traceGetUniformLocation(GLuint program,
+                                              const GLchar *name) {
+  GLint location = realGetUniformLocation(program, name);
+  trace.record(TRACE_glGetUniformLocation);
+  trace.u32(program);
+  trace.string(name);
+  trace.i32(location);
+  return location;
+}
+
+static void APIENTRY traceLinkProgram(GLuint program) {
+  trace.record(TRACE_glLinkProgram);
+  trace.u32(program);
+  realLinkProgram(program);
+}
+
+static void *APIENTRY traceMapBufferRange(GLenum target, GLintptr offset,
+                                          GLsizeiptr length,
+                                          GLbitfield access) {
+  trace.record(TRACE_glMapBufferRange);
+  trace.u32(target);
+  trace.u64(offset);
+  trace.u64(length);
+  trace.u32(access);
+  return realMapBufferRange(target, offset, length, access);
+}
+
+static void APIENTRY traceMemoryBarrier(GLbitfield barriers) {
+  trace.record(TRACE_glMemoryBarrier);
+  trace.u32(barriers);
+  realMemoryBarrier(barriers);
+}
+
+static void APIENTRY traceMultiDrawElementsIndirect(GLenum mode, GLenum type,
+                                                    const void *indirect,
+                                                    GLsizei drawcount,
+                                                    GLsizei stride) {
+  trace.record(TRACE_glMultiDrawElementsIndirect);
+  trace.u32(mode);
+  trace.u32(type);
+  // an offset into the bound draw indirect buffer
+  trace.u64((uint64_t)(uintptr_t)indirect);
+  trace.i32(drawcount);
+  trace.i32(stride);
+  realMultiDrawElementsIndirect(mode, type, indirect, drawcount, stride);
+}
+
+static void APIENTRY traceQueryCounter(GLuint id, GLenum target) {
+  trace.record(TRACE_glQueryCounter);
+  trace.u32(id);
+  trace.u32(target);
+  realQueryCounter(id, target);
+}
+
+static void APIENTRY traceRenderbufferStorage(GLenum target,
+                                              GLenum internalformat,
+                                              GLsizei width, GLsizei height) {
+  trace.record(TRACE_glRenderbufferStorage);
+  trace.u32(target);
+  trace.u32(internalformat);
+  trace.i32(width);
+  trace.i32(height);
+  realRenderbufferStorage(target, internalformat, width, height);
+}
+
+static void APIENTRY traceShaderSource(GLuint shader, GLsizei count,
+                                       const GLchar *const *string,
+                                       const GLint *length) {
+  // the pieces joined into one blob
+  std::string source;
+  for (GLsizei i = 0; i < count; i++) {
+    if (length && length[i] >= 0) {
+      source.append(string[i], length[i]);
+    } else {
+      source.append(string[i]);
+    }
+  }
+  uint64_t hash = trace.blob(source.data(), source.size());
+  trace.record(TRACE_glShaderSource);
+  trace.u32(shader);
+  trace.u64(hash);
+  realShaderSource(shader, count, string, length);
+}
+
+static void APIENTRY traceTexBuffer(GLenum target, GLenum internalformat,
+                                    GLuint buffer) {
+  trace.record(TRACE_glTexBuffer);
+  trace.u32(target);
+  trace.u32(internalformat);
+  trace.u32(buffer);
+  realTexBuffer(target, internalformat, buffer);
+}
+
+static void APIENTRY traceTexImage2D(GLenum target, GLint level,
+                                     GLint internalformat, GLsizei width,
+                                     GLsizei height, GLint border,
+                                     GLenum format, GLenum type,
+                                     const void *pixels) {
+  uint64_t hash =
+      trace.blob(pixels, imageBytes(width, height, 1, format, type));
+  trace.record(TRACE_glTexImage2D);
+  trace.u32(target);
+  trace.i32(level);
+  trace.i32(internalformat);
+  trace.i32(width);
+  trace.i32(height);
+  trace.i32(border);
+  trace.u32(format);
+  trace.u32(type);
+  trace.u64(hash);
+  realTexImage2D(target, level, internalformat, width, height, border,
+                 format, type, pixels);
+}
+
+static void APIENTRY traceTexImage3D(GLenum target, GLint level,
+                                     GLint internalformat, GLsizei width,
+                                     GLsizei height, GLsizei depth,
+                                     GLint border, GLenum format, GLenum type,
+                                     const void *pixels) {
+  uint64_t hash =
+      trace.blob(pixels, imageBytes(width, height, depth, format, type));
+  trace.record(TRACE_glTexImage3D);
+  trace.u32(target);
+  trace.i32(level);
+  trace.i32(internalformat);
+  trace.i32(width);
+  trace.i32(height);
+  trace.i32(depth);
+  trace.i32(border);
+  trace.u32(format);
+  trace.u32(type);
+  trace.u64(hash);
+  realTexImage3D(target, level, internalformat, width, height, depth, border,
+                 format, type, pixels);
+}
+
+static void APIENTRY traceTexParameteri(GLenum target, GLenum pname,
+                                        GLint param) {
+  trace.record(TRACE_glTexParameteri);
+  trace.u32(target);
+  trace.u32(pname);
+  trace.i32(param);
+  realTexParameteri(target, pname, param);
+}
+
+static void APIENTRY traceTexSubImage3D(GLenum target, GLint level,
+                                        GLint xoffset, GLint yoffset,
+                                        GLint zoffset, GLsizei width,
+                                        GLsizei height, GLsizei depth,
+                                        GLenum format, GLenum type,
+                                        const void *pixels) {
+  uint64_t hash =
+      trace.blob(pixels, imageBytes(width, height, depth, format, type));
+  trace.record(TRACE_glTexSubImage3D);
+  trace.u32(target);
+  trace.i32(level);
+  trace.i32(xoffset);
+  trace.i32(yoffset);
+  trace.i32(zoffset);
+  trace.i32(width);
+  trace.i32(height);
+  trace.i32(depth);
+  trace.u32(format);
+  trace.u32(type);
+  trace.u64(hash);
+  realTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height,
+                    depth, format, type, pixels);
+}
+
+static void APIENTRY traceUniform1f(GLint location, GLfloat v0) {
+  trace.record(TRACE_glUniform1f);
+  trace.i32(location);
+  trace.f32(v0);
+  realUniform1f(location, v0);
+}
+
+static void APIENTRY traceUniform1i(GLint location, GLint v0) {
+  trace.record(TRACE_glUniform1i);
+  trace.i32(location);
+  trace.i32(v0);
+  realUniform1i(location, v0);
+}
+
+static void APIENTRY traceUniform2f(GLint location, GLfloat v0, GLfloat v1) {
+  trace.record(TRACE_glUniform2f);
+  trace.i32(location);
+  trace.f32(v0);
+  trace.f32(v1);
+  realUniform2f(location, v0, v1);
+}
+
+// the location, count and the floats of a glUniform*fv call, size of them
+// per element
+static void traceUniformv(GlTraceRecord record, GLint location,
+                          GLsizei count, const GLfloat *value,
+                          unsigned int size) {
+  trace.record(record);
+  trace.i32(location);
+  trace.i32(count);
+  trace.bytes(value, count * size * sizeof(GLfloat));
+}
+
+static void APIENTRY traceUniform2fv(GLint location, GLsizei count,
+                                     const GLfloat *value) {
+  traceUniformv(TRACE_glUniform2fv, location, count, value, 2);
+  realUniform2fv(location, count, value);
+}
+
+static void APIENTRY traceUniform3f(GLint location, GLfloat v0, GLfloat v1,
+                                    GLfloat v2) {
+  trace.record(TRACE_glUniform3f);
+  trace.i32(location);
+  trace.f32(v0);
+  trace.f32(v1);
+  trace.f32(v2);
+  realUniform3f(location, v0, v1, v2);
+}
+
+static void APIENTRY traceUniform3fv(GLint location, GLsizei count,
+                                     const GLfloat *value) {
+  traceUniformv(TRACE_glUniform3fv, location, count, value, 3);
+  realUniform3fv(location, count, value);
+}
+
+static void APIENTRY traceUniform4f(GLint location, GLfloat v0, GLfloat v1,
+                                    GLfloat v2, GLfloat v3) {
+  trace.record(TRACE_glUniform4f);
+  trace.i32(location);
+  trace.f32(v0);
+  trace.f32(v1);
+  trace.f32(v2);
+  trace.f32(v3);
+  realUniform4f(location, v0, v1, v2, v3);
+}
+
+static void APIENTRY traceUniform4fv(GLint location, GLsizei count,
+                                     const GLfloat *value) {
+  traceUniformv(TRACE_glUniform4fv, location, count, value, 4);
+  realUniform4fv(location, count, value);
+}
+
+static void APIENTRY traceUniformBlockBinding(GLuint program,
+                                              GLuint uniformBlockIndex,
+                                              GLuint uniformBlockBinding) {
+  trace.record(TRACE_glUniformBlockBinding);
+  trace.u32(program);
+  trace.u32(uniformBlockIndex);
+  trace.u32(uniformBlockBinding);
+  realUniformBlockBinding(program, uniformBlockIndex, uniformBlockBinding);
+}
+
+// like traceUniformv, with the transpose flag after the count
+static void traceUniformMatrix(GlTraceRecord record, GLint location,
+                               GLsizei count, GLboolean transpose,
+                               const GLfloat *value, unsigned int size) {
+  trace.record(record);
+  trace.i32(location);
+  trace.i32(count);
+  trace.u32(transpose);
+  trace.bytes(value, count * size * sizeof(GLfloat));
+}
+
+static void APIENTRY traceUniformMatrix2fv(GLint location, GLsizei count,
+                                           GLboolean transpose,
+                                           const GLfloat *value) {
+  traceUniformMatrix(TRACE_glUniformMatrix2fv, location, count, transpose,
+                     value, 4);
+  realUniformMatrix2fv(location, count, transpose, value);
+}
+
+static void APIENTRY traceUniformMatrix3fv(GLint location, GLsizei count,
+                                           GLboolean transpose,
+                                           const GLfloat *value) {
+  traceUniformMatrix(TRACE_glUniformMatrix3fv, location, count, transpose,
+                     value, 9);
+  realUniformMatrix3fv(location, count, transpose, value);
+}
+
+static void APIENTRY traceUniformMatrix4fv(GLint location, GLsizei count,
+                                           GLboolean transpose,
+                                           const GLfloat *value) {
+  traceUniformMatrix(TRACE_glUniformMatrix4fv, location, count, transpose,
+                     value, 16);
+  realUniformMatrix4fv(location, count, transpose, value);
+}
+
+static GLboolean APIENTRY traceUnmapBuffer(GLenum target) {
+  trace.record(TRACE_glUnmapBuffer);
+  trace.u32(target);
+  return realUnmapBuffer(target);
+}
+
+static void APIENTRY traceUseProgram(GLuint program) {
+  trace.record(TRACE_glUseProgram);
+  trace.u32(program);
+  realUseProgram(program);
+}
+
+static void APIENTRY traceVertexAttribDivisor(GLuint index, GLuint divisor) {
+  trace.record(TRACE_glVertexAttribDivisor);
+  trace.u32(index);
+  trace.u32(divisor);
+  realVertexAttribDivisor(index, divisor);
+}
+
+static void APIENTRY traceVertexAttribI4i(GLuint index, GLint x, GLint y,
+                                          GLint z, GLint w) {
+  trace.record(TRACE_glVertexAttribI4i);
+  trace.u32(index);
+  trace.i32(x);
+  trace.i32(y);
+  trace.i32(z);
+  trace.i32(w);
+  realVertexAttribI4i(index, x, y, z, w);
+}
+
+static void APIENTRY traceVertexAttribIPointer(GLuint index, GLint size,
+                                               GLenum type, GLsizei stride,
+                                               const void *pointer) {
+  trace.record(TRACE_glVertexAttribIPointer);
+  trace.u32(index);
+  trace.i32(size);
+  trace.u32(type);
+  trace.i32(stride);
+  // an offset into the bound array buffer
+  trace.u64((uint64_t)(uintptr_t)pointer);
+  realVertexAttribIPointer(index, size, type, stride, pointer);
+}
+
+static void APIENTRY traceVertexAttribPointer(GLuint index, GLint size,
+                                              GLenum type,
+                                              GLboolean normalized,
+                                              GLsizei stride,
+                                              const void *pointer) {
+  trace.record(TRACE_glVertexAttribPointer);
+  trace.u32(index);
+  trace.i32(size);
+  trace.u32(type);
+  trace.u32(normalized);
+  trace.i32(stride);
+  trace.u64((uint64_t)(uintptr_t)pointer);
+  realVertexAttribPointer(index, size, type, normalized, stride, pointer);
+}
+
+static void APIENTRY traceViewport(GLint x, GLint y, GLsizei width,
+                                   GLsizei height) {
+  trace.record(TRACE_glViewport);
+  trace.i32(x);
+  trace.i32(y);
+  trace.i32(width);
+  trace.i32(height);
+  realViewport(x, y, width, height);
+}
+
+bool startGlTrace(const std::string &path, unsigned int maxFrames) {
+  if (trace.file) {
+    return true;
+  }
+  trace.file = fopen(path.c_str(), "wb");
+  if (!trace.file) {
+    std::cout << "ERROR::GL_TRACE:: can't write " << path << std::endl;
+    return false;
+  }
+  trace.frames = 0;
+  trace.maxFrames = maxFrames;
+  trace.bytes(GL_TRACE_MAGIC, sizeof(GL_TRACE_MAGIC));
+  trace.u32(GL_TRACE_VERSION);
+  // functions the context lacks stay NULL
+#define GL_TRACE_HOOK(name)                                                    \
+  real##name = glad_gl##name;                                                  \
+  if (real##name) {                                                            \
+    glad_gl##name = trace##name;                                               \
+  }
+  GL_TRACE_FUNCTIONS(GL_TRACE_HOOK)
+#undef GL_TRACE_HOOK
+  return true;
+}
+
+void traceGlFrame(int width, int height) {
+  if (!trace.file) {
+    return;
+  }
+  trace.record(TRACE_FRAME);
+  trace.u32(width);
+  trace.u32(height);
+  trace.flush();
+  trace.frames++;
+  if (trace.maxFrames != 0 && trace.frames >= trace.maxFrames) {
+    stopGlTrace();
+  }
+}
+
+void stopGlTrace() {
+  if (!trace.file) {
+    return;
+  }
+#define GL_TRACE_UNHOOK(name) glad_gl##name = real##name;
+  GL_TRACE_FUNCTIONS(GL_TRACE_UNHOOK)
+#undef GL_TRACE_UNHOOK
+  trace.flush();
+  fclose(trace.file);
+  trace.file = NULL;
+  std::vector<unsigned char>().swap(trace.buffer);
+  trace.blobs.clear();
+}
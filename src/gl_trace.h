@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Environment variable naming the file to trace the GL calls of the run to,
+// and the one limiting the trace to a number of frames. Tracing is off
+// unless the first is set.
+const char *const GL_TRACE_VARIABLE = "LEARNOPENGL_TRACE";
+const char *const GL_TRACE_FRAMES_VARIABLE = "LEARNOPENGL_TRACE_FRAMES";
+
+// A trace starts with these 8 bytes and the version as a uint32, followed by
+// records. Each record is a uint16 id and its arguments in the host's byte
+// order:
+// - TRACE_FRAME: the uint32 width and height of the window's framebuffer,
+//   ending a frame.
+// - TRACE_BLOB: a uint64 hash, uint64 size and the bytes, written before the
+//   first call that passes them. Calls refer to blobs by hash, 0 for NULL.
+// - TRACE_gl*: a call, see gl_trace.cpp for the arguments of each. Object
+//   names and sync objects are recorded as the engine saw them, a replay
+//   maps them to its own. What the engine writes to mapped buffers is
+//   recorded when it flushes the range, so mappings must be made with
+//   GL_MAP_FLUSH_EXPLICIT_BIT to be replayed.
+const char GL_TRACE_MAGIC[8] = {'L', 'O', 'G', 'L', 'T', 'R', 'C', 'E'};
+const uint32_t GL_TRACE_VERSION = 3;
+
+// the wrapped GL functions, in the order of their record ids
+#define GL_TRACE_FUNCTIONS(X)                                                  \
+  X(ActiveTexture)                                                             \
+  X(AttachShader)                                                              \
+  X(BeginQuery)                                                                \
+  X(BindBuffer)                                                                \
+  X(BindBufferBase)                                                            \
+  X(BindFramebuffer)                                                           \
+  X(BindRenderbuffer)                                                          \
+  X(BindTexture)                                                               \
+  X(BindVertexArray)                                                           \
+  X(BlendFunc)                                                                 \
+  X(BlitFramebuffer)                                                           \
+  X(BufferData)                                                                \
+  X(BufferStorage)                                                             \
+  X(BufferSubData)                                                             \
+  X(CheckFramebufferStatus)                                                    \
+  X(Clear)                                                                     \
+  X(ClearColor)                                                                \
+  X(ClientWaitSync)                                                            \
+  X(CompileShader)                                                             \
+  X(CreateProgram)                                                             \
+  X(CreateShader)                                                              \
+  X(CullFace)                                                                  \
+  X(DeleteBuffers)                                                             \
+  X(DeleteFramebuffers)                                                        \
+  X(DeleteProgram)                                                             \
+  X(DeleteQueries)                                                             \
+  X(DeleteRenderbuffers)                                                       \
+  X(DeleteShader)                                                              \
+  X(DeleteSync)                                                                \
+  X(DeleteTextures)                                                            \
+  X(DeleteVertexArrays)                                                        \
+  X(DepthFunc)                                                                 \
+  X(DepthMask)                                                                 \
+  X(Disable)                                                                   \
+  X(DispatchCompute)                                                           \
+  X(DrawArrays)                                                                \
+  X(DrawArraysInstanced)                                                       \
+  X(DrawBuffers)                                                               \
+  X(DrawElements)                                                              \
+  X(DrawElementsInstanced)                                                     \
+  X(Enable)                                                                    \
+  X(EnableVertexAttribArray)                                                   \
+  X(EndQuery)                                                                  \
+  X(FenceSync)                                                                 \
+  X(FlushMappedBufferRange)                                                    \
+  X(FramebufferRenderbuffer)                                                   \
+  X(FramebufferTexture2D)                                                      \
+  X(GenBuffers)                                                                \
+  X(GenFramebuffers)                                                           \
+  X(GenQueries)                                                                \
+  X(GenRenderbuffers)                                                          \
+  X(GenTextures)                                                               \
+  X(GenVertexArrays)                                                           \
+  X(GenerateMipmap)                                                            \
+  X(GetBufferSubData)                                                          \
+  X(GetInteger64v)                                                             \
+  X(GetProgramInfoLog)                                                         \
+  X(GetProgramiv)                                                              \
+  X(GetQueryObjectiv)                                                          \
+  X(GetQueryObjectui64v)                                                       \
+  X(GetShaderInfoLog)                                                          \
+  X(GetShaderiv)                                                               \
+  X(GetUniformBlockIndex)                                                      \
+  X(GetUniformLocation)                                                        \
+  X(LinkProgram)                                                               \
+  X(MapBufferRange)                                                            \
+  X(MemoryBarrier)                                                             \
+  X(MultiDrawElementsIndirect)                                                 \
+  X(QueryCounter)                                                              \
+  X(RenderbufferStorage)                                                       \
+  X(ShaderSource)                                                              \
+  X(TexBuffer)                                                                 \
+  X(TexImage2D)                                                                \
+  X(TexImage3D)                                                                \
+  X(TexParameteri)                                                             \
+  X(TexSubImage3D)                                                             \
+  X(Uniform1f)                                                                 \
+  X(Uniform1i)                                                                 \
+  X(Uniform2f)                                                                 \
+  X(Uniform2fv)                                                                \
+  X(Uniform3f)                                                                 \
+  X(Uniform3fv)                                                                \
+  X(Uniform4f)                                                                 \
+  X(Uniform4fv)                                                                \
+  X(UniformBlockBinding)                                                       \
+  X(UniformMatrix2fv)                                                          \
+  X(UniformMatrix3fv)                                                          \
+  X(UniformMatrix4fv)                                                          \
+  X(UnmapBuffer)                                                               \
+  X(UseProgram)                                                                \
+  X(VertexAttribDivisor)                                                       \
+  X(VertexAttribI4i)                                                           \
+  X(VertexAttribIPointer)                                                      \
+  X(VertexAttribPointer)                                                       \
+  X(Viewport)
+
+#define GL_TRACE_RECORD_ID(name) TRACE_gl##name,
+enum GlTraceRecord {
+  TRACE_FRAME,
+  TRACE_BLOB,
+  GL_TRACE_FUNCTIONS(GL_TRACE_RECORD_ID) TRACE_RECORDS
+};
+#undef GL_TRACE_RECORD_ID
+
+// name of a record id, "glBindBuffer" for TRACE_glBindBuffer
+const char *glTraceRecordName(unsigned int record);
+
+// hash blobs are deduplicated by, never 0
+uint64_t glTraceHash(const void *data, size_t size);
+
+// Starts writing the GL calls made through glad to path, replacing glad's
+// function pointers with recording wrappers. Call after gladLoadGLLoader and
+// before any other GL call, so the trace holds every object it uses. After
+// maxFrames frames, unless 0, the trace is closed and the pointers restored.
+// Returns false if the file can't be written.
+bool startGlTrace(const std::string &path, unsigned int maxFrames = 0);
+
+// Ends the frame in the trace, if tracing. width and height are those of
+// the window's framebuffer, which a replay stands in for.
+void traceGlFrame(int width, int height);
+
+// closes the trace and restores glad's function pointers
+void stopGlTrace();
@@ -0,0 +1,31 @@
+#include <glad/glad.h>
+
+#include "gpu_timer.h"
+
+GpuTimer::GpuTimer() : issued(0), lastMilliseconds(0.0f), fresh(false) {
+  glGenQueries(GPU_TIMER_QUERIES, queries);
+}
+
+GpuTimer::~GpuTimer() { glDeleteQueries(GPU_TIMER_QUERIES, queries); }
+
+void GpuTimer::begin() {
+  glBeginQuery(GL_TIME_ELAPSED, queries[issued % GPU_TIMER_QUERIES]);
+}
+
+void GpuTimer::end() {
+  glEndQuery(GL_TIME_ELAPSED);
+  issued++;
+  fresh = false;
+
+  // the oldest query is the next one to be reused, so read it back now. It
+  // was issued GPU_TIMER_QUERIES - 1 frames ago and is almost always done;
+  // if not, waiting is preferable to reusing a busy query object.
+  if (issued < GPU_TIMER_QUERIES) {
+    return;
+  }
+  unsigned int oldest = queries[issued % GPU_TIMER_QUERIES];
+  GLuint64 elapsed = 0;
+  glGetQueryObjectui64v(oldest, GL_QUERY_RESULT, &elapsed);
+  lastMilliseconds = elapsed / 1000000.0f;
+  fresh = true;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glad/glad.h>
+
+// Number of timer queries kept in flight. Results are read back this many
+// frames late so that querying them never stalls the pipeline.
+const unsigned int GPU_TIMER_QUERIES = 4;
+
+// Measures the GPU time spent between begin() and end() using
+// GL_TIME_ELAPSED queries
+class GpuTimer {
+public:
+  GpuTimer();
+  ~GpuTimer();
+
+  void begin();
+  void end();
+
+  // Returns true if a new measurement became available during the last end()
+  bool hasResult() const { return fresh; }
+
+  // GPU time of the most recently completed measurement, in milliseconds
+  float milliseconds() const { return lastMilliseconds; }
+
+private:
+  unsigned int queries[GPU_TIMER_QUERIES];
+  unsigned int issued;
+  float lastMilliseconds;
+  bool fresh;
+
+  GpuTimer(const GpuTimer &);
+  GpuTimer &operator=(const GpuTimer &);
+};
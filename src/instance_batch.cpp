@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "instance_batch.h"
+#include "mesh.h"
+#include "model.h"
+#include "telemetry.h"
+
+bool InstanceBatch::supported() { return GLAD_GL_VERSION_4_3 != 0; }
+
+InstanceBatch::InstanceBatch(Model &model, unsigned int maxInstances)
+    : skippedMeshes(0), model(model), maxInstances(maxInstances),
+      cullShader("shaders/cull-instances.comp") {
+  // the batched meshes one after the other, with their layers per vertex
+  // since a multi-draw can't change a constant attribute between draws
+  vector<Vertex> vertices;
+  vector<glm::ivec4> layers;
+  vector<unsigned int> indices;
+  vector<BatchedMesh> batched;
+  for (unsigned int i = 0; i < model.meshes.size(); i++) {
+    const Mesh &mesh = model.meshes[i];
+    if (mesh.skinned || !mesh.layered || mesh.indices.empty()) {
+      skippedMeshes++;
+      continue;
+    }
+    DrawCommand command;
+    command.count = mesh.indices.size();
+    command.instanceCount = 0;
+    command.firstIndex = indices.size();
+    command.baseVertex = vertices.size();
+    command.baseInstance = commands.size() * maxInstances;
+    commands.push_back(command);
+
+    vertices.insert(vertices.end(), mesh.vertices.begin(),
+                    mesh.vertices.end());
+    layers.resize(vertices.size(), mesh.materialLayers);
+    indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+
+    meshBounds.push_back(mesh.bounds);
+    meshTransforms.push_back(model.nodes.getWorld(model.meshNodes[i]));
+    BatchedMesh gpuMesh;
+    gpuMesh.transform = meshTransforms.back();
+    gpuMesh.boundsMin = glm::vec4(mesh.bounds.min, 1.0f);
+    gpuMesh.boundsMax = glm::vec4(mesh.bounds.max, 1.0f);
+    batched.push_back(gpuMesh);
+  }
+
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &VBO);
+  glGenBuffers(1, &layersVBO);
+  glGenBuffers(1, &EBO);
+  glGenBuffers(1, &instanceBuffer);
+  glGenBuffers(1, &meshBuffer);
+  glGenBuffers(1, &commandBuffer);
+  glGenBuffers(1, &visibleTransformBuffer);
+  glGenBuffers(1, &visibleInstanceBuffer);
+
+  glBindVertexArray(VAO);
+  // the vertex layout of Mesh::setupMesh
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex),
+               vertices.empty() ? NULL : &vertices[0], GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, normal));
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, texCoords));
+  glEnableVertexAttribArray(3);
+  glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, tangent));
+  glEnableVertexAttribArray(4);
+  glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        (void *)offsetof(Vertex, bitangent));
+  glEnableVertexAttribArray(5);
+  glVertexAttribIPointer(5, MAX_BONE_INFLUENCE, GL_INT, sizeof(Vertex),
+                         (void *)offsetof(Vertex, boneIds));
+  glEnableVertexAttribArray(6);
+  glVertexAttribPointer(6, MAX_BONE_INFLUENCE, GL_FLOAT, GL_FALSE,
+                        sizeof(Vertex), (void *)offsetof(Vertex, weights));
+
+  glBindBuffer(GL_ARRAY_BUFFER, layersVBO);
+  glBufferData(GL_ARRAY_BUFFER, layers.size() * sizeof(glm::ivec4),
+               layers.empty() ? NULL : &layers[0], GL_STATIC_DRAW);
+  glEnableVertexAttribArray(MATERIAL_LAYERS_ATTRIBUTE);
+  glVertexAttribIPointer(MATERIAL_LAYERS_ATTRIBUTE, 4, GL_INT,
+                         sizeof(glm::ivec4), (void *)0);
+
+  // the culling shader writes maxInstances transforms per mesh, each
+  // command's baseInstance selects its range
+  glBindBuffer(GL_ARRAY_BUFFER, visibleTransformBuffer);
+  glBufferData(GL_ARRAY_BUFFER,
+               commands.size() * maxInstances * sizeof(glm::mat4), NULL,
+               GL_DYNAMIC_COPY);
+  for (unsigned int column = 0; column < 4; column++) {
+    unsigned int attribute = INSTANCE_TRANSFORM_ATTRIBUTE + column;
+    glEnableVertexAttribArray(attribute);
+    glVertexAttribPointer(attribute, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                          (void *)(column * sizeof(glm::vec4)));
+    glVertexAttribDivisor(attribute, 1);
+  }
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+               indices.empty() ? NULL : &indices[0], GL_STATIC_DRAW);
+  glBindVertexArray(0);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, meshBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, batched.size() * sizeof(BatchedMesh),
+               batched.empty() ? NULL : &batched[0], GL_STATIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, maxInstances * sizeof(glm::mat4),
+               NULL, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleInstanceBuffer);
+  glBufferData(GL_SHADER_STORAGE_BUFFER,
+               commands.size() * maxInstances * sizeof(GLuint), NULL,
+               GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawCommand),
+               commands.empty() ? NULL : &commands[0], GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  geometryBytes = vertices.size() * (sizeof(Vertex) + sizeof(glm::ivec4)) +
+                  indices.size() * sizeof(unsigned int);
+  telemetry().meshBytes += geometryBytes;
+
+  cullShader.use();
+  cullShader.setInt("meshCount", commands.size());
+  cullShader.setInt("maxInstances", maxInstances);
+  cullShader.setInt("instanceCount", 0);
+}
+
+InstanceBatch::~InstanceBatch() {
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &layersVBO);
+  glDeleteBuffers(1, &EBO);
+  glDeleteBuffers(1, &instanceBuffer);
+  glDeleteBuffers(1, &meshBuffer);
+  glDeleteBuffers(1, &commandBuffer);
+  glDeleteBuffers(1, &visibleTransformBuffer);
+  glDeleteBuffers(1, &visibleInstanceBuffer);
+  glDeleteProgram(cullShader.ID);
+  telemetry().programs--;
+  telemetry().meshBytes -= geometryBytes;
+}
+
+void InstanceBatch::setInstances(const vector<glm::mat4> &transforms) {
+  instances.assign(transforms.begin(),
+                   transforms.begin() +
+                       std::min<size_t>(transforms.size(), maxInstances));
+  if (instances.empty()) {
+    return;
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                  instances.size() * sizeof(glm::mat4), &instances[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void InstanceBatch::cull(const Frustum &frustum) {
+  if (commands.empty()) {
+    return;
+  }
+  // no instances in any command yet, the shader counts them up
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+  glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                  commands.size() * sizeof(DrawCommand), &commands[0]);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  cullShader.use();
+  glUniform4fv(glGetUniformLocation(cullShader.ID, "frustumPlanes"), 6,
+               &frustum.planes[0][0]);
+  cullShader.setInt("instanceCount", instances.size());
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, meshBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, visibleTransformBuffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, visibleInstanceBuffer);
+  unsigned int invocations = instances.size() * commands.size();
+  glDispatchCompute((invocations + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE,
+                    1, 1);
+  // the draws read the commands and transforms the shader wrote
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT |
+                  GL_BUFFER_UPDATE_BARRIER_BIT);
+}
+
+void InstanceBatch::draw() {
+  if (commands.empty() || instances.empty()) {
+    return;
+  }
+  model.materialArrays.bind();
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void *)0,
+                              commands.size(), 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  glBindVertexArray(0);
+  // the triangles drawn are only known on the GPU
+  renderStats.drawCalls++;
+  renderStats.stateChanges += 2;
+}
+
+void InstanceBatch::readVisible(vector<unsigned int> &visible) {
+  visible.clear();
+  if (commands.empty()) {
+    return;
+  }
+  vector<DrawCommand> culled(commands.size());
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+  glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0,
+                     culled.size() * sizeof(DrawCommand), &culled[0]);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  vector<GLuint> slots(commands.size() * maxInstances);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleInstanceBuffer);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                     slots.size() * sizeof(GLuint), &slots[0]);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  for (unsigned int mesh = 0; mesh < culled.size(); mesh++) {
+    // in the order the invocations got to them
+    vector<GLuint>::iterator first = slots.begin() + mesh * maxInstances;
+    vector<GLuint>::iterator last = first + culled[mesh].instanceCount;
+    std::sort(first, last);
+    for (; first != last; ++first) {
+      visible.push_back(mesh * instances.size() + *first);
+    }
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "model.h"
+
+// Define shaders drawing an InstanceBatch must be compiled with, taking the
+// model matrix from a per-instance attribute instead of the uniform
+const char *const INSTANCE_TRANSFORMS_DEFINE = "#define INSTANCE_TRANSFORMS\n";
+// the first of the four vertex attributes holding that matrix
+const unsigned int INSTANCE_TRANSFORM_ATTRIBUTE = 8;
+// local size of shaders/cull-instances.comp
+const unsigned int CULLING_GROUP_SIZE = 64;
+
+// Many instances of a model drawn without a per-object decision on the CPU.
+// The static meshes sampling the model's texture arrays are merged into one
+// vertex and index buffer. A compute shader culls every mesh of every
+// instance against the frustum and writes one indirect draw command per
+// mesh, with the visible instances' transforms as instanced attributes, so
+// a single glMultiDrawElementsIndirect draws them all.
+//
+// Needs OpenGL 4.3, see supported(). Drawing each instance with Model::Draw
+// is the fallback, cullInstances makes the same decisions on the CPU.
+class InstanceBatch {
+public:
+  // bounds of each batched mesh and the transform placing it in the model,
+  // in the order of their draw commands
+  vector<AABB> meshBounds;
+  vector<glm::mat4> meshTransforms;
+  // the placed instances, see setInstances
+  vector<glm::mat4> instances;
+  // meshes of the model that can't be batched: skinned ones and those
+  // binding their own textures
+  unsigned int skippedMeshes;
+
+  // whether the context has compute shaders and indirect draws
+  static bool supported();
+
+  // model must outlive the batch
+  InstanceBatch(Model &model, unsigned int maxInstances);
+  ~InstanceBatch();
+
+  unsigned int capacity() const { return maxInstances; }
+
+  // Places the instances, at most capacity() of them. Uploaded right away,
+  // call again only when they move.
+  void setInstances(const vector<glm::mat4> &transforms);
+
+  // culls the instances against frustum on the GPU, for the following draws
+  void cull(const Frustum &frustum);
+
+  // Draws the instances left by the last cull() with the shader in use,
+  // which must be compiled with INSTANCE_TRANSFORMS_DEFINE and
+  // MATERIAL_ARRAYS_DEFINE.
+  void draw();
+
+  // Reads back what the last cull() found visible, as cullInstances reports
+  // it. Waits for the GPU, for checking the two against each other.
+  void readVisible(vector<unsigned int> &visible);
+
+private:
+  // glMultiDrawElementsIndirect's command layout
+  struct DrawCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+  };
+  // a mesh as the culling shader reads it
+  struct BatchedMesh {
+    glm::mat4 transform;
+    glm::vec4 boundsMin;
+    glm::vec4 boundsMax;
+  };
+
+  Model &model;
+  unsigned int maxInstances;
+  // the commands with no instances, reset before each cull
+  vector<DrawCommand> commands;
+  size_t geometryBytes;
+
+  Shader cullShader;
+  unsigned int VAO, VBO, layersVBO, EBO;
+  unsigned int instanceBuffer, meshBuffer, commandBuffer;
+  unsigned int visibleTransformBuffer, visibleInstanceBuffer;
+
+  InstanceBatch(const InstanceBatch &);
+  InstanceBatch &operator=(const InstanceBatch &);
+};
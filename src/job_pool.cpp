@@ -0,0 +1,138 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "job_pool.h"
+
+JobPool::JobPool(unsigned int threads) : pending(0), stopping(false) {
+  if (threads == NO_WORKER_THREADS) {
+    threads = 0;
+  } else if (threads == 0) {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    threads = hardware > 1 ? hardware - 1 : 1;
+  }
+  for (unsigned int i = 0; i < threads; i++) {
+    workers.push_back(std::thread(&JobPool::workerLoop, this));
+  }
+}
+
+JobPool::~JobPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  taskAvailable.notify_all();
+  for (unsigned int i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+}
+
+void JobPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push_back(std::move(task));
+    pending++;
+  }
+  taskAvailable.notify_one();
+}
+
+void JobPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  tasksDone.wait(lock, [this]() { return pending == 0; });
+}
+
+// Shared between the caller of parallelFor and the workers helping it, which
+// may still hold a reference after the caller returned
+struct ParallelForState {
+  std::function<void(size_t, size_t)> fn;
+  size_t count;
+  size_t grain;
+  std::atomic<size_t> next;
+  std::atomic<size_t> finished;
+  std::mutex mutex;
+  std::condition_variable done;
+
+  // runs ranges until none are left, returns true if it ran the last one
+  bool run() {
+    bool last = false;
+    for (;;) {
+      size_t begin = next.fetch_add(grain);
+      if (begin >= count) {
+        return last;
+      }
+      size_t end = std::min(begin + grain, count);
+      fn(begin, end);
+      last = finished.fetch_add(end - begin) + (end - begin) == count;
+    }
+  }
+};
+
+void JobPool::parallelFor(size_t count, size_t grain,
+                          const std::function<void(size_t, size_t)> &fn) {
+  if (count == 0) {
+    return;
+  }
+  grain = std::max<size_t>(grain, 1);
+  size_t ranges = (count + grain - 1) / grain;
+  if (ranges == 1 || workers.empty()) {
+    for (size_t begin = 0; begin < count; begin += grain) {
+      fn(begin, std::min(begin + grain, count));
+    }
+    return;
+  }
+
+  std::shared_ptr<ParallelForState> state =
+      std::make_shared<ParallelForState>();
+  state->fn = fn;
+  state->count = count;
+  state->grain = grain;
+  state->next = 0;
+  state->finished = 0;
+
+  // one helper per range beyond the caller's, capped by the worker count
+  size_t helpers = std::min<size_t>(ranges - 1, workers.size());
+  for (size_t i = 0; i < helpers; i++) {
+    submit([state]() {
+      if (state->run()) {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->done.notify_all();
+      }
+    });
+  }
+  state->run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->done.wait(lock, [&state]() { return state->finished == state->count; });
+}
+
+void JobPool::workerLoop() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      taskAvailable.wait(lock, [this]() { return stopping || !tasks.empty(); });
+      if (stopping && tasks.empty()) {
+        return;
+      }
+      task = std::move(tasks.front());
+      tasks.pop_front();
+    }
+    task();
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      pending--;
+      if (pending == 0) {
+        tasksDone.notify_all();
+      }
+    }
+  }
+}
+
+JobPool &sharedJobPool() {
+  static JobPool pool;
+  return pool;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Thread count of a pool without workers: its parallelFor runs every range on
+// the calling thread, which lets benchmarks time parallel work serially
+const unsigned int NO_WORKER_THREADS = ~0u;
+
+// A fixed set of worker threads executing queued tasks. Used for CPU heavy
+// work that can be split up, such as skinning and asset import. Nothing
+// submitted here may call into OpenGL: the context is only current on the
+// render thread.
+class JobPool {
+public:
+  // threads == 0 uses one worker per hardware thread, minus the caller's,
+  // NO_WORKER_THREADS none at all
+  explicit JobPool(unsigned int threads = 0);
+  ~JobPool();
+
+  // Queues task to be run by a worker
+  void submit(std::function<void()> task);
+
+  // Blocks until every submitted task has finished
+  void wait();
+
+  // Calls fn(begin, end) for consecutive ranges of at most grain items that
+  // together cover [0, count), and returns once all of them have run. The
+  // calling thread works through ranges too.
+  void parallelFor(size_t count, size_t grain,
+                   const std::function<void(size_t, size_t)> &fn);
+
+  unsigned int size() const { return workers.size(); }
+
+private:
+  std::vector<std::thread> workers;
+  std::deque<std::function<void()> > tasks;
+  std::mutex mutex;
+  std::condition_variable taskAvailable;
+  std::condition_variable tasksDone;
+  unsigned int pending;
+  bool stopping;
+
+  void workerLoop();
+
+  JobPool(const JobPool &);
+  JobPool &operator=(const JobPool &);
+};
+
+// Pool shared by the engine subsystems, created on first use
+JobPool &sharedJobPool();
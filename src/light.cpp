@@ -0,0 +1,124 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "frame_arena.h"
+#include "light.h"
+#include "shader.h"
+
+// intensity below which a light is considered to no longer contribute
+const float LIGHT_CUTOFF = 5.0f / 256.0f;
+
+float pointLightRadius(const PointLight &light) {
+  glm::vec3 diffuse = light.base.diffuse;
+  float maxChannel = std::max(std::max(diffuse.x, diffuse.y), diffuse.z);
+  // solve constant + linear * d + quadratic * d^2 = maxChannel / cutoff
+  float c = light.constant - maxChannel / LIGHT_CUTOFF;
+  if (light.quadratic <= 0.0f) {
+    return light.linear > 0.0f ? -c / light.linear : 1000.0f;
+  }
+  float discriminant = light.linear * light.linear - 4.0f * light.quadratic * c;
+  return (-light.linear + std::sqrt(discriminant)) / (2.0f * light.quadratic);
+}
+
+std::vector<PointLight> generatePointLights(unsigned int count,
+                                            glm::vec3 center, float extent) {
+  std::vector<PointLight> lights;
+  lights.reserve(count);
+  // simple LCG so that every run (and every mode) sees the same lights
+  unsigned int state = 1234567u;
+  auto next = [&state]() {
+    state = state * 1664525u + 1013904223u;
+    return (state >> 8) / float(1 << 24);
+  };
+  for (unsigned int i = 0; i < count; i++) {
+    PointLight light;
+    glm::vec3 colour(0.2f + 0.8f * next(), 0.2f + 0.8f * next(),
+                     0.2f + 0.8f * next());
+    light.base.ambient = colour * 0.05f;
+    light.base.diffuse = colour;
+    light.base.specular = glm::vec3(1.0f);
+    light.position = center + glm::vec3((next() * 2.0f - 1.0f) * extent,
+                                        (next() * 2.0f - 1.0f) * extent * 0.5f,
+                                        (next() * 2.0f - 1.0f) * extent);
+    light.constant = 1.0f;
+    light.linear = 0.7f;
+    light.quadratic = 1.8f;
+    lights.push_back(light);
+  }
+  return lights;
+}
+
+static void setBaseLight(const Shader &shader, const char *name,
+                         const BaseLight &light) {
+  // the names are too long for the small string buffer, the frame arena
+  // keeps them off the heap
+  FrameString prefix(name);
+  shader.setVec3((prefix + ".ambient").c_str(), light.ambient);
+  shader.setVec3((prefix + ".diffuse").c_str(), light.diffuse);
+  shader.setVec3((prefix + ".specular").c_str(), light.specular);
+}
+
+void setGlobalLights(const Shader &shader, const DirectionLight &direction,
+                     const SpotLight &spot) {
+  setBaseLight(shader, "directionLights[0].base", direction.base);
+  shader.setVec3("directionLights[0].direction", direction.direction);
+
+  setBaseLight(shader, "spotLights[0].point.base", spot.point.base);
+  shader.setVec3("spotLights[0].point.position", spot.point.position);
+  shader.setFloat("spotLights[0].point.constant", spot.point.constant);
+  shader.setFloat("spotLights[0].point.linear", spot.point.linear);
+  shader.setFloat("spotLights[0].point.quadratic", spot.point.quadratic);
+  shader.setVec3("spotLights[0].direction", spot.direction);
+  shader.setFloat("spotLights[0].cutOff", spot.cutOff);
+  shader.setFloat("spotLights[0].outerCutOff", spot.outerCutOff);
+}
+
+LightBuffer::LightBuffer() : count(0) {
+  glGenBuffers(1, &buffer);
+  glGenTextures(1, &texture);
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  glBufferData(GL_TEXTURE_BUFFER, 0, NULL, GL_DYNAMIC_DRAW);
+  glBindTexture(GL_TEXTURE_BUFFER, texture);
+  glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+LightBuffer::~LightBuffer() {
+  glDeleteTextures(1, &texture);
+  glDeleteBuffers(1, &buffer);
+}
+
+void LightBuffer::upload(const std::vector<PointLight> &lights) {
+  FrameVector<float> data;
+  data.reserve(lights.size() * POINT_LIGHT_TEXELS * 4);
+  for (unsigned int i = 0; i < lights.size(); i++) {
+    const PointLight &light = lights[i];
+    const float texels[POINT_LIGHT_TEXELS * 4] = {
+        light.position.x,       light.position.y,       //
+        light.position.z,       light.constant,         //
+        light.base.ambient.x,   light.base.ambient.y,   //
+        light.base.ambient.z,   light.linear,           //
+        light.base.diffuse.x,   light.base.diffuse.y,   //
+        light.base.diffuse.z,   light.quadratic,        //
+        light.base.specular.x,  light.base.specular.y,  //
+        light.base.specular.z,  pointLightRadius(light) //
+    };
+    data.insert(data.end(), texels, texels + POINT_LIGHT_TEXELS * 4);
+  }
+  count = lights.size();
+
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+  glBufferData(GL_TEXTURE_BUFFER, data.size() * sizeof(float),
+               data.empty() ? NULL : &data[0], GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightBuffer::bind(unsigned int unit) {
+  glActiveTexture(GL_TEXTURE0 + unit);
+  glBindTexture(GL_TEXTURE_BUFFER, texture);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+// Light definitions mirroring the structs declared in shaders/colors.frag
+struct BaseLight {
+  glm::vec3 ambient;
+  glm::vec3 diffuse;
+  glm::vec3 specular;
+};
+
+struct DirectionLight {
+  BaseLight base;
+  glm::vec3 direction;
+};
+
+struct PointLight {
+  BaseLight base;
+  glm::vec3 position;
+  float constant;
+  float linear;
+  float quadratic;
+};
+
+struct SpotLight {
+  PointLight point;
+  glm::vec3 direction;
+  float cutOff;
+  float outerCutOff;
+};
+
+// Number of RGBA32F texels used to store a single point light in a
+// LightBuffer. Shaders fetch light i from texels [i * 4, i * 4 + 3]:
+//   0: position.xyz, constant
+//   1: ambient.rgb,  linear
+//   2: diffuse.rgb,  quadratic
+//   3: specular.rgb, radius
+const unsigned int POINT_LIGHT_TEXELS = 4;
+
+// Returns the distance at which a point light's contribution drops below
+// what an 8-bit framebuffer can display. Used to size light volumes.
+float pointLightRadius(const PointLight &light);
+
+// Generates a deterministic set of coloured point lights scattered around
+// the given centre, used to stress the forward and deferred paths.
+std::vector<PointLight> generatePointLights(unsigned int count,
+                                            glm::vec3 center, float extent);
+
+// Sets the directionLights[0] and spotLights[0] uniforms expected by the
+// lighting shaders.
+void setGlobalLights(const Shader &shader, const DirectionLight &direction,
+                     const SpotLight &spot);
+
+// Point lights stored in a texture buffer so that shaders can loop over (or
+// instance across) an arbitrary number of them without hitting uniform limits
+class LightBuffer {
+public:
+  unsigned int texture;
+  unsigned int count;
+
+  LightBuffer();
+  ~LightBuffer();
+
+  void upload(const std::vector<PointLight> &lights);
+
+  // binds the buffer texture to the given texture unit
+  void bind(unsigned int unit);
+
+private:
+  unsigned int buffer;
+
+  LightBuffer(const LightBuffer &);
+  LightBuffer &operator=(const LightBuffer &);
+};
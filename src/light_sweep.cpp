@@ -0,0 +1,62 @@
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "deferred.h"
+#include "light_sweep.h"
+
+LightSweep::LightSweep()
+    : lightCounts({1, 4, 16, 64, 256, 1024}), step(lightCounts.size() * 2),
+      frame(0), gpuTotal(0.0), cpuTotal(0.0), savedMode(RENDER_FORWARD),
+      savedLightCount(0) {}
+
+void LightSweep::start(RenderMode mode, unsigned int lightCount) {
+  savedMode = mode;
+  savedLightCount = lightCount;
+  step = 0;
+  frame = 0;
+  gpuTotal = 0.0;
+  cpuTotal = 0.0;
+  gpuResults.assign(lightCounts.size() * 2, 0.0f);
+  cpuResults.assign(lightCounts.size() * 2, 0.0f);
+  std::cout << "Running light sweep..." << std::endl;
+}
+
+void LightSweep::record(float gpuMilliseconds, float cpuMilliseconds,
+                        RenderMode &mode, unsigned int &lightCount) {
+  if (!running()) {
+    return;
+  }
+  if (frame >= LIGHT_SWEEP_WARMUP_FRAMES) {
+    gpuTotal += gpuMilliseconds;
+    cpuTotal += cpuMilliseconds;
+  }
+  frame++;
+  if (frame == LIGHT_SWEEP_WARMUP_FRAMES + LIGHT_SWEEP_MEASURED_FRAMES) {
+    gpuResults[step] = gpuTotal / LIGHT_SWEEP_MEASURED_FRAMES;
+    cpuResults[step] = cpuTotal / LIGHT_SWEEP_MEASURED_FRAMES;
+    step++;
+    frame = 0;
+    gpuTotal = 0.0;
+    cpuTotal = 0.0;
+    if (!running()) {
+      report();
+      mode = savedMode;
+      lightCount = savedLightCount;
+      return;
+    }
+  }
+  mode = step % 2 == 0 ? RENDER_FORWARD_LIT : RENDER_DEFERRED;
+  lightCount = lightCounts[step / 2];
+}
+
+void LightSweep::report() const {
+  std::printf("%8s | %13s %13s | %13s %13s\n", "lights", "forward gpu",
+              "deferred gpu", "forward frame", "deferred frame");
+  for (unsigned int i = 0; i < lightCounts.size(); i++) {
+    std::printf("%8u | %10.3f ms %10.3f ms | %10.3f ms %10.3f ms\n",
+                lightCounts[i], gpuResults[i * 2], gpuResults[i * 2 + 1],
+                cpuResults[i * 2], cpuResults[i * 2 + 1]);
+  }
+  std::fflush(stdout);
+}
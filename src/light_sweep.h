@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+
+#include "deferred.h"
+
+// Frames rendered after switching configuration before measuring, so that
+// the GPU timer results of the previous configuration have drained
+const unsigned int LIGHT_SWEEP_WARMUP_FRAMES = 30;
+const unsigned int LIGHT_SWEEP_MEASURED_FRAMES = 120;
+
+// Renders the scene at increasing point light counts with lit forward and
+// deferred shading and prints a side-by-side table of the average frame times
+// once done.
+class LightSweep {
+public:
+  LightSweep();
+
+  // Starts the sweep from the viewer's current mode and lightCount. Those are
+  // driven by the sweep until it finishes, then they are restored.
+  void start(RenderMode mode, unsigned int lightCount);
+
+  bool running() const { return step < lightCounts.size() * 2; }
+
+  // Records the timings of the frame that was just rendered and updates mode
+  // and lightCount to the configuration the next frame should use, or back
+  // to the ones the sweep started from once it is done.
+  void record(float gpuMilliseconds, float cpuMilliseconds, RenderMode &mode,
+              unsigned int &lightCount);
+
+private:
+  std::vector<unsigned int> lightCounts;
+  // average GPU and CPU frame times indexed by step
+  std::vector<float> gpuResults;
+  std::vector<float> cpuResults;
+  // even steps are lit forward shading, odd ones deferred
+  unsigned int step;
+  unsigned int frame;
+  double gpuTotal;
+  double cpuTotal;
+  // the viewer's configuration before the sweep
+  RenderMode savedMode;
+  unsigned int savedLightCount;
+
+  void report() const;
+};
@@ -1,5 +1,12 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include <glad/glad.h>
 // prevent clang-format reordering
@@ -7,9 +14,29 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "animation.h"
 #include "camera.h"
+#include "culling.h"
+#include "deferred.h"
+#include "dynamic_resolution.h"
+#include "entities.h"
+#include "frame_arena.h"
+#include "frame_pacing.h"
+#include "gl_trace.h"
+#include "gpu_timer.h"
+#include "instance_batch.h"
+#include "light.h"
+#include "light_sweep.h"
+#include "material_arrays.h"
 #include "model.h"
+#include "particle_renderer.h"
+#include "particles.h"
+#include "reflection_probe.h"
 #include "shader.h"
+#include "skinning.h"
+#include "streaming.h"
+#include "telemetry.h"
+#include "texture_streaming.h"
 
 const unsigned int DEFAULT_WIDTH = 800;
 const unsigned int DEFAULT_HEIGHT = 600;
@@ -20,36 +47,185 @@ float lastY = DEFAULT_HEIGHT / 2.0;
 bool firstMouse = true;
 
 float deltaTime = 0.0f;
-float lastFrame = 0.0f;
+double lastFrame = 0.0;
+
+int framebufferWidth = DEFAULT_WIDTH;
+int framebufferHeight = DEFAULT_HEIGHT;
+
+RenderMode renderMode = RENDER_FORWARD;
+unsigned int numPointLights = 32;
+const unsigned int MAX_POINT_LIGHTS = 4096;
+// texture unit of the point light buffer in the forward path, above the units
+// Mesh::Draw binds material textures to
+const unsigned int FORWARD_LIGHT_DATA_UNIT = 15;
+LightSweep lightSweep;
+
+SkinningMode skinningMode = SKINNING_GPU;
+
+// frames the CPU may run ahead of the GPU, 0 for no limit
+unsigned int frameLatencyLimit = 2;
+bool measureLatency = false;
+
+bool dynamicResolutionEnabled = true;
+float gpuBudgetMilliseconds = DEFAULT_GPU_BUDGET_MS;
+
+// a field of nanosuits behind the scene, far more than fit the streaming
+// budgets at once
+const int STREAMED_FIELD_SIZE = 8;
+const float STREAMED_FIELD_SPACING = 6.0f;
+// a crowd of nanosuits behind the camera, culled and drawn by the GPU where
+// the context allows it
+const int CROWD_SIZE = 16;
+const float CROWD_SPACING = 1.5f;
+bool gpuCulling = true;
+// checks the GPU's culling against the CPU's once
+bool compareCulling = false;
+// a fountain of particles beside the scene, about a million of them once it
+// is running
+const unsigned int MAX_PARTICLES = 1u << 20;
+const float PARTICLE_SIZE = 0.05f;
+const glm::vec3 PARTICLE_GRAVITY = glm::vec3(0.0f, -2.5f, 0.0f);
+bool particlesEnabled = true;
+
+// what Renderable::mesh refers to
+enum SceneMesh { MESH_NANOSUIT, MESH_GLASS_CUBE };
+// how an entity is shaded, Renderable::material
+enum SceneMaterial {
+  // the lighting of the current render mode
+  MATERIAL_LIT,
+  // lit, and drawn with the crowd's InstanceBatch where it is supported
+  MATERIAL_CROWD,
+  // reflecting the reflection probe's surroundings
+  MATERIAL_REFLECTIVE
+};
+
+// bounds of all of model's meshes in the model's space
+AABB modelBounds(Model &model) {
+  AABB bounds = computeBounds(NULL, 0);
+  for (unsigned int i = 0; i < model.meshes.size(); i++) {
+    AABB mesh = transformBounds(model.meshes[i].bounds,
+                                model.nodes.getWorld(model.meshNodes[i]));
+    if (i == 0) {
+      bounds = mesh;
+    } else {
+      bounds.min = glm::min(bounds.min, mesh.min);
+      bounds.max = glm::max(bounds.max, mesh.max);
+    }
+  }
+  return bounds;
+}
+
+// adds an entity drawing mesh with material at transform
+Entity addRenderable(EntityStore &entities, unsigned int mesh,
+                     unsigned int material, const AABB &bounds,
+                     const glm::mat4 &transform) {
+  Entity entity =
+      entities.create(componentMask<Transform>() |
+                      componentMask<Renderable>() | componentMask<Bounds>());
+  entities.get<Transform>(entity)->world = transform;
+  Renderable *renderable = entities.get<Renderable>(entity);
+  renderable->mesh = mesh;
+  renderable->material = material;
+  entities.get<Bounds>(entity)->local = bounds;
+  return entity;
+}
 
-void processInput(GLFWwindow *window) {
+// runs once per simulation step, movement is scaled by the step length
+void processInput(GLFWwindow *window, float stepTime) {
   if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
     glfwSetWindowShouldClose(window, true);
   }
 
   if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-    camera.processKeyboard(FORWARD, deltaTime);
+    camera.processKeyboard(FORWARD, stepTime);
   }
   if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-    camera.processKeyboard(BACKWARD, deltaTime);
+    camera.processKeyboard(BACKWARD, stepTime);
   }
   if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-    camera.processKeyboard(LEFT, deltaTime);
+    camera.processKeyboard(LEFT, stepTime);
   }
   if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-    camera.processKeyboard(RIGHT, deltaTime);
+    camera.processKeyboard(RIGHT, stepTime);
   }
   if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS) {
-    camera.processKeyboard(UP, deltaTime);
+    camera.processKeyboard(UP, stepTime);
   }
   if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS) {
-    camera.processKeyboard(DOWN, deltaTime);
+    camera.processKeyboard(DOWN, stepTime);
+  }
+}
+
+void keyCallback(__attribute__((unused)) GLFWwindow *window, int key,
+                 __attribute__((unused)) int scancode, int action,
+                 __attribute__((unused)) int mods) {
+  if (action != GLFW_PRESS || lightSweep.running()) {
+    return;
+  }
+  if (key == GLFW_KEY_F1) {
+    const char *names[] = {"Forward", "Lit forward", "Deferred"};
+    renderMode = (RenderMode)((renderMode + 1) % (RENDER_DEFERRED + 1));
+    std::cout << names[renderMode] << " shading" << std::endl;
+  }
+  if (key == GLFW_KEY_F2) {
+    lightSweep.start(renderMode, numPointLights);
+  }
+  if (key == GLFW_KEY_F3) {
+    skinningMode = skinningMode == SKINNING_GPU ? SKINNING_CPU : SKINNING_GPU;
+    std::cout << (skinningMode == SKINNING_GPU ? "GPU" : "CPU") << " skinning"
+              << std::endl;
+  }
+  if (key == GLFW_KEY_F4) {
+    frameLatencyLimit = (frameLatencyLimit + 1) % (MAX_FRAME_LATENCY + 1);
+    if (frameLatencyLimit == 0) {
+      std::cout << "Frame latency limit off" << std::endl;
+    } else {
+      std::cout << "Frame latency limit " << frameLatencyLimit << std::endl;
+    }
+  }
+  if (key == GLFW_KEY_F5) {
+    measureLatency = true;
+  }
+  if (key == GLFW_KEY_F6) {
+    dynamicResolutionEnabled = !dynamicResolutionEnabled;
+    std::cout << "Dynamic resolution "
+              << (dynamicResolutionEnabled ? "on" : "off") << std::endl;
+  }
+  if (key == GLFW_KEY_F7) {
+    gpuCulling = !gpuCulling;
+    std::cout << (gpuCulling ? "GPU" : "CPU") << " culling" << std::endl;
+  }
+  if (key == GLFW_KEY_F8) {
+    compareCulling = true;
+  }
+  if (key == GLFW_KEY_F9) {
+    particlesEnabled = !particlesEnabled;
+    std::cout << "Particles " << (particlesEnabled ? "on" : "off")
+              << std::endl;
+  }
+  if (key == GLFW_KEY_RIGHT_BRACKET) {
+    gpuBudgetMilliseconds += 1.0f;
+    std::cout << "GPU budget " << gpuBudgetMilliseconds << " ms" << std::endl;
+  }
+  if (key == GLFW_KEY_LEFT_BRACKET && gpuBudgetMilliseconds > 1.0f) {
+    gpuBudgetMilliseconds -= 1.0f;
+    std::cout << "GPU budget " << gpuBudgetMilliseconds << " ms" << std::endl;
+  }
+  if (key == GLFW_KEY_EQUAL && numPointLights < MAX_POINT_LIGHTS) {
+    numPointLights = numPointLights == 0 ? 1 : numPointLights * 2;
+    std::cout << numPointLights << " point lights" << std::endl;
+  }
+  if (key == GLFW_KEY_MINUS && numPointLights > 0) {
+    numPointLights /= 2;
+    std::cout << numPointLights << " point lights" << std::endl;
   }
 }
 
 void framebufferSizeCallback(__attribute__((unused)) GLFWwindow *window,
                              int width, int height) {
   glViewport(0, 0, width, height);
+  framebufferWidth = width;
+  framebufferHeight = height;
 }
 
 void mouseCallback(__attribute__((unused)) GLFWwindow *window, double xpos,
@@ -74,38 +250,18 @@ void scrollCallback(__attribute__((unused)) GLFWwindow *window,
   camera.processMouseScroll(yoffset);
 }
 
-int main() {
-  glfwInit();
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-#ifdef __APPLE__
-  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
-
-  GLFWwindow *window = glfwCreateWindow(DEFAULT_WIDTH, DEFAULT_HEIGHT,
-                                        "LearnOpenGL", NULL, NULL);
-  if (window == NULL) {
-    std::cout << "Failed to create GLFW window" << std::endl;
-    glfwTerminate();
-    return -1;
-  }
-  glfwMakeContextCurrent(window);
-  glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
-  glfwSetCursorPosCallback(window, mouseCallback);
-  glfwSetScrollCallback(window, scrollCallback);
-
-  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-
-  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-    std::cout << "Failed to initialize GLAD" << std::endl;
-    return -1;
-  }
-
+// Sets up the scene and renders it until the window is closed. Every GL
+// object is owned by a local here, so all are released on return while the
+// context is still current.
+void renderScene(GLFWwindow *window) {
   glEnable(GL_DEPTH_TEST);
 
   Shader shader("shaders/reflect.vert", "shaders/reflect.frag");
   Shader skyboxShader("shaders/skybox.vert", "shaders/skybox.frag");
+  Shader lightingShader("shaders/colors.vert", "shaders/colors.frag",
+                        MATERIAL_ARRAYS_DEFINE);
+  Shader proxyShader("shaders/lamp.vert", "shaders/lamp.frag");
+  Shader particleShader("shaders/particle.vert", "shaders/transparent.frag");
 
   float cubeVertices[] = {
       // positions          // normals
@@ -226,7 +382,8 @@ int main() {
       "resources/textures/skybox/front.jpg",
       "resources/textures/skybox/back.jpg",
   };
-  unsigned int cubemapTexture = loadCubemap(faces);
+  size_t cubemapBytes = 0;
+  unsigned int cubemapTexture = loadCubemap(faces, &cubemapBytes);
 
   shader.use();
   shader.setInt("skybox", 0);
@@ -234,23 +391,386 @@ int main() {
   skyboxShader.use();
   skyboxShader.setInt("skybox", 0);
 
-  Model nanosuit("resources/objects/nanosuit/nanosuit.obj");
+  size_t particleTextureBytes = 0;
+  unsigned int particleTexture =
+      loadTexture("resources/textures/grass.png", &particleTextureBytes);
+  particleShader.use();
+  particleShader.setInt("texture1", 0);
+  particleShader.setFloat("particleSize", PARTICLE_SIZE);
+
+  // packed into texture arrays, as the lit and deferred shaders sample them
+  Model nanosuit("resources/objects/nanosuit/nanosuit.obj", false, true);
+
+  // the objects in the scene
+  EntityStore entities;
+  AABB nanosuitBounds = modelBounds(nanosuit);
+  AABB cubeBounds;
+  cubeBounds.min = glm::vec3(-0.5f);
+  cubeBounds.max = glm::vec3(0.5f);
+  glm::mat4 transform = glm::mat4(1.0f);
+  // translate it down so it's at the center of the scene
+  transform = glm::translate(transform, glm::vec3(1.0f, -1.75f, 0.0f));
+  // it's a bit too big for our scene, so scale it down
+  transform = glm::scale(transform, glm::vec3(0.2f, 0.2f, 0.2f));
+  Entity hero = addRenderable(entities, MESH_NANOSUIT, MATERIAL_LIT,
+                              nanosuitBounds, transform);
+  transform = glm::translate(glm::mat4(1.0f), glm::vec3(-1.0f, 0.0f, 0.0f));
+  Entity glassCube = addRenderable(entities, MESH_GLASS_CUBE,
+                                   MATERIAL_REFLECTIVE, cubeBounds, transform);
+
+  StreamingManager streaming;
+  streaming.textureArrays = true;
+  for (int x = 0; x < STREAMED_FIELD_SIZE; x++) {
+    for (int z = 0; z < STREAMED_FIELD_SIZE; z++) {
+      transform = glm::translate(
+          glm::mat4(1.0f),
+          glm::vec3((x - STREAMED_FIELD_SIZE / 2) * STREAMED_FIELD_SPACING,
+                    -1.75f, -10.0f - z * STREAMED_FIELD_SPACING));
+      transform = glm::scale(transform, glm::vec3(0.2f, 0.2f, 0.2f));
+      // the same file as the scene's nanosuit, so it has the same bounds
+      streaming.add("resources/objects/nanosuit/nanosuit.obj", transform,
+                    nanosuitBounds);
+    }
+  }
+  // draws the streamed models in view, collecting boxes to stand in for
+  // those that aren't loaded. They ask for the texture levels they need as
+  // seen from eye.
+  std::vector<glm::mat4> streamedProxies;
+  auto drawStreamed = [&](Shader &modelShader, const Frustum &frustum,
+                          const glm::vec3 &eye, float pixelScale) {
+    for (unsigned int i = 0; i < streaming.size(); i++) {
+      const glm::vec3 &center = streaming.center(i);
+      AABB bounds;
+      bounds.min = center - glm::vec3(streaming.radius(i));
+      bounds.max = center + glm::vec3(streaming.radius(i));
+      if (!isVisible(frustum, bounds)) {
+        continue;
+      }
+      Model *model = streaming.use(i);
+      if (model) {
+        model->Draw(modelShader, streaming.transform(i), &frustum);
+        textureStreamer().request(*model, streaming.transform(i), eye,
+                                  pixelScale, &frustum);
+      } else {
+        // the unit cube grown around the bounding sphere
+        streamedProxies.push_back(
+            glm::scale(glm::translate(glm::mat4(1.0f), center),
+                       glm::vec3(2.0f * streaming.radius(i))));
+      }
+    }
+  };
+
+  for (int x = 0; x < CROWD_SIZE; x++) {
+    for (int z = 0; z < CROWD_SIZE; z++) {
+      transform = glm::translate(
+          glm::mat4(1.0f), glm::vec3((x - CROWD_SIZE / 2) * CROWD_SPACING,
+                                     -1.75f, 6.0f + z * CROWD_SPACING));
+      // facing the scene
+      transform = glm::rotate(transform, glm::radians(180.0f),
+                              glm::vec3(0.0f, 1.0f, 0.0f));
+      addRenderable(entities, MESH_NANOSUIT, MATERIAL_CROWD, nanosuitBounds,
+                    glm::scale(transform, glm::vec3(0.2f, 0.2f, 0.2f)));
+    }
+  }
+  const ComponentMask drawnComponents = componentMask<Transform>() |
+                                        componentMask<Renderable>() |
+                                        componentMask<Bounds>();
+  // the chunks of drawn entities, valid until entities are added or removed
+  std::vector<ChunkView> drawnChunks;
+  entities.chunks(drawnComponents, drawnChunks);
+  std::vector<glm::mat4> crowd;
+  for (unsigned int i = 0; i < drawnChunks.size(); i++) {
+    const Transform *transforms = drawnChunks[i].get<Transform>();
+    const Renderable *renderables = drawnChunks[i].get<Renderable>();
+    for (unsigned int j = 0; j < drawnChunks[i].size(); j++) {
+      if (renderables[j].material == MATERIAL_CROWD) {
+        crowd.push_back(transforms[j].world);
+      }
+    }
+  }
+  std::unique_ptr<InstanceBatch> crowdBatch;
+  if (InstanceBatch::supported() && nanosuit.textureArrays) {
+    crowdBatch.reset(new InstanceBatch(nanosuit, crowd.size()));
+    crowdBatch->setInstances(crowd);
+  } else {
+    std::cout << "GPU culling needs OpenGL 4.3, the crowd is culled on the CPU"
+              << std::endl;
+  }
+  // draws the entities with material that are inside frustum through
+  // modelShader, in the order they are stored
+  auto drawEntities = [&](Shader &modelShader, unsigned int material,
+                          const Frustum &frustum) {
+    for (unsigned int i = 0; i < drawnChunks.size(); i++) {
+      const Transform *transforms = drawnChunks[i].get<Transform>();
+      const Renderable *renderables = drawnChunks[i].get<Renderable>();
+      const Bounds *bounds = drawnChunks[i].get<Bounds>();
+      for (unsigned int j = 0; j < drawnChunks[i].size(); j++) {
+        if (renderables[j].material != material ||
+            !isVisible(frustum, bounds[j].world)) {
+          continue;
+        }
+        if (renderables[j].mesh == MESH_NANOSUIT) {
+          nanosuit.Draw(modelShader, transforms[j].world, &frustum);
+          continue;
+        }
+        modelShader.setMat4("model", transforms[j].world);
+        glBindVertexArray(cubeVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+        glBindVertexArray(0);
+        renderStats.drawCalls++;
+        renderStats.stateChanges++;
+        renderStats.triangles += 12;
+      }
+    }
+  };
+  Shader crowdLightingShader(
+      "shaders/colors.vert", "shaders/colors.frag",
+      std::string(MATERIAL_ARRAYS_DEFINE) + INSTANCE_TRANSFORMS_DEFINE);
+  // draws the crowd with one indirect multi-draw culled on the GPU, or else
+  // mesh by mesh as culled on the CPU. instancedShader is modelShader's
+  // INSTANCE_TRANSFORMS_DEFINE variant, modelShader is in use afterwards.
+  // The crowd samples the nanosuit's texture arrays, its nearest visible
+  // member asks for the levels they need seen from eye.
+  std::vector<unsigned int> gpuVisible, cpuVisible;
+  auto drawCrowd = [&](Shader &modelShader, Shader &instancedShader,
+                       const Frustum &frustum, const glm::vec3 &eye,
+                       float pixelScale) {
+    const glm::mat4 *nearest = NULL;
+    float nearestDistance = 0.0f;
+    for (unsigned int i = 0; i < drawnChunks.size(); i++) {
+      const Transform *transforms = drawnChunks[i].get<Transform>();
+      const Renderable *renderables = drawnChunks[i].get<Renderable>();
+      const Bounds *bounds = drawnChunks[i].get<Bounds>();
+      for (unsigned int j = 0; j < drawnChunks[i].size(); j++) {
+        if (renderables[j].material != MATERIAL_CROWD ||
+            !isVisible(frustum, bounds[j].world)) {
+          continue;
+        }
+        float distance = glm::length(glm::vec3(transforms[j].world[3]) - eye);
+        if (!nearest || distance < nearestDistance) {
+          nearest = &transforms[j].world;
+          nearestDistance = distance;
+        }
+      }
+    }
+    if (nearest) {
+      textureStreamer().request(nanosuit, *nearest, eye, pixelScale,
+                                &frustum);
+    }
+
+    if (!crowdBatch || !gpuCulling) {
+      drawEntities(modelShader, MATERIAL_CROWD, frustum);
+      return;
+    }
+    crowdBatch->cull(frustum);
+    instancedShader.use();
+    crowdBatch->draw();
+    modelShader.use();
+    if (compareCulling) {
+      crowdBatch->readVisible(gpuVisible);
+      cullInstances(frustum, crowdBatch->meshBounds,
+                    crowdBatch->meshTransforms, crowdBatch->instances,
+                    cpuVisible);
+      std::vector<unsigned int> differences;
+      std::set_symmetric_difference(gpuVisible.begin(), gpuVisible.end(),
+                                    cpuVisible.begin(), cpuVisible.end(),
+                                    std::back_inserter(differences));
+      std::cout << "Culling: " << gpuVisible.size() << " meshes visible on "
+                << "the GPU, " << cpuVisible.size() << " on the CPU, "
+                << differences.size() << " differ" << std::endl;
+      compareCulling = false;
+    }
+  };
+
+  DeferredRenderer deferred(framebufferWidth, framebufferHeight);
+  DynamicResolution dynamicResolution(framebufferWidth, framebufferHeight);
+  GpuTimer frameTimer;
+  // live surroundings of the glass cube, replacing the static skybox in it
+  ReflectionProbe reflectionProbe(glm::vec3(0.0f));
+  shader.use();
+  shader.setFloat("roughness", 0.1f);
+
+  MaterialArrays::attach(lightingShader);
+  lightingShader.setFloat("material.shininess", deferred.shininess);
+  lightingShader.setInt("pointLightData", FORWARD_LIGHT_DATA_UNIT);
+  MaterialArrays::attach(crowdLightingShader);
+  crowdLightingShader.setFloat("material.shininess", deferred.shininess);
+  crowdLightingShader.setInt("pointLightData", FORWARD_LIGHT_DATA_UNIT);
+
+  DirectionLight directionLight;
+  directionLight.base.ambient = glm::vec3(0.05f);
+  directionLight.base.diffuse = glm::vec3(0.4f);
+  directionLight.base.specular = glm::vec3(0.5f);
+  directionLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+  // flashlight attached to the camera
+  SpotLight spotLight;
+  spotLight.point.base.ambient = glm::vec3(0.0f);
+  spotLight.point.base.diffuse = glm::vec3(1.0f);
+  spotLight.point.base.specular = glm::vec3(1.0f);
+  spotLight.point.constant = 1.0f;
+  spotLight.point.linear = 0.09f;
+  spotLight.point.quadratic = 0.032f;
+  spotLight.cutOff = glm::cos(glm::radians(12.5f));
+  spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+  LightBuffer pointLights;
+
+  // bind pose palette stays bound for static models
+  BoneBuffer boneBuffer;
+  boneBuffer.bind();
+  BoneBuffer::attach(lightingShader);
+  BoneBuffer::attach(crowdLightingShader);
+  // only models that come with animations get an animator
+  PoseCache poseCache(nanosuit.skeleton, nanosuit.nodes, nanosuit.animations);
+  std::unique_ptr<Animator> animator;
+  if (!nanosuit.animations.empty()) {
+    animator.reset(new Animator(poseCache));
+  }
+  SkinningMode appliedSkinningMode = SKINNING_GPU;
+  std::vector<Vertex> skinnedVertices;
+
+  ParticleSystem particles(MAX_PARTICLES);
+  ParticleRenderer particleRenderer(MAX_PARTICLES);
+  ParticleEmitter fountain;
+  fountain.position = glm::vec3(-3.0f, -1.75f, -1.0f);
+  fountain.extent = glm::vec3(0.1f, 0.0f, 0.1f);
+  fountain.velocity = glm::vec3(0.0f, 4.0f, 0.0f);
+  fountain.velocitySpread = glm::vec3(1.0f, 1.0f, 1.0f);
+  fountain.minLifetime = 1.5f;
+  fountain.maxLifetime = 2.5f;
+  // replaces the particles as fast as they die, keeping the system full
+  float particleRate =
+      MAX_PARTICLES * 2.0f / (fountain.minLifetime + fountain.maxLifetime);
+  // the fraction of a particle emission fell short of last frame
+  float particleCarry = 0.0f;
+
+  // the camera moves at the simulation rate and is drawn between steps
+  FixedTimestep timestep;
+  Interpolated<glm::vec3> cameraMotion(camera.position);
+  FrameLatencyLimiter latencyLimiter;
+  LatencyProbe latencyProbe;
+  lastFrame = glfwGetTime();
 
   while (!glfwWindowShouldClose(window)) {
-    float currentFrame = glfwGetTime();
+    // transient allocations of the last frame are dropped all at once
+    resetFrameArenas();
+    if (latencyLimiter.maxFrames() != frameLatencyLimit) {
+      latencyLimiter.setMaxFrames(frameLatencyLimit);
+    }
+    // wait for the GPU before sampling input rather than after, so the
+    // input is as recent as possible when the frame is submitted
+    latencyLimiter.wait();
+    glfwPollEvents();
+    double currentFrame = glfwGetTime();
     deltaTime = currentFrame - lastFrame;
     lastFrame = currentFrame;
 
-    processInput(window);
-
+    unsigned int steps = timestep.advance(deltaTime);
+    for (unsigned int i = 0; i < steps; i++) {
+      cameraMotion.beginStep();
+      processInput(window, SIMULATION_STEP);
+      cameraMotion.current = camera.position;
+    }
+    if (measureLatency && !lightSweep.running()) {
+      latencyProbe.start(frameLatencyLimit);
+    }
+    measureLatency = false;
+
+    if (pointLights.count != numPointLights) {
+      pointLights.upload(generatePointLights(
+          numPointLights, glm::vec3(1.0f, -0.2f, 0.0f), 2.5f));
+    }
+    // the offscreen buffers match the window, the scene is rendered into a
+    // part of them sized by the dynamic resolution
+    deferred.resize(framebufferWidth, framebufferHeight);
+    dynamicResolution.resize(framebufferWidth, framebufferHeight);
+    // the light sweep compares render modes at the same resolution
+    dynamicResolution.enabled =
+        dynamicResolutionEnabled && !lightSweep.running();
+    dynamicResolution.budgetMilliseconds = gpuBudgetMilliseconds;
+    deferred.setViewport(dynamicResolution.renderWidth(),
+                         dynamicResolution.renderHeight());
+
+    if (animator) {
+      animator->update(deltaTime);
+      if (skinningMode == SKINNING_GPU) {
+        if (appliedSkinningMode == SKINNING_CPU) {
+          restoreBindPose(nanosuit);
+        }
+        boneBuffer.upload(animator->bones);
+      } else {
+        skinModel(nanosuit, animator->bones, skinnedVertices, sharedJobPool());
+      }
+      appliedSkinningMode = skinningMode;
+    }
+
+    streaming.update(camera.position);
+    // loads the texture levels asked for while drawing the last frame
+    textureStreamer().update();
+    streamedProxies.clear();
+    updateWorldBounds(entities, sharedJobPool());
+
+    // written straight into the section of the ring the GPU is done with
+    if (particlesEnabled) {
+      // as the fixed timestep does, slows down after a stall
+      float particleStep = std::min(
+          deltaTime, (float)(MAX_SIMULATION_STEPS * SIMULATION_STEP));
+      particleCarry += particleRate * particleStep;
+      unsigned int emitted = (unsigned int)particleCarry;
+      particleCarry -= emitted;
+      particles.emit(fountain, emitted);
+      float *particleInstances = particleRenderer.beginFrame();
+      particles.update(particleStep, PARTICLE_GRAVITY, sharedJobPool(),
+                       particleInstances);
+      particleRenderer.endFrame(particleInstances ? particles.size() : 0);
+    }
+
+    frameTimer.begin();
+
+    // one face of the cube's surroundings per frame. The probe sees the
+    // nanosuit and the skybox, without the point lights to keep it cheap.
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+    reflectionProbe.position =
+        glm::vec3(entities.get<Transform>(glassCube)->world[3]);
+    reflectionProbe.renderNextFace([&](const glm::mat4 &probeView,
+                                       const glm::mat4 &probeProjection) {
+      Frustum probeFrustum = extractFrustum(probeProjection * probeView);
+      lightingShader.use();
+      lightingShader.setMat4("view", probeView);
+      lightingShader.setMat4("projection", probeProjection);
+      lightingShader.setVec3("viewPos", reflectionProbe.position);
+      lightingShader.setInt("numPointLights", 0);
+      setGlobalLights(lightingShader, directionLight, spotLight);
+      drawEntities(lightingShader, MATERIAL_LIT, probeFrustum);
+
+      glDepthFunc(GL_LEQUAL);
+      skyboxShader.use();
+      skyboxShader.setMat4("view", glm::mat4(glm::mat3(probeView)));
+      skyboxShader.setMat4("projection", probeProjection);
+      glBindVertexArray(skyboxVAO);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+      glDrawArrays(GL_TRIANGLES, 0, 36);
+      glBindVertexArray(0);
+      glDepthFunc(GL_LESS);
+      renderStats.drawCalls++;
+      renderStats.stateChanges += 2;
+      renderStats.triangles += 12;
+    });
+
+    dynamicResolution.begin();
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glm::mat4 model;
-    glm::mat4 view = camera.getViewMatrix();
+    // mouse look is applied as soon as it's polled, only movement is
+    // interpolated
+    glm::vec3 cameraPosition = cameraMotion.at(timestep.alpha());
+    glm::mat4 view = camera.getViewMatrix(cameraPosition);
     glm::mat4 projection = camera.getProjectionMatrix(
-        (float)DEFAULT_WIDTH / (float)DEFAULT_HEIGHT, 0.1f, 100.0f);
-    glm::vec3 cameraPosition = camera.position;
+        (float)framebufferWidth / (float)std::max(framebufferHeight, 1), 0.1f,
+        100.0f);
+    Frustum frustum = extractFrustum(projection * view);
+    // pixels per unit of length at distance 1, for texture streaming
+    float pixelScale = dynamicResolution.renderHeight() /
+                       (2.0f * std::tan(glm::radians(camera.zoom) * 0.5f));
 
     shader.use();
     shader.setMat4("view", view);
@@ -262,27 +782,87 @@ int main() {
     skyboxShader.setMat4("view", skyboxView);
     skyboxShader.setMat4("projection", projection);
 
+    spotLight.point.position = cameraPosition;
+    spotLight.direction = camera.front;
+
     // nanosuit
-    shader.use();
-    model = glm::mat4(1.0f);
-    // translate it down so it's at the center of the scene
-    model = glm::translate(model, glm::vec3(1.0f, -1.75f, 0.0f));
-    // it's a bit too big for our scene, so scale it down
-    model = glm::scale(model, glm::vec3(0.2f, 0.2f, 0.2f));
-    shader.setMat4("model", model);
-    nanosuit.Draw(shader);
+    if (renderMode == RENDER_DEFERRED) {
+      Shader &geometryShader = deferred.beginGeometryPass(view, projection);
+      drawEntities(geometryShader, MATERIAL_LIT, frustum);
+      drawStreamed(geometryShader, frustum, cameraPosition, pixelScale);
+      drawCrowd(geometryShader, deferred.getInstancedGeometryShader(),
+                frustum, cameraPosition, pixelScale);
+      deferred.lightingPass(dynamicResolution.target.FBO, view, projection,
+                            cameraPosition, directionLight, spotLight,
+                            pointLights);
+    } else {
+      Shader *forwardShaders[] = {&crowdLightingShader, &lightingShader};
+      for (unsigned int i = 0; i < 2; i++) {
+        forwardShaders[i]->use();
+        forwardShaders[i]->setMat4("view", view);
+        forwardShaders[i]->setMat4("projection", projection);
+        forwardShaders[i]->setVec3("viewPos", cameraPosition);
+        forwardShaders[i]->setInt("numPointLights", pointLights.count);
+        setGlobalLights(*forwardShaders[i], directionLight, spotLight);
+      }
+      pointLights.bind(FORWARD_LIGHT_DATA_UNIT);
+      if (renderMode == RENDER_FORWARD) {
+        // environment mapped, as the scene's nanosuit always was
+        shader.use();
+        shader.setFloat("maxLod", 0.0f);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
+        renderStats.stateChanges++;
+        drawEntities(shader, MATERIAL_LIT, frustum);
+        lightingShader.use();
+      } else {
+        drawEntities(lightingShader, MATERIAL_LIT, frustum);
+      }
+      drawStreamed(lightingShader, frustum, cameraPosition, pixelScale);
+      drawCrowd(lightingShader, crowdLightingShader, frustum, cameraPosition,
+                pixelScale);
+    }
+    textureStreamer().request(nanosuit, entities.get<Transform>(hero)->world,
+                              cameraPosition, pixelScale, &frustum);
     glBindVertexArray(0);
 
+    // streamed models still loading
+    if (!streamedProxies.empty()) {
+      proxyShader.use();
+      proxyShader.setMat4("view", view);
+      proxyShader.setMat4("projection", projection);
+      glBindVertexArray(cubeVAO);
+      for (unsigned int i = 0; i < streamedProxies.size(); i++) {
+        proxyShader.setMat4("model", streamedProxies[i]);
+        glDrawArrays(GL_TRIANGLES, 0, 36);
+      }
+      glBindVertexArray(0);
+      renderStats.drawCalls += streamedProxies.size();
+      renderStats.stateChanges++;
+      renderStats.triangles += 12 * streamedProxies.size();
+    }
+
     // cubes
     shader.use();
-    model = glm::mat4(1.0f);
-    model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 0.0f));
-    shader.setMat4("model", model);
-    glBindVertexArray(cubeVAO);
+    shader.setFloat("maxLod",
+                    reflectionProbe.ready() ? reflectionProbe.maxLod() : 0.0f);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
-    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, reflectionProbe.ready()
+                                           ? reflectionProbe.cubemap
+                                           : cubemapTexture);
+    renderStats.stateChanges++;
+    drawEntities(shader, MATERIAL_REFLECTIVE, frustum);
+
+    // particles, alpha tested so they need no sorting
+    if (particlesEnabled) {
+      particleShader.use();
+      particleShader.setMat4("view", view);
+      particleShader.setMat4("projection", projection);
+      glActiveTexture(GL_TEXTURE0);
+      glBindTexture(GL_TEXTURE_2D, particleTexture);
+      renderStats.stateChanges += 2;
+      particleRenderer.draw();
+    }
 
     // draw skybox last
     glDepthFunc(GL_LEQUAL);
@@ -293,15 +873,83 @@ int main() {
     glDrawArrays(GL_TRIANGLES, 0, 36);
     glBindVertexArray(0);
     glDepthFunc(GL_LESS);
-
+    renderStats.drawCalls++;
+    renderStats.stateChanges += 2;
+    renderStats.triangles += 12;
+
+    dynamicResolution.present(0);
+
+    frameTimer.end();
+    if (frameTimer.hasResult()) {
+      dynamicResolution.update(frameTimer.milliseconds());
+    }
+    telemetry().endFrame(deltaTime, frameTimer.hasResult()
+                                        ? frameTimer.milliseconds() / 1000.0
+                                        : -1.0);
+    if (lightSweep.running()) {
+      lightSweep.record(frameTimer.milliseconds(), deltaTime * 1000.0f,
+                        renderMode, numPointLights);
+    }
+
+    traceGlFrame(framebufferWidth, framebufferHeight);
     glfwSwapBuffers(window);
-    glfwPollEvents();
+    latencyLimiter.frameSubmitted();
+    if (latencyProbe.running()) {
+      latencyProbe.frameSubmitted(currentFrame, deltaTime);
+    }
   }
 
   glDeleteVertexArrays(1, &cubeVAO);
   glDeleteVertexArrays(1, &skyboxVAO);
   glDeleteBuffers(1, &cubeVBO);
   glDeleteBuffers(1, &skyboxVAO);
+  deleteTexture(cubemapTexture, cubemapBytes);
+  deleteTexture(particleTexture, particleTextureBytes);
+}
+
+int main() {
+  // opt-in, started first so asset loading shows up
+  std::unique_ptr<TelemetryServer> telemetryServer;
+  if (const char *socketPath = std::getenv(TELEMETRY_SOCKET_VARIABLE)) {
+    telemetryServer.reset(new TelemetryServer(socketPath));
+  }
+
+  glfwInit();
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+  glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+  GLFWwindow *window = glfwCreateWindow(DEFAULT_WIDTH, DEFAULT_HEIGHT,
+                                        "LearnOpenGL", NULL, NULL);
+  if (window == NULL) {
+    std::cout << "Failed to create GLFW window" << std::endl;
+    glfwTerminate();
+    return -1;
+  }
+  glfwMakeContextCurrent(window);
+  glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
+  glfwSetCursorPosCallback(window, mouseCallback);
+  glfwSetScrollCallback(window, scrollCallback);
+  glfwSetKeyCallback(window, keyCallback);
+  glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+
+  glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+  if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+    std::cout << "Failed to initialize GLAD" << std::endl;
+    return -1;
+  }
+  // opt-in, before the first GL call so the trace holds every object
+  if (const char *tracePath = std::getenv(GL_TRACE_VARIABLE)) {
+    const char *frames = std::getenv(GL_TRACE_FRAMES_VARIABLE);
+    startGlTrace(tracePath, frames ? std::atoi(frames) : 0);
+  }
+
+  renderScene(window);
+  stopGlTrace();
 
   glfwTerminate();
   return 0;
@@ -0,0 +1,425 @@
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <stb_image.h>
+
+#include "job_pool.h"
+#include "material_arrays.h"
+#include "mesh.h"
+#include "shader.h"
+#include "telemetry.h"
+#include "texture_streaming.h"
+
+using namespace std;
+
+const char *const MATERIAL_TEXTURE_TYPE_NAMES[MATERIAL_TEXTURE_TYPES] = {
+    "texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+const char *const MATERIAL_ARRAY_SAMPLERS[MATERIAL_TEXTURE_TYPES] = {
+    "diffuseLayers", "specularLayers", "normalLayers", "heightLayers"};
+
+// RGBA8 pixels decoded from a file
+struct Image {
+  vector<unsigned char> pixels;
+  int width;
+  int height;
+  // whether the file has an alpha channel
+  bool alpha;
+};
+
+// averages 2x2 (or 2x1 and 1x2) blocks of texels, halving the image along
+// the axes that are flagged
+static void halve(Image &image, bool halveWidth, bool halveHeight) {
+  int width = halveWidth ? image.width / 2 : image.width;
+  int height = halveHeight ? image.height / 2 : image.height;
+  int stepX = halveWidth ? 2 : 1;
+  int stepY = halveHeight ? 2 : 1;
+  vector<unsigned char> pixels(width * height * 4);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      for (int c = 0; c < 4; c++) {
+        unsigned int sum = 0;
+        for (int dy = 0; dy < stepY; dy++) {
+          for (int dx = 0; dx < stepX; dx++) {
+            sum += image.pixels[((y * stepY + dy) * image.width +
+                                 x * stepX + dx) * 4 + c];
+          }
+        }
+        pixels[(y * width + x) * 4 + c] =
+            (unsigned char)((sum + stepX * stepY / 2) / (stepX * stepY));
+      }
+    }
+  }
+  image.pixels.swap(pixels);
+  image.width = width;
+  image.height = height;
+}
+
+// Scales the image to width x height. Box filtered halving first brings it
+// within a factor of two, so the final bilinear pass doesn't skip texels.
+static void resample(Image &image, int width, int height) {
+  while (image.width >= width * 2 || image.height >= height * 2) {
+    halve(image, image.width >= width * 2, image.height >= height * 2);
+  }
+  if (image.width == width && image.height == height) {
+    return;
+  }
+  vector<unsigned char> pixels(width * height * 4);
+  float scaleX = (float)image.width / width;
+  float scaleY = (float)image.height / height;
+  for (int y = 0; y < height; y++) {
+    float sourceY = std::max((y + 0.5f) * scaleY - 0.5f, 0.0f);
+    int y0 = std::min((int)sourceY, image.height - 1);
+    int y1 = std::min(y0 + 1, image.height - 1);
+    float fy = sourceY - y0;
+    for (int x = 0; x < width; x++) {
+      float sourceX = std::max((x + 0.5f) * scaleX - 0.5f, 0.0f);
+      int x0 = std::min((int)sourceX, image.width - 1);
+      int x1 = std::min(x0 + 1, image.width - 1);
+      float fx = sourceX - x0;
+      for (int c = 0; c < 4; c++) {
+        float top = image.pixels[(y0 * image.width + x0) * 4 + c] * (1 - fx) +
+                    image.pixels[(y0 * image.width + x1) * 4 + c] * fx;
+        float bottom =
+            image.pixels[(y1 * image.width + x0) * 4 + c] * (1 - fx) +
+            image.pixels[(y1 * image.width + x1) * 4 + c] * fx;
+        pixels[(y * width + x) * 4 + c] =
+            (unsigned char)(top * (1 - fy) + bottom * fy + 0.5f);
+      }
+    }
+  }
+  image.pixels.swap(pixels);
+  image.width = width;
+  image.height = height;
+}
+
+// decodes files into RGBA8 images, empty where a file can't be read
+static void loadImages(const vector<string> &files, vector<Image> &images,
+                       JobPool &pool) {
+  images.resize(files.size());
+  pool.parallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      int components;
+      unsigned char *data = stbi_load(files[i].c_str(), &images[i].width,
+                                      &images[i].height, &components, 4);
+      images[i].alpha = data != NULL && components == 4;
+      if (data == NULL) {
+        images[i].width = 0;
+        images[i].height = 0;
+        continue;
+      }
+      images[i].pixels.assign(data,
+                              data + images[i].width * images[i].height * 4);
+      stbi_image_free(data);
+    }
+  });
+}
+
+// Resamples the images to mip levels firstLevel to lastLevel of a texture of
+// width x height, consuming them
+static void buildLevels(vector<Image> &images, int width, int height,
+                        int firstLevel, int lastLevel,
+                        vector<LayerImages> &levels, JobPool &pool) {
+  levels.resize(lastLevel - firstLevel + 1);
+  for (unsigned int i = 0; i < levels.size(); i++) {
+    levels[i].width = mipExtent(width, firstLevel + i);
+    levels[i].height = mipExtent(height, firstLevel + i);
+    levels[i].layers.resize(images.size());
+  }
+  pool.parallelFor(images.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      Image &image = images[i];
+      if (image.pixels.empty()) {
+        // black, like the empty texture loadTexture leaves behind
+        image.pixels.assign(levels[0].width * levels[0].height * 4, 0);
+        image.width = levels[0].width;
+        image.height = levels[0].height;
+      } else {
+        resample(image, levels[0].width, levels[0].height);
+      }
+      for (unsigned int level = 0; level < levels.size(); level++) {
+        if (level > 0) {
+          halve(image, image.width > 1, image.height > 1);
+        }
+        levels[level].layers[i] = image.pixels;
+      }
+      vector<unsigned char>().swap(image.pixels);
+    }
+  });
+}
+
+void decodeMipLevels(const vector<string> &files, int width, int height,
+                     int firstLevel, int lastLevel, vector<LayerImages> &levels,
+                     JobPool &pool) {
+  vector<Image> images;
+  loadImages(files, images, pool);
+  for (unsigned int i = 0; i < images.size(); i++) {
+    if (images[i].pixels.empty()) {
+      std::cout << "Texture failed to load at path: " << files[i] << std::endl;
+    }
+  }
+  buildLevels(images, width, height, firstLevel, lastLevel, levels, pool);
+}
+
+MaterialArrays::MaterialArrays() {
+  for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPES; i++) {
+    Array &array = arrays[i];
+    array.texture = 0;
+    array.width = 0;
+    array.height = 0;
+    array.levels = 0;
+    array.baseLevel = 0;
+    array.neededLevel = 0;
+    array.lastNeeded = 0;
+    array.loading = false;
+    array.bytes = 0;
+    array.pending.width = 0;
+    array.pending.height = 0;
+  }
+}
+
+MaterialArrays::~MaterialArrays() { release(); }
+
+void MaterialArrays::release() {
+  bool uploaded = false;
+  for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPES; i++) {
+    Array &array = arrays[i];
+    if (array.texture != 0) {
+      glDeleteTextures(1, &array.texture);
+      telemetry().textures--;
+      telemetry().textureBytes -= array.bytes;
+      uploaded = true;
+    }
+    array.texture = 0;
+    array.bytes = 0;
+    array.loading = false;
+  }
+  if (uploaded) {
+    textureStreamer().remove(*this);
+  }
+}
+
+vector<glm::ivec4>
+MaterialArrays::decode(const vector<const vector<Texture> *> &meshTextures,
+                       const string &directory, JobPool &pool) {
+  vector<glm::ivec4> layers(meshTextures.size(),
+                            glm::ivec4(NO_MATERIAL_LAYER));
+  for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPES; type++) {
+    vector<string> files;
+    map<string, int> fileLayers;
+    for (unsigned int i = 0; i < meshTextures.size(); i++) {
+      const vector<Texture> &textures = *meshTextures[i];
+      for (unsigned int j = 0; j < textures.size(); j++) {
+        // shaders sample the first texture of each type (texture_diffuse1)
+        if (textures[j].type != MATERIAL_TEXTURE_TYPE_NAMES[type] ||
+            layers[i][type] != NO_MATERIAL_LAYER) {
+          continue;
+        }
+        map<string, int>::iterator found = fileLayers.find(textures[j].path);
+        if (found != fileLayers.end()) {
+          layers[i][type] = found->second;
+          continue;
+        }
+        if ((int)files.size() >= MAX_MATERIAL_LAYERS) {
+          cout << "ERROR::MATERIAL_ARRAYS:: more than " << MAX_MATERIAL_LAYERS
+               << " layers, ignoring " << textures[j].path << endl;
+          continue;
+        }
+        layers[i][type] = files.size();
+        fileLayers[textures[j].path] = files.size();
+        files.push_back(directory + '/' + textures[j].path);
+      }
+    }
+    decodeLayers(type, files, pool);
+    for (unsigned int i = 0; i < layers.size(); i++) {
+      int layer = layers[i][type];
+      if (layer != NO_MATERIAL_LAYER && arrays[type].clamped[layer]) {
+        layers[i][type] += MATERIAL_LAYER_CLAMPED;
+      }
+    }
+  }
+  return layers;
+}
+
+void MaterialArrays::decodeLayers(unsigned int type,
+                                  const vector<string> &files, JobPool &pool) {
+  Array &array = arrays[type];
+  array.files = files;
+  vector<Image> images;
+  loadImages(files, images, pool);
+
+  int width = 1, height = 1;
+  array.clamped.resize(images.size());
+  for (unsigned int i = 0; i < images.size(); i++) {
+    if (images[i].pixels.empty()) {
+      std::cout << "Texture failed to load at path: " << files[i] << std::endl;
+    }
+    array.clamped[i] = images[i].alpha;
+    width = std::max(width, images[i].width);
+    height = std::max(height, images[i].height);
+  }
+  array.width = std::min(width, MAX_MATERIAL_LAYER_SIZE);
+  array.height = std::min(height, MAX_MATERIAL_LAYER_SIZE);
+  array.levels = 1;
+  while ((std::max(array.width, array.height) >> array.levels) > 0) {
+    array.levels++;
+  }
+  // the finest level that fits the starting size
+  array.baseLevel = 0;
+  while (std::max(array.width, array.height) >> array.baseLevel >
+         MATERIAL_STREAMING_START_SIZE) {
+    array.baseLevel++;
+  }
+
+  if (images.empty()) {
+    return;
+  }
+  vector<LayerImages> levels;
+  buildLevels(images, array.width, array.height, array.baseLevel,
+              array.baseLevel, levels, pool);
+  array.pending.width = levels[0].width;
+  array.pending.height = levels[0].height;
+  array.pending.layers.swap(levels[0].layers);
+}
+
+long long MaterialArrays::levelBytes(unsigned int type, int level) const {
+  const Array &array = arrays[type];
+  return (long long)mipExtent(array.width, level) *
+         mipExtent(array.height, level) * array.files.size() * 4;
+}
+
+void MaterialArrays::updateBytes(unsigned int type) {
+  Array &array = arrays[type];
+  long long bytes = 0;
+  for (int level = array.baseLevel; level < array.levels; level++) {
+    bytes += levelBytes(type, level);
+  }
+  telemetry().textureBytes += bytes - array.bytes;
+  array.bytes = bytes;
+}
+
+void MaterialArrays::upload() {
+  release();
+  bool uploaded = false;
+  for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPES; type++) {
+    Array &array = arrays[type];
+    LayerImages &layers = array.pending;
+    if (layers.layers.empty()) {
+      continue;
+    }
+    glGenTextures(1, &array.texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    // the finer levels stay undefined until they are streamed in, the
+    // texture is complete as long as sampling starts at the base level
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL,
+                    array.baseLevel);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL,
+                    array.levels - 1);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, array.baseLevel, GL_RGBA8, layers.width,
+                 layers.height, layers.layers.size(), 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, NULL);
+    for (unsigned int i = 0; i < layers.layers.size(); i++) {
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, array.baseLevel, 0, 0, i,
+                      layers.width, layers.height, 1, GL_RGBA,
+                      GL_UNSIGNED_BYTE, &layers.layers[i][0]);
+    }
+    // fills the levels below the base level
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    // a single wrap mode for the whole array, repeating as most models
+    // expect. Layers loadTexture would clamp are clamped by the shaders.
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    array.neededLevel = array.levels;
+    telemetry().textures++;
+    updateBytes(type);
+    // the texels live on in video memory only
+    vector<vector<unsigned char> >().swap(layers.layers);
+    uploaded = true;
+  }
+  if (uploaded) {
+    textureStreamer().add(*this);
+  }
+}
+
+void MaterialArrays::uploadLevels(unsigned int type, int firstLevel,
+                                  const vector<LayerImages> &levels) {
+  Array &array = arrays[type];
+  glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+  for (unsigned int i = 0; i < levels.size(); i++) {
+    const LayerImages &layers = levels[i];
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, firstLevel + i, GL_RGBA8, layers.width,
+                 layers.height, layers.layers.size(), 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, NULL);
+    for (unsigned int j = 0; j < layers.layers.size(); j++) {
+      glTexSubImage3D(GL_TEXTURE_2D_ARRAY, firstLevel + i, 0, 0, j,
+                      layers.width, layers.height, 1, GL_RGBA,
+                      GL_UNSIGNED_BYTE, &layers.layers[j][0]);
+    }
+  }
+  // only now that the levels are complete may sampling use them
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, firstLevel);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  array.baseLevel = firstLevel;
+  updateBytes(type);
+}
+
+void MaterialArrays::evictBaseLevel(unsigned int type) {
+  Array &array = arrays[type];
+  if (array.baseLevel + 1 >= array.levels) {
+    return;
+  }
+  glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL,
+                  array.baseLevel + 1);
+  // an empty image releases the level's memory, the texture stays complete
+  // since the level is below the base level now
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, array.baseLevel, GL_RGBA8, 0, 0, 0, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  array.baseLevel++;
+  updateBytes(type);
+}
+
+size_t MaterialArrays::pendingBytes() const {
+  size_t total = 0;
+  for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPES; i++) {
+    const LayerImages &pending = arrays[i].pending;
+    total += (size_t)pending.width * pending.height * 4 *
+             pending.layers.size();
+  }
+  return total;
+}
+
+size_t MaterialArrays::bytes() const {
+  size_t total = 0;
+  for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPES; i++) {
+    total += arrays[i].bytes;
+  }
+  return total;
+}
+
+void MaterialArrays::bind() const {
+  for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPES; i++) {
+    glActiveTexture(GL_TEXTURE0 + MATERIAL_ARRAY_UNIT + i);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[i].texture);
+  }
+  glActiveTexture(GL_TEXTURE0);
+  renderStats.stateChanges += MATERIAL_TEXTURE_TYPES;
+}
+
+void MaterialArrays::attach(Shader &shader) {
+  shader.use();
+  for (unsigned int i = 0; i < MATERIAL_TEXTURE_TYPES; i++) {
+    shader.setInt(MATERIAL_ARRAY_SAMPLERS[i], MATERIAL_ARRAY_UNIT + i);
+  }
+}
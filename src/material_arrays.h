@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "job_pool.h"
+#include "mesh.h"
+#include "shader.h"
+
+// Material texture types packed into arrays, in the order of the components
+// of Mesh::materialLayers
+const unsigned int MATERIAL_TEXTURE_TYPES = 4;
+extern const char *const MATERIAL_TEXTURE_TYPE_NAMES[MATERIAL_TEXTURE_TYPES];
+// sampler2DArray uniform of each type, bound to MATERIAL_ARRAY_UNIT + type
+extern const char *const MATERIAL_ARRAY_SAMPLERS[MATERIAL_TEXTURE_TYPES];
+const unsigned int MATERIAL_ARRAY_UNIT = 0;
+
+// Layers are as large as the largest texture of their type, up to this many
+// texels on each side. Other textures are resampled to that size.
+const int MAX_MATERIAL_LAYER_SIZE = 2048;
+// layers per array, the least OpenGL 3.3 guarantees
+const int MAX_MATERIAL_LAYERS = 256;
+// Added to a layer of Mesh::materialLayers whose texture has an alpha
+// channel. loadTexture clamps those to the edge rather than repeating them,
+// the arrays can't, so the shaders clamp the coordinates of such layers.
+const int MATERIAL_LAYER_CLAMPED = 1 << 16;
+
+// Arrays start out with the mip levels of at most this many texels on each
+// side, TextureStreamer loads the finer ones once they are needed
+const int MATERIAL_STREAMING_START_SIZE = 128;
+
+// Define shaders must be compiled with to sample MaterialArrays
+const char *const MATERIAL_ARRAYS_DEFINE = "#define MATERIAL_ARRAYS\n";
+
+// RGBA8 texels of the layers of one array, decoded but not uploaded yet
+struct LayerImages {
+  int width;
+  int height;
+  vector<vector<unsigned char> > layers;
+};
+
+// size of a mip level of a texture of size texels, as OpenGL computes it
+inline int mipExtent(int size, int level) {
+  return std::max(size >> level, 1);
+}
+
+// Decodes files into mip levels firstLevel to lastLevel of layers whose level
+// 0 is width x height, one LayerImages per level. Textures of other sizes are
+// resampled, files that can't be read become black layers. Doesn't touch
+// OpenGL.
+void decodeMipLevels(const vector<string> &files, int width, int height,
+                     int firstLevel, int lastLevel, vector<LayerImages> &levels,
+                     JobPool &pool);
+
+class TextureStreamer;
+
+// The material textures of a model packed into one GL_TEXTURE_2D_ARRAY per
+// texture type. Meshes select their layers through a vertex attribute, so
+// the whole model draws with a single set of texture bindings.
+//
+// Only the coarse mip levels are decoded and uploaded at first. The arrays
+// register with textureStreamer(), which streams finer levels in and drops
+// them again; GL_TEXTURE_BASE_LEVEL marks the finest level resident.
+class MaterialArrays {
+public:
+  MaterialArrays();
+  ~MaterialArrays();
+
+  // Decodes the textures of every mesh, resolved against directory, on the
+  // job pool. Doesn't touch OpenGL, so it may run on any thread. Textures
+  // shared between meshes become a single layer. Returns each mesh's layer
+  // per type, NO_MATERIAL_LAYER where it has no texture of that type, with
+  // MATERIAL_LAYER_CLAMPED added for textures with an alpha channel.
+  vector<glm::ivec4> decode(const vector<const vector<Texture> *> &meshTextures,
+                            const string &directory, JobPool &pool);
+
+  // creates the arrays from what decode() produced, frees the texels and
+  // hands the arrays to textureStreamer()
+  void upload();
+
+  // deletes the arrays
+  void release();
+
+  // binds the arrays to consecutive units from MATERIAL_ARRAY_UNIT
+  void bind() const;
+
+  // size of the decoded texels waiting for upload()
+  size_t pendingBytes() const;
+  // video memory of the resident mip levels of the arrays
+  size_t bytes() const;
+
+  // points the shader's array samplers at their units, leaves the shader in
+  // use
+  static void attach(Shader &shader);
+
+private:
+  friend class TextureStreamer;
+
+  // the array of one texture type and its streaming state
+  struct Array {
+    // 0 where no mesh has a texture of the type
+    unsigned int texture;
+    // file of each layer, finer levels are decoded from them again
+    vector<string> files;
+    // whether each layer has an alpha channel, see MATERIAL_LAYER_CLAMPED
+    vector<bool> clamped;
+    // size of level 0 and the number of levels down to 1x1. Only the levels
+    // from baseLevel on are resident.
+    int width;
+    int height;
+    int levels;
+    int baseLevel;
+    // finest level TextureStreamer::request asked for since the last
+    // update, levels if none, and the update it was last asked for in
+    int neededLevel;
+    unsigned long long lastNeeded;
+    // whether finer levels are being decoded
+    bool loading;
+    long long bytes;
+    // decoded baseLevel, waiting for upload()
+    LayerImages pending;
+  };
+  Array arrays[MATERIAL_TEXTURE_TYPES];
+
+  // decodes files into the pending layers of the type at its starting level
+  void decodeLayers(unsigned int type, const vector<string> &files,
+                    JobPool &pool);
+
+  // video memory of a level of the type's array
+  long long levelBytes(unsigned int type, int level) const;
+  // uploads decoded levels from firstLevel on and makes the first one the
+  // base level. They must reach down to the current base level.
+  void uploadLevels(unsigned int type, int firstLevel,
+                    const vector<LayerImages> &levels);
+  // frees the base level, the next coarser level becomes the base
+  void evictBaseLevel(unsigned int type);
+  // accounts the resident levels in bytes and the telemetry
+  void updateBytes(unsigned int type);
+
+  MaterialArrays(const MaterialArrays &);
+  MaterialArrays &operator=(const MaterialArrays &);
+};
@@ -1,3 +1,4 @@
+#include <cmath>
 #include <fstream>
 #include <iostream>
 #include <sstream>
@@ -10,31 +11,34 @@
 
 #include "mesh.h"
 #include "shader.h"
+#include "telemetry.h"
 
 using namespace std;
 
 Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices,
-           vector<Texture> textures) {
-  this->vertices = vertices;
-  this->indices = indices;
-  this->textures = textures;
-
+           vector<Texture> textures)
+    : vertices(std::move(vertices)), indices(std::move(indices)),
+      textures(std::move(textures)), skinned(false), layered(false),
+      materialLayers(NO_MATERIAL_LAYER) {
+  bounds = computeBounds(this->vertices.empty() ? NULL
+                                                : &this->vertices[0].position,
+                         this->vertices.size(), sizeof(Vertex));
+  uvDensity = computeUvDensity(this->vertices, this->indices);
+  samplerNames = buildSamplerNames(this->textures);
   setupMesh();
 }
 
-// render the mesh
-void Mesh::Draw(Shader shader) {
-  // bind appropriate textures
+vector<string> buildSamplerNames(const vector<Texture> &textures) {
+  vector<string> names;
+  names.reserve(textures.size());
   unsigned int diffuseNr = 1;
   unsigned int specularNr = 1;
   unsigned int normalNr = 1;
   unsigned int heightNr = 1;
   for (unsigned int i = 0; i < textures.size(); i++) {
-    glActiveTexture(GL_TEXTURE0 +
-                    i); // active proper texture unit before binding
     // retrieve texture number (the N in diffuse_textureN)
     string number;
-    string name = textures[i].type;
+    const string &name = textures[i].type;
     if (name == "texture_diffuse")
       number = std::to_string(diffuseNr++);
     else if (name == "texture_specular")
@@ -43,9 +47,43 @@ void Mesh::Draw(Shader shader) {
       number = std::to_string(normalNr++); // transfer unsigned int to stream
     else if (name == "texture_height")
       number = std::to_string(heightNr++); // transfer unsigned int to stream
+    names.push_back(name + number);
+  }
+  return names;
+}
+
+float computeUvDensity(const vector<Vertex> &vertices,
+                       const vector<unsigned int> &indices) {
+  double area = 0.0, uvArea = 0.0;
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const Vertex &a = vertices[indices[i]];
+    const Vertex &b = vertices[indices[i + 1]];
+    const Vertex &c = vertices[indices[i + 2]];
+    area += glm::length(
+        glm::cross(b.position - a.position, c.position - a.position));
+    glm::vec2 u = b.texCoords - a.texCoords;
+    glm::vec2 v = c.texCoords - a.texCoords;
+    uvArea += std::abs(u.x * v.y - u.y * v.x);
+  }
+  if (area <= 0.0) {
+    return 0.0f;
+  }
+  return (float)std::sqrt(uvArea / area);
+}
 
+// render the mesh
+void Mesh::Draw(Shader shader) {
+  if (layered) {
+    // the model bound the arrays for all its meshes, only the layers change
+    glVertexAttribI4i(MATERIAL_LAYERS_ATTRIBUTE, materialLayers.x,
+                      materialLayers.y, materialLayers.z, materialLayers.w);
+  }
+  // bind appropriate textures
+  for (unsigned int i = 0; !layered && i < textures.size(); i++) {
+    glActiveTexture(GL_TEXTURE0 +
+                    i); // active proper texture unit before binding
     // now set the sampler to the correct texture unit
-    glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+    glUniform1i(glGetUniformLocation(shader.ID, samplerNames[i].c_str()), i);
     // and finally bind the texture
     glBindTexture(GL_TEXTURE_2D, textures[i].id);
   }
@@ -54,11 +92,34 @@ void Mesh::Draw(Shader shader) {
   glBindVertexArray(VAO);
   glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
   glBindVertexArray(0);
+  renderStats.drawCalls++;
+  renderStats.stateChanges += layered ? 1 : textures.size() + 1;
+  renderStats.triangles += indices.size() / 3;
 
   // always good practice to set everything back to defaults once configured.
   glActiveTexture(GL_TEXTURE0);
 }
 
+void Mesh::updateVertices(const vector<Vertex> &vertices) {
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  // orphan the old storage so we don't wait on draws still reading it
+  glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), NULL,
+               GL_DYNAMIC_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex),
+                  &vertices[0]);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Mesh::release() {
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &VBO);
+  glDeleteBuffers(1, &EBO);
+  VAO = VBO = EBO = 0;
+  telemetry().meshes--;
+  telemetry().meshBytes -= vertices.size() * sizeof(Vertex) +
+                           indices.size() * sizeof(unsigned int);
+}
+
 void Mesh::setupMesh() {
   // create buffers/arrays
   glGenVertexArrays(1, &VAO);
@@ -78,6 +139,9 @@ void Mesh::setupMesh() {
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
                &indices[0], GL_STATIC_DRAW);
+  telemetry().meshes++;
+  telemetry().meshBytes += vertices.size() * sizeof(Vertex) +
+                           indices.size() * sizeof(unsigned int);
 
   // set the vertex attribute pointers
   // vertex Positions
@@ -99,6 +163,14 @@ void Mesh::setupMesh() {
   glEnableVertexAttribArray(4);
   glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                         (void *)offsetof(Vertex, bitangent));
+  // bone ids
+  glEnableVertexAttribArray(5);
+  glVertexAttribIPointer(5, MAX_BONE_INFLUENCE, GL_INT, sizeof(Vertex),
+                         (void *)offsetof(Vertex, boneIds));
+  // bone weights
+  glEnableVertexAttribArray(6);
+  glVertexAttribPointer(6, MAX_BONE_INFLUENCE, GL_FLOAT, GL_FALSE,
+                        sizeof(Vertex), (void *)offsetof(Vertex, weights));
 
   glBindVertexArray(0);
 }
@@ -4,16 +4,29 @@
 
 #include <glm/glm.hpp>
 
+#include "culling.h"
 #include "shader.h"
 
 using namespace std;
 
+// Maximum number of bones influencing a single vertex
+const unsigned int MAX_BONE_INFLUENCE = 4;
+
+// Vertex attribute holding a mesh's texture array layers, constant across
+// the mesh (see MaterialArrays)
+const unsigned int MATERIAL_LAYERS_ATTRIBUTE = 7;
+// layer of a texture type the mesh doesn't have
+const int NO_MATERIAL_LAYER = -1;
+
 struct Vertex {
   glm::vec3 position;
   glm::vec3 normal;
   glm::vec2 texCoords;
   glm::vec3 tangent;
   glm::vec3 bitangent;
+  // skinning influences, all weights are zero for static vertices
+  int boneIds[MAX_BONE_INFLUENCE];
+  float weights[MAX_BONE_INFLUENCE];
 };
 
 struct Texture {
@@ -22,19 +35,53 @@ struct Texture {
   string path;
 };
 
+// Sampler uniform names of the textures, in order: the texture's type
+// followed by its number among the textures of that type, starting at 1
+// (texture_diffuse1, texture_diffuse2, texture_specular1, ...)
+vector<string> buildSamplerNames(const vector<Texture> &textures);
+
+// Texture coordinate units per unit of length across the triangles, the root
+// of their texture space area over their area. 0 for meshes without area.
+float computeUvDensity(const vector<Vertex> &vertices,
+                       const vector<unsigned int> &indices);
+
 class Mesh {
 public:
   vector<Vertex> vertices;
   vector<unsigned int> indices;
   vector<Texture> textures;
   unsigned int VAO;
+  // whether the vertices are bound to a skeleton
+  bool skinned;
+  // bounds of the vertices in the mesh's own space, in the bind pose for
+  // skinned meshes
+  AABB bounds;
+  // see computeUvDensity, texture streaming derives the mip levels the mesh
+  // needs from it
+  float uvDensity;
+  // when set, the textures live in texture arrays bound by the model, and
+  // materialLayers holds the mesh's diffuse, specular, normal and height
+  // layer. Otherwise the mesh binds its own textures.
+  bool layered;
+  glm::ivec4 materialLayers;
 
+  // the arguments are moved in, pass temporaries or std::move to avoid copies
   Mesh(vector<Vertex> vertices, vector<unsigned int> indices,
        vector<Texture> textures);
 
   void Draw(Shader shader);
 
+  // replaces the contents of the vertex buffer, e.g. with CPU skinned
+  // vertices. Must hold as many vertices as the mesh was created with.
+  void updateVertices(const vector<Vertex> &vertices);
+
+  // Deletes the GL buffers. Copies of the mesh share them, none of them may
+  // be drawn afterwards.
+  void release();
+
 private:
   unsigned int VBO, EBO;
+  // sampler name of each texture, built once instead of on every draw
+  vector<string> samplerNames;
   void setupMesh();
 };
@@ -14,13 +14,20 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+#include "animation.h"
+#include "culling.h"
+#include "job_pool.h"
+#include "material_arrays.h"
 #include "mesh.h"
 #include "model.h"
+#include "obj_loader.h"
+#include "scene_graph.h"
 #include "shader.h"
+#include "telemetry.h"
 
 using namespace std;
 
-unsigned int loadTexture(string path) {
+unsigned int loadTexture(string path, size_t *bytes) {
   unsigned int textureID;
   glGenTextures(1, &textureID);
 
@@ -50,6 +57,14 @@ unsigned int loadTexture(string path) {
   glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
                GL_UNSIGNED_BYTE, data);
   glGenerateMipmap(GL_TEXTURE_2D);
+  // drivers pad RGB to four bytes, the mip chain adds a third
+  size_t textureBytes =
+      (size_t)width * height * (nrComponents == 1 ? 1 : 4) * 4 / 3;
+  telemetry().textures++;
+  telemetry().textureBytes += textureBytes;
+  if (bytes) {
+    *bytes = textureBytes;
+  }
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
                   format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
@@ -64,7 +79,8 @@ unsigned int loadTexture(string path) {
   return textureID;
 }
 
-unsigned int loadCubemap(vector<std::string> faces) {
+unsigned int loadCubemap(vector<std::string> faces, size_t *bytes) {
+  size_t textureBytes = 0;
   unsigned int textureID;
   glGenTextures(1, &textureID);
   glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
@@ -76,6 +92,7 @@ unsigned int loadCubemap(vector<std::string> faces) {
     if (data) {
       glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height,
                    0, GL_RGB, GL_UNSIGNED_BYTE, data);
+      textureBytes += (size_t)width * height * 4;
       stbi_image_free(data);
     } else {
       std::cout << "Cubemap tex failed to load at path: " << faces[i]
@@ -88,110 +105,337 @@ unsigned int loadCubemap(vector<std::string> faces) {
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
   glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  telemetry().textures++;
+  telemetry().textureBytes += textureBytes;
+  if (bytes) {
+    *bytes = textureBytes;
+  }
 
   return textureID;
 }
 
-Model::Model(string const &path, bool gamma) : gammaCorrection(gamma) {
-  loadModel(path);
+void deleteTexture(unsigned int texture, size_t bytes) {
+  glDeleteTextures(1, &texture);
+  telemetry().textures--;
+  telemetry().textureBytes -= bytes;
 }
 
-void Model::Draw(Shader shader) {
-  for (unsigned int i = 0; i < meshes.size(); i++)
+Model::Model(string const &path, bool gamma, bool textureArrays)
+    : gammaCorrection(gamma), textureArrays(textureArrays), textureBytes(0) {
+  if (import(path)) {
+    upload();
+  }
+}
+
+Model::Model()
+    : gammaCorrection(false), textureArrays(false), textureBytes(0) {}
+
+void Model::Draw(Shader shader, const glm::mat4 &transform,
+                 const Frustum *frustum) {
+  if (textureArrays) {
+    materialArrays.bind();
+  }
+  glm::mat4 model;
+  for (unsigned int i = 0; i < meshes.size(); i++) {
+    // skinned vertices are moved into model space by their bones already.
+    // Their bind pose bounds don't cover the animation, so they aren't culled.
+    if (meshes[i].skinned) {
+      model = transform;
+    } else {
+      multiplyMatrices(transform, nodes.getWorld(meshNodes[i]), model);
+      if (frustum &&
+          !isVisible(*frustum, transformBounds(meshes[i].bounds, model))) {
+        continue;
+      }
+    }
+    shader.setMat4("model", model);
     meshes[i].Draw(shader);
+  }
 }
 
-void Model::loadModel(string const &path) {
+// assimp matrices are row-major, glm's are column-major
+static glm::mat4 toMat4(const aiMatrix4x4 &m) {
+  return glm::mat4(m.a1, m.b1, m.c1, m.d1, //
+                   m.a2, m.b2, m.c2, m.d2, //
+                   m.a3, m.b3, m.c3, m.d3, //
+                   m.a4, m.b4, m.c4, m.d4);
+}
+
+bool Model::import(string const &path, JobPool &pool) {
+  // retrieve the directory path of the filepath
+  directory = path.substr(0, path.find_last_of('/'));
+
+  // OBJ files have a faster loader of their own, Assimp handles the rest and
+  // anything that loader can't read
+  bool imported = false;
+  if (path.size() > 4 && path.compare(path.size() - 4, 4, ".obj") == 0) {
+    ObjScene obj;
+    if (loadObj(path, obj, pool)) {
+      importObjScene(obj);
+      imported = true;
+    } else {
+      cout << "ERROR::OBJ:: falling back to Assimp for " << path << endl;
+    }
+  }
+  if (!imported && !importAssimp(path, pool)) {
+    return false;
+  }
+
+  // decoding is most of the texture work, only creating them is left for
+  // upload()
+  if (textureArrays) {
+    vector<const vector<Texture> *> meshTextures(pendingMeshes.size());
+    for (unsigned int i = 0; i < pendingMeshes.size(); i++) {
+      meshTextures[i] = &pendingMeshes[i].textures;
+    }
+    pendingLayers = materialArrays.decode(meshTextures, directory, pool);
+  }
+  return true;
+}
+
+bool Model::importAssimp(string const &path, JobPool &pool) {
   // read file via ASSIMP
   Assimp::Importer importer;
   const aiScene *scene =
       importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs |
-                                  aiProcess_CalcTangentSpace);
+                                  aiProcess_CalcTangentSpace |
+                                  aiProcess_LimitBoneWeights);
   // check for errors
   if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE ||
       !scene->mRootNode) // if is Not Zero
   {
     cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-    return;
+    return false;
   }
-  // retrieve the directory path of the filepath
-  directory = path.substr(0, path.find_last_of('/'));
 
-  // process ASSIMP's root node recursively
-  processNode(scene->mRootNode, scene);
+  // process ASSIMP's root node recursively, collecting the meshes to convert
+  vector<aiMesh *> sceneMeshes;
+  processNode(scene->mRootNode, scene, SceneGraph::NO_PARENT, sceneMeshes);
+  nodes.update();
+
+  // bones are shared between meshes, so they are numbered up front
+  vector<vector<unsigned int> > boneMaps(sceneMeshes.size());
+  for (unsigned int i = 0; i < sceneMeshes.size(); i++) {
+    boneMaps[i] = registerBones(sceneMeshes[i]);
+  }
+
+  // the conversion of every mesh is independent
+  pendingMeshes.resize(sceneMeshes.size());
+  pool.parallelFor(sceneMeshes.size(), 1, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      convertMesh(sceneMeshes[i], boneMaps[i], pendingMeshes[i].data);
+    }
+  });
+  for (unsigned int i = 0; i < sceneMeshes.size(); i++) {
+    pendingMeshes[i].textures = loadMeshTextures(sceneMeshes[i], scene);
+    pendingMeshes[i].skinned = sceneMeshes[i]->HasBones();
+  }
+
+  resolveSkeleton();
+  loadAnimations(scene);
+  return true;
+}
+
+void Model::upload() {
+  if (textureArrays) {
+    materialArrays.upload();
+  } else {
+    for (unsigned int i = 0; i < textures_loaded.size(); i++) {
+      size_t bytes = 0;
+      textures_loaded[i].id = loadTexture(
+          this->directory + '/' + textures_loaded[i].path, &bytes);
+      textureBytes += bytes;
+    }
+  }
+
+  meshes.reserve(meshes.size() + pendingMeshes.size());
+  for (unsigned int i = 0; i < pendingMeshes.size(); i++) {
+    PendingMesh &pending = pendingMeshes[i];
+    // the textures were only recorded on import
+    for (unsigned int j = 0; j < pending.textures.size(); j++) {
+      for (unsigned int k = 0; k < textures_loaded.size(); k++) {
+        if (textures_loaded[k].path == pending.textures[j].path) {
+          pending.textures[j].id = textures_loaded[k].id;
+        }
+      }
+    }
+    meshes.push_back(Mesh(std::move(pending.data.vertices),
+                          std::move(pending.data.indices),
+                          std::move(pending.textures)));
+    meshes.back().skinned = pending.skinned;
+    if (textureArrays) {
+      meshes.back().layered = true;
+      meshes.back().materialLayers = pendingLayers[i];
+    }
+  }
+  pendingMeshes.clear();
+  pendingLayers.clear();
+}
+
+Model::~Model() { release(); }
+
+void Model::release() {
+  for (unsigned int i = 0; i < meshes.size(); i++) {
+    meshes[i].release();
+  }
+  meshes.clear();
+  materialArrays.release();
+  for (unsigned int i = 0; i < textures_loaded.size(); i++) {
+    if (textures_loaded[i].id != 0) {
+      glDeleteTextures(1, &textures_loaded[i].id);
+      textures_loaded[i].id = 0;
+      telemetry().textures--;
+    }
+  }
+  telemetry().textureBytes -= textureBytes;
+  textureBytes = 0;
+}
+
+size_t Model::cpuBytes() const {
+  size_t total = materialArrays.pendingBytes();
+  for (unsigned int i = 0; i < meshes.size(); i++) {
+    total += meshes[i].vertices.size() * sizeof(Vertex) +
+             meshes[i].indices.size() * sizeof(unsigned int);
+  }
+  for (unsigned int i = 0; i < pendingMeshes.size(); i++) {
+    total += pendingMeshes[i].data.vertices.size() * sizeof(Vertex) +
+             pendingMeshes[i].data.indices.size() * sizeof(unsigned int);
+  }
+  return total;
+}
+
+size_t Model::gpuBytes() const {
+  size_t total = materialArrays.bytes() + textureBytes;
+  for (unsigned int i = 0; i < meshes.size(); i++) {
+    total += meshes[i].vertices.size() * sizeof(Vertex) +
+             meshes[i].indices.size() * sizeof(unsigned int);
+  }
+  return total;
+}
+
+void Model::importObjScene(ObjScene &obj) {
+  // OBJ files have no hierarchy, every mesh hangs off a single root node
+  unsigned int root = nodes.addNode(SceneGraph::NO_PARENT, glm::mat4(1.0f));
+  nodes.update();
+
+  pendingMeshes.resize(obj.meshes.size());
+  for (unsigned int i = 0; i < obj.meshes.size(); i++) {
+    ObjMesh &mesh = obj.meshes[i];
+    // same sampler names as the Assimp path, where map_Bump is imported as
+    // a height map and map_Ka as an ambient map
+    vector<Texture> &textures = pendingMeshes[i].textures;
+    if (mesh.material >= 0) {
+      const ObjMaterial &material = obj.materials[mesh.material];
+      if (!material.diffuseMap.empty()) {
+        textures.push_back(
+            loadMaterialTexture(material.diffuseMap, "texture_diffuse"));
+      }
+      if (!material.specularMap.empty()) {
+        textures.push_back(
+            loadMaterialTexture(material.specularMap, "texture_specular"));
+      }
+      if (!material.bumpMap.empty()) {
+        textures.push_back(
+            loadMaterialTexture(material.bumpMap, "texture_normal"));
+      }
+      if (!material.ambientMap.empty()) {
+        textures.push_back(
+            loadMaterialTexture(material.ambientMap, "texture_height"));
+      }
+    }
+    pendingMeshes[i].data.vertices.swap(mesh.data.vertices);
+    pendingMeshes[i].data.indices.swap(mesh.data.indices);
+    pendingMeshes[i].skinned = false;
+    meshNodes.push_back(root);
+  }
+  resolveSkeleton();
 }
 
-void Model::processNode(aiNode *node, const aiScene *scene) {
-  // process each mesh located at the current node
+void Model::processNode(aiNode *node, const aiScene *scene, int parent,
+                        vector<aiMesh *> &sceneMeshes) {
+  // nodes are visited parents first, which is the order SceneGraph requires
+  unsigned int index = nodes.addNode(parent, toMat4(node->mTransformation));
+  nodeIndices[node->mName.C_Str()] = index;
+  // collect each mesh located at the current node
   for (unsigned int i = 0; i < node->mNumMeshes; i++) {
     // the node object only contains indices to index the actual objects in
     // the scene. the scene contains all the data, node is just to keep stuff
     // organized (like relations between nodes).
-    aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-    meshes.push_back(processMesh(mesh, scene));
+    sceneMeshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+    meshNodes.push_back(index);
   }
   // after we've processed all of the meshes (if any) we then recursively
   // process each of the children nodes
   for (unsigned int i = 0; i < node->mNumChildren; i++) {
-    processNode(node->mChildren[i], scene);
+    processNode(node->mChildren[i], scene, index, sceneMeshes);
   }
 }
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
-  // data to fill
-  vector<Vertex> vertices;
-  vector<unsigned int> indices;
-  vector<Texture> textures;
+static glm::vec3 toVec3(const aiVector3D &v) {
+  return glm::vec3(v.x, v.y, v.z);
+}
 
-  // Walk through each of the mesh's vertices
+void convertMesh(const aiMesh *mesh, const vector<unsigned int> &boneMap,
+                 MeshData &data) {
+  // every vertex is written exactly once, straight into its final place
+  data.vertices.resize(mesh->mNumVertices);
+  Vertex *vertices = data.vertices.empty() ? NULL : &data.vertices[0];
+  // a vertex can contain up to 8 different texture coordinates. We thus make
+  // the assumption that we won't use models where a vertex can have multiple
+  // texture coordinates so we always take the first set (0).
+  const aiVector3D *texCoords = mesh->mTextureCoords[0];
+  const glm::vec3 zero(0.0f);
   for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
-    Vertex vertex;
-    glm::vec3 vector; // we declare a placeholder vector since assimp uses its
-                      // own vector class that doesn't directly convert to
-                      // glm's vec3 class so we transfer the data to this
-                      // placeholder glm::vec3 first.
-    // positions
-    vector.x = mesh->mVertices[i].x;
-    vector.y = mesh->mVertices[i].y;
-    vector.z = mesh->mVertices[i].z;
-    vertex.position = vector;
-    // normals
-    vector.x = mesh->mNormals[i].x;
-    vector.y = mesh->mNormals[i].y;
-    vector.z = mesh->mNormals[i].z;
-    vertex.normal = vector;
-    // texture coordinates
-    if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
-    {
-      glm::vec2 vec;
-      // a vertex can contain up to 8 different texture coordinates. We thus
-      // make the assumption that we won't use models where a vertex can have
-      // multiple texture coordinates so we always take the first set (0).
-      vec.x = mesh->mTextureCoords[0][i].x;
-      vec.y = mesh->mTextureCoords[0][i].y;
-      vertex.texCoords = vec;
-    } else
-      vertex.texCoords = glm::vec2(0.0f, 0.0f);
-    // tangent
-    vector.x = mesh->mTangents[i].x;
-    vector.y = mesh->mTangents[i].y;
-    vector.z = mesh->mTangents[i].z;
-    vertex.tangent = vector;
-    // bitangent
-    vector.x = mesh->mBitangents[i].x;
-    vector.y = mesh->mBitangents[i].y;
-    vector.z = mesh->mBitangents[i].z;
-    vertex.bitangent = vector;
-    vertices.push_back(vertex);
+    Vertex &vertex = vertices[i];
+    vertex.position = toVec3(mesh->mVertices[i]);
+    vertex.normal = mesh->mNormals ? toVec3(mesh->mNormals[i]) : zero;
+    vertex.texCoords = texCoords ? glm::vec2(texCoords[i].x, texCoords[i].y)
+                                 : glm::vec2(0.0f, 0.0f);
+    vertex.tangent = mesh->mTangents ? toVec3(mesh->mTangents[i]) : zero;
+    vertex.bitangent = mesh->mBitangents ? toVec3(mesh->mBitangents[i]) : zero;
+    for (unsigned int j = 0; j < MAX_BONE_INFLUENCE; j++) {
+      vertex.boneIds[j] = 0;
+      vertex.weights[j] = 0.0f;
+    }
   }
+
+  // bone influences, boneMap translates the mesh's bones to skeleton indices
+  for (unsigned int i = 0; i < mesh->mNumBones && i < boneMap.size(); i++) {
+    const aiBone *bone = mesh->mBones[i];
+    if (boneMap[i] >= MAX_BONES) {
+      continue;
+    }
+    for (unsigned int j = 0; j < bone->mNumWeights; j++) {
+      Vertex &vertex = vertices[bone->mWeights[j].mVertexId];
+      // aiProcess_LimitBoneWeights guarantees a free slot
+      for (unsigned int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+        if (vertex.weights[k] == 0.0f) {
+          vertex.boneIds[k] = boneMap[i];
+          vertex.weights[k] = bone->mWeights[j].mWeight;
+          break;
+        }
+      }
+    }
+  }
+
   // now walk through each of the mesh's faces (a face is a mesh its triangle)
   // and retrieve the corresponding vertex indices.
+  size_t indexCount = 0;
   for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
-    aiFace face = mesh->mFaces[i];
-    // retrieve all indices of the face and store them in the indices vector
-    for (unsigned int j = 0; j < face.mNumIndices; j++)
-      indices.push_back(face.mIndices[j]);
+    indexCount += mesh->mFaces[i].mNumIndices;
   }
+  data.indices.resize(indexCount);
+  unsigned int *indices = indexCount ? &data.indices[0] : NULL;
+  for (unsigned int i = 0; i < mesh->mNumFaces; i++) {
+    const aiFace &face = mesh->mFaces[i];
+    for (unsigned int j = 0; j < face.mNumIndices; j++) {
+      *indices++ = face.mIndices[j];
+    }
+  }
+}
+
+vector<Texture> Model::loadMeshTextures(aiMesh *mesh, const aiScene *scene) {
+  vector<Texture> textures;
   // process materials
   aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
   // we assume a convention for sampler names in the shaders. Each diffuse
@@ -218,8 +462,95 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
       loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
   textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-  // return a mesh object created from the extracted mesh data
-  return Mesh(vertices, indices, textures);
+  return textures;
+}
+
+vector<unsigned int> Model::registerBones(aiMesh *mesh) {
+  vector<unsigned int> boneMap(mesh->mNumBones, MAX_BONES);
+  for (unsigned int i = 0; i < mesh->mNumBones; i++) {
+    aiBone *bone = mesh->mBones[i];
+    string name = bone->mName.C_Str();
+    // bones may be shared between meshes
+    map<string, unsigned int>::iterator found =
+        skeleton.boneIndices.find(name);
+    if (found != skeleton.boneIndices.end()) {
+      boneMap[i] = found->second;
+      continue;
+    }
+    unsigned int boneIndex = skeleton.boneOffsets.size();
+    if (boneIndex >= MAX_BONES) {
+      cout << "ERROR::MODEL:: more than " << MAX_BONES << " bones, ignoring "
+           << name << endl;
+      continue;
+    }
+    skeleton.boneIndices[name] = boneIndex;
+    skeleton.boneOffsets.push_back(toMat4(bone->mOffsetMatrix));
+    boneMap[i] = boneIndex;
+  }
+  return boneMap;
+}
+
+void Model::resolveSkeleton() {
+  skeleton.boneNodes.assign(skeleton.boneOffsets.size(), 0);
+  map<string, unsigned int>::iterator bone;
+  for (bone = skeleton.boneIndices.begin();
+       bone != skeleton.boneIndices.end(); bone++) {
+    map<string, unsigned int>::iterator node = nodeIndices.find(bone->first);
+    if (node == nodeIndices.end()) {
+      cout << "ERROR::MODEL:: no node for bone " << bone->first << endl;
+      continue;
+    }
+    skeleton.boneNodes[bone->second] = node->second;
+  }
+  skeleton.globalInverse =
+      nodes.size() > 0 ? glm::inverse(nodes.getWorld(0)) : glm::mat4(1.0f);
+}
+
+void Model::loadAnimations(const aiScene *scene) {
+  for (unsigned int i = 0; i < scene->mNumAnimations; i++) {
+    aiAnimation *animation = scene->mAnimations[i];
+    // files are allowed to leave the tick rate unspecified
+    float ticksPerSecond = animation->mTicksPerSecond > 0.0
+                               ? (float)animation->mTicksPerSecond
+                               : 25.0f;
+    AnimationClip clip;
+    clip.name = animation->mName.C_Str();
+    clip.duration = animation->mDuration / ticksPerSecond;
+
+    for (unsigned int j = 0; j < animation->mNumChannels; j++) {
+      aiNodeAnim *channel = animation->mChannels[j];
+      map<string, unsigned int>::iterator node =
+          nodeIndices.find(channel->mNodeName.C_Str());
+      if (node == nodeIndices.end()) {
+        continue;
+      }
+      AnimationChannel result;
+      result.node = node->second;
+      for (unsigned int k = 0; k < channel->mNumPositionKeys; k++) {
+        const aiVectorKey &key = channel->mPositionKeys[k];
+        VectorKey converted = {
+            (float)key.mTime / ticksPerSecond,
+            glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z)};
+        result.positions.push_back(converted);
+      }
+      for (unsigned int k = 0; k < channel->mNumRotationKeys; k++) {
+        const aiQuatKey &key = channel->mRotationKeys[k];
+        RotationKey converted = {(float)key.mTime / ticksPerSecond,
+                                 glm::quat(key.mValue.w, key.mValue.x,
+                                           key.mValue.y, key.mValue.z)};
+        result.rotations.push_back(converted);
+      }
+      for (unsigned int k = 0; k < channel->mNumScalingKeys; k++) {
+        const aiVectorKey &key = channel->mScalingKeys[k];
+        VectorKey converted = {
+            (float)key.mTime / ticksPerSecond,
+            glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z)};
+        result.scales.push_back(converted);
+      }
+      clip.channels.push_back(result);
+    }
+    animations.push_back(clip);
+  }
 }
 
 vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type,
@@ -228,27 +559,28 @@ vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type,
   for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
     aiString str;
     mat->GetTexture(type, i, &str);
-    // check if texture was loaded before and if so, continue to next
-    // iteration: skip loading a new texture
-    bool skip = false;
-    for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-      if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-        textures.push_back(textures_loaded[j]);
-        skip = true; // a texture with the same filepath has already been
-                     // loaded, continue to next one. (optimization)
-        break;
-      }
-    }
-    if (!skip) { // if texture hasn't been loaded already, load it
-      Texture texture;
-      texture.id = loadTexture(this->directory + '/' + str.C_Str());
-      texture.type = typeName;
-      texture.path = str.C_Str();
-      textures.push_back(texture);
-      textures_loaded.push_back(
-          texture); // store it as texture loaded for entire model, to ensure
-                    // we won't unnecesery load duplicate textures.
-    }
+    textures.push_back(loadMaterialTexture(str.C_Str(), typeName));
   }
   return textures;
 }
+
+Texture Model::loadMaterialTexture(const string &file, const string &typeName) {
+  // check if texture was loaded before and if so, reuse it: skip loading a
+  // new texture
+  for (unsigned int j = 0; j < textures_loaded.size(); j++) {
+    if (textures_loaded[j].path == file) {
+      // a texture with the same filepath has already been loaded
+      // (optimization)
+      return textures_loaded[j];
+    }
+  }
+  // if texture hasn't been recorded already, record it for upload()
+  Texture texture;
+  texture.id = 0;
+  texture.type = typeName;
+  texture.path = file;
+  textures_loaded.push_back(
+      texture); // store it as texture loaded for entire model, to ensure
+                // we won't unnecesery load duplicate textures.
+  return texture;
+}
@@ -4,43 +4,137 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "animation.h"
+#include "culling.h"
+#include "job_pool.h"
+#include "material_arrays.h"
 #include "mesh.h"
+#include "scene_graph.h"
 #include "shader.h"
 
+#include <map>
 #include <vector>
 
 using namespace std;
 
-unsigned int loadTexture(string path);
+// bytes, if given, receives the estimated video memory of the texture
+unsigned int loadTexture(string path, size_t *bytes = NULL);
 
-unsigned int loadCubemap(vector<std::string> faces);
+unsigned int loadCubemap(vector<std::string> faces, size_t *bytes = NULL);
+
+// deletes a texture made by loadTexture or loadCubemap, bytes being the
+// estimate they gave for it
+void deleteTexture(unsigned int texture, size_t bytes);
+
+// CPU side geometry of a mesh, produced before anything is sent to OpenGL
+struct MeshData {
+  vector<Vertex> vertices;
+  vector<unsigned int> indices;
+};
+
+// Converts an imported mesh into the engine's vertex layout. boneMap maps the
+// mesh's bones to skeleton indices (MAX_BONES for ignored bones). Doesn't
+// touch OpenGL, so meshes can be converted in parallel.
+void convertMesh(const aiMesh *mesh, const vector<unsigned int> &boneMap,
+                 MeshData &data);
+
+struct ObjScene;
+
+// A mesh imported by Model::import but not uploaded yet
+struct PendingMesh {
+  MeshData data;
+  vector<Texture> textures;
+  bool skinned;
+};
 
 class Model {
 public:
   vector<Texture> textures_loaded;
 
   vector<Mesh> meshes;
+  // the node hierarchy authored in the file, and the node each mesh hangs off
+  SceneGraph nodes;
+  vector<unsigned int> meshNodes;
+  map<string, unsigned int> nodeIndices;
+  // bones referenced by skinned meshes and the animations driving them, both
+  // empty for static models
+  Skeleton skeleton;
+  vector<AnimationClip> animations;
   string directory;
   bool gammaCorrection;
+  // whether the material textures are packed into materialArrays. Shaders
+  // drawing the model then need MATERIAL_ARRAYS_DEFINE.
+  bool textureArrays;
+  MaterialArrays materialArrays;
+
+  // loads the model right away, see import() and upload()
+  Model(string const &path, bool gamma = false, bool textureArrays = false);
+
+  // An empty model to be loaded in two steps: import() reads the file and
+  // decodes its textures without touching OpenGL, so it can run on any
+  // thread. upload() then creates the GL objects on the render thread. Set
+  // textureArrays before import() to pack the textures.
+  Model();
+  // releases the GL objects, if the model was uploaded
+  ~Model();
 
-  Model(string const &path, bool gamma = false);
+  // Returns false if the file can't be read. The parsing and the conversion
+  // of the meshes run on pool.
+  bool import(string const &path, JobPool &pool = sharedJobPool());
+  void upload();
 
-  void Draw(Shader shader);
+  // Deletes the GL objects of the meshes and textures. The model must not
+  // be drawn afterwards.
+  void release();
+
+  // estimated CPU memory held by the model: vertex and index copies, and
+  // decoded textures waiting for upload
+  size_t cpuBytes() const;
+  // estimated video memory, including mipmaps
+  size_t gpuBytes() const;
+
+  // draws every mesh with its node's world transform, relative to transform.
+  // Static meshes outside frustum, if given, are skipped.
+  void Draw(Shader shader, const glm::mat4 &transform = glm::mat4(1.0f),
+            const Frustum *frustum = NULL);
 
 private:
-  // loads a model with supported ASSIMP extensions from file and stores the
-  // resulting meshes in the meshes vector.
-  void loadModel(string const &path);
+  vector<PendingMesh> pendingMeshes;
+  vector<glm::ivec4> pendingLayers;
+  // video memory of the textures loaded without arrays
+  size_t textureBytes;
+
+  // reads a model with supported ASSIMP extensions from file into
+  // pendingMeshes, converting the meshes on pool
+  bool importAssimp(string const &path, JobPool &pool);
+
+  // takes over the meshes of a scene read by loadObj
+  void importObjScene(ObjScene &obj);
 
-  // processes a node in a recursive fashion. Processes each individual mesh
-  // located at the node and repeats this process on its children nodes (if
-  // any).
-  void processNode(aiNode *node, const aiScene *scene);
+  // processes a node in a recursive fashion. Records the node's transform
+  // below parent, collects each individual mesh located at the node and
+  // repeats this process on its children nodes (if any).
+  void processNode(aiNode *node, const aiScene *scene, int parent,
+                   vector<aiMesh *> &sceneMeshes);
 
-  Mesh processMesh(aiMesh *mesh, const aiScene *scene);
+  // loads the textures of the mesh's material
+  vector<Texture> loadMeshTextures(aiMesh *mesh, const aiScene *scene);
+
+  // adds the mesh's bones to the skeleton and returns their skeleton indices
+  vector<unsigned int> registerBones(aiMesh *mesh);
+
+  // resolves bones to scene graph nodes once the whole hierarchy is known
+  void resolveSkeleton();
+
+  // converts the scene's animations into clips keyed in seconds
+  void loadAnimations(const aiScene *scene);
 
   // checks all material textures of a given type and loads the textures if
   // they're not loaded yet. The required info is returned as a Texture struct.
   vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type,
                                        string typeName);
+
+  // records a texture file relative to the model's directory, or reuses the
+  // record if another material already did. upload() loads it.
+  Texture loadMaterialTexture(const string &file, const string &typeName);
 };
@@ -0,0 +1,634 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+
+#include "job_pool.h"
+#include "mesh.h"
+#include "obj_loader.h"
+
+// chunks are at least this large so that small files aren't split needlessly
+const size_t OBJ_MIN_CHUNK_SIZE = 1 << 20;
+
+namespace {
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+public:
+  const char *data;
+  size_t size;
+
+  explicit MappedFile(const std::string &path) : data(NULL), size(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+      void *mapping =
+          mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapping != MAP_FAILED) {
+        data = (const char *)mapping;
+        size = info.st_size;
+        madvise(mapping, size, MADV_SEQUENTIAL);
+      }
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (data) {
+      munmap((void *)data, size);
+    }
+  }
+
+private:
+  MappedFile(const MappedFile &);
+  MappedFile &operator=(const MappedFile &);
+};
+
+// 0 based indices of a face corner, -1 when the corner doesn't have one
+struct Corner {
+  int position;
+  int texCoord;
+  int normal;
+
+  bool operator==(const Corner &other) const {
+    return position == other.position && texCoord == other.texCoord &&
+           normal == other.normal;
+  }
+};
+
+// Consecutive triangles of a chunk sharing object and material. The first
+// run of a chunk continues whatever object and material the previous chunk
+// ended with, which is only known once all chunks are parsed.
+struct FaceRun {
+  std::string object;
+  std::string material;
+  bool objectSet;
+  bool materialSet;
+  std::vector<Corner> corners;
+
+  FaceRun() : objectSet(false), materialSet(false) {}
+};
+
+struct Chunk {
+  const char *begin;
+  const char *end;
+  // number of each attribute in the chunk, then the number before it
+  size_t positionCount, texCoordCount, normalCount;
+  size_t positionBase, texCoordBase, normalBase;
+  std::vector<FaceRun> runs;
+  std::vector<std::string> libraries;
+
+  Chunk()
+      : begin(NULL), end(NULL), positionCount(0), texCoordCount(0),
+        normalCount(0), positionBase(0), texCoordBase(0), normalBase(0) {}
+};
+
+} // namespace
+
+static inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+static inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+static inline const char *skipSpaces(const char *p, const char *end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+static inline const char *findLineEnd(const char *p, const char *end) {
+  const char *newline = (const char *)memchr(p, '\n', end - p);
+  return newline ? newline : end;
+}
+
+static double powerOfTen(int exponent) {
+  // powers of ten up to 1e22 are exact in a double
+  static const double exact[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                 1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                 1e18, 1e19, 1e20, 1e21, 1e22};
+  return exponent <= 22 ? exact[exponent] : std::pow(10.0, exponent);
+}
+
+// Parses a decimal float such as "-1.25e-3" without locale lookups or
+// allocations. Digits past the 19th only shift the exponent, more precision
+// than a float can hold anyway. Leaves value at 0 if there is no number.
+static const char *parseFloat(const char *p, const char *end, float &value) {
+  p = skipSpaces(p, end);
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  for (; p < end && isDigit(*p); p++) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && isDigit(*p); p++) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+    }
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char *q = p + 1;
+    bool negativeExponent = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      negativeExponent = *q == '-';
+      q++;
+    }
+    if (q < end && isDigit(*q)) {
+      int e = 0;
+      for (; q < end && isDigit(*q); q++) {
+        if (e < 10000) {
+          e = e * 10 + (*q - '0');
+        }
+      }
+      exponent += negativeExponent ? -e : e;
+      p = q;
+    }
+  }
+  double result = (double)mantissa;
+  if (exponent < 0) {
+    result /= powerOfTen(-exponent);
+  } else if (exponent > 0) {
+    result *= powerOfTen(exponent);
+  }
+  value = (float)(negative ? -result : result);
+  return p;
+}
+
+static const char *parseInt(const char *p, const char *end, int &value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  int result = 0;
+  for (; p < end && isDigit(*p); p++) {
+    result = result * 10 + (*p - '0');
+  }
+  value = negative ? -result : result;
+  return p;
+}
+
+// turns a 1 based, or negative relative, OBJ index into a 0 based one
+static inline int resolveIndex(int index, size_t count) {
+  if (index > 0) {
+    return index - 1;
+  }
+  if (index < 0) {
+    return (int)count + index;
+  }
+  return -1;
+}
+
+// rest of the line with surrounding whitespace removed
+static std::string lineArgument(const char *p, const char *end) {
+  p = skipSpaces(p, end);
+  while (end > p && isSpace(end[-1])) {
+    end--;
+  }
+  return std::string(p, end);
+}
+
+static inline bool startsWith(const char *p, const char *end,
+                              const char *keyword) {
+  size_t length = strlen(keyword);
+  return (size_t)(end - p) > length && memcmp(p, keyword, length) == 0 &&
+         isSpace(p[length]);
+}
+
+// counts the attributes in a chunk so that every chunk knows where its own
+// attributes start before faces are parsed
+static void countAttributes(Chunk &chunk) {
+  for (const char *p = chunk.begin; p < chunk.end;) {
+    const char *lineEnd = findLineEnd(p, chunk.end);
+    p = skipSpaces(p, lineEnd);
+    if (lineEnd - p > 2 && p[0] == 'v') {
+      if (isSpace(p[1])) {
+        chunk.positionCount++;
+      } else if (p[1] == 't' && isSpace(p[2])) {
+        chunk.texCoordCount++;
+      } else if (p[1] == 'n' && isSpace(p[2])) {
+        chunk.normalCount++;
+      }
+    }
+    p = lineEnd + 1;
+  }
+}
+
+static FaceRun &startRun(Chunk &chunk) {
+  if (chunk.runs.empty() || !chunk.runs.back().corners.empty()) {
+    chunk.runs.push_back(FaceRun());
+  }
+  return chunk.runs.back();
+}
+
+// Parses a chunk, writing its attributes at its bases in the shared arrays
+static void parseChunk(Chunk &chunk, float *positions, float *texCoords,
+                       float *normals) {
+  size_t positionCount = chunk.positionBase;
+  size_t texCoordCount = chunk.texCoordBase;
+  size_t normalCount = chunk.normalBase;
+  chunk.runs.push_back(FaceRun());
+  std::vector<Corner> polygon;
+
+  for (const char *p = chunk.begin; p < chunk.end;) {
+    const char *lineEnd = findLineEnd(p, chunk.end);
+    const char *line = skipSpaces(p, lineEnd);
+    p = lineEnd + 1;
+    if (line == lineEnd) {
+      continue;
+    }
+
+    if (line[0] == 'v' && lineEnd - line > 2) {
+      if (isSpace(line[1])) {
+        float *out = positions + 3 * positionCount++;
+        const char *q = parseFloat(line + 1, lineEnd, out[0]);
+        q = parseFloat(q, lineEnd, out[1]);
+        parseFloat(q, lineEnd, out[2]);
+      } else if (line[1] == 't' && isSpace(line[2])) {
+        float *out = texCoords + 2 * texCoordCount++;
+        const char *q = parseFloat(line + 2, lineEnd, out[0]);
+        parseFloat(q, lineEnd, out[1]);
+      } else if (line[1] == 'n' && isSpace(line[2])) {
+        float *out = normals + 3 * normalCount++;
+        const char *q = parseFloat(line + 2, lineEnd, out[0]);
+        q = parseFloat(q, lineEnd, out[1]);
+        parseFloat(q, lineEnd, out[2]);
+      }
+    } else if (line[0] == 'f' && lineEnd - line > 1 && isSpace(line[1])) {
+      polygon.clear();
+      const char *q = skipSpaces(line + 1, lineEnd);
+      while (q < lineEnd) {
+        int position = 0, texCoord = 0, normal = 0;
+        q = parseInt(q, lineEnd, position);
+        if (q < lineEnd && *q == '/') {
+          q++;
+          if (q < lineEnd && *q != '/') {
+            q = parseInt(q, lineEnd, texCoord);
+          }
+          if (q < lineEnd && *q == '/') {
+            q = parseInt(q + 1, lineEnd, normal);
+          }
+        }
+        // skip anything unexpected up to the next corner
+        while (q < lineEnd && !isSpace(*q)) {
+          q++;
+        }
+        q = skipSpaces(q, lineEnd);
+
+        Corner corner;
+        corner.position = resolveIndex(position, positionCount);
+        corner.texCoord = resolveIndex(texCoord, texCoordCount);
+        corner.normal = resolveIndex(normal, normalCount);
+        polygon.push_back(corner);
+      }
+      // triangulate as a fan
+      std::vector<Corner> &corners = chunk.runs.back().corners;
+      for (size_t i = 2; i < polygon.size(); i++) {
+        corners.push_back(polygon[0]);
+        corners.push_back(polygon[i - 1]);
+        corners.push_back(polygon[i]);
+      }
+    } else if (startsWith(line, lineEnd, "o") ||
+               startsWith(line, lineEnd, "g")) {
+      FaceRun &run = startRun(chunk);
+      run.object = lineArgument(line + 1, lineEnd);
+      run.objectSet = true;
+    } else if (startsWith(line, lineEnd, "usemtl")) {
+      FaceRun &run = startRun(chunk);
+      run.material = lineArgument(line + 6, lineEnd);
+      run.materialSet = true;
+    } else if (startsWith(line, lineEnd, "mtllib")) {
+      std::istringstream names(lineArgument(line + 6, lineEnd));
+      std::string name;
+      while (names >> name) {
+        chunk.libraries.push_back(name);
+      }
+    }
+  }
+}
+
+static void loadMaterialLibrary(const std::string &path,
+                                std::vector<ObjMaterial> &materials,
+                                std::map<std::string, int> &materialIndices) {
+  std::ifstream file(path.c_str());
+  if (!file) {
+    std::cout << "ERROR::OBJ:: can't open material library " << path
+              << std::endl;
+    return;
+  }
+  std::string line;
+  ObjMaterial *material = NULL;
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    std::string keyword;
+    if (!(stream >> keyword)) {
+      continue;
+    }
+    // map statements may carry options before the file name, which is last
+    std::string value, token;
+    while (stream >> token) {
+      value = token;
+    }
+    if (keyword == "newmtl") {
+      std::map<std::string, int>::iterator found = materialIndices.find(value);
+      if (found == materialIndices.end()) {
+        materialIndices[value] = materials.size();
+        materials.push_back(ObjMaterial());
+        material = &materials.back();
+        material->name = value;
+      } else {
+        material = &materials[found->second];
+      }
+    } else if (!material) {
+      continue;
+    } else if (keyword == "map_Kd") {
+      material->diffuseMap = value;
+    } else if (keyword == "map_Ks") {
+      material->specularMap = value;
+    } else if (keyword == "map_Bump" || keyword == "map_bump" ||
+               keyword == "bump") {
+      material->bumpMap = value;
+    } else if (keyword == "map_Ka") {
+      material->ambientMap = value;
+    }
+  }
+}
+
+static inline size_t hashCorner(const Corner &corner) {
+  uint64_t hash = (uint32_t)corner.position * 0x9E3779B97F4A7C15ull;
+  hash ^= (uint32_t)corner.texCoord * 0xC2B2AE3D27D4EB4Full;
+  hash ^= (uint32_t)corner.normal * 0x165667B19E3779F9ull;
+  return (size_t)(hash ^ (hash >> 29));
+}
+
+// Accumulates per triangle tangents and bitangents like Assimp's
+// aiProcess_CalcTangentSpace, then orthogonalizes them against the normals
+static void computeTangents(MeshData &data) {
+  std::vector<Vertex> &vertices = data.vertices;
+  const std::vector<unsigned int> &indices = data.indices;
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    Vertex &v0 = vertices[indices[i]];
+    Vertex &v1 = vertices[indices[i + 1]];
+    Vertex &v2 = vertices[indices[i + 2]];
+    glm::vec3 edge1 = v1.position - v0.position;
+    glm::vec3 edge2 = v2.position - v0.position;
+    glm::vec2 deltaUV1 = v1.texCoords - v0.texCoords;
+    glm::vec2 deltaUV2 = v2.texCoords - v0.texCoords;
+    float determinant = deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y;
+    if (std::fabs(determinant) < 1e-12f) {
+      continue;
+    }
+    float r = 1.0f / determinant;
+    glm::vec3 tangent = (edge1 * deltaUV2.y - edge2 * deltaUV1.y) * r;
+    glm::vec3 bitangent = (edge2 * deltaUV1.x - edge1 * deltaUV2.x) * r;
+    v0.tangent += tangent;
+    v1.tangent += tangent;
+    v2.tangent += tangent;
+    v0.bitangent += bitangent;
+    v1.bitangent += bitangent;
+    v2.bitangent += bitangent;
+  }
+  for (size_t i = 0; i < vertices.size(); i++) {
+    Vertex &vertex = vertices[i];
+    glm::vec3 tangent =
+        vertex.tangent - vertex.normal * glm::dot(vertex.normal, vertex.tangent);
+    if (glm::dot(tangent, tangent) > 0.0f) {
+      vertex.tangent = glm::normalize(tangent);
+    }
+    if (glm::dot(vertex.bitangent, vertex.bitangent) > 0.0f) {
+      vertex.bitangent = glm::normalize(vertex.bitangent);
+    }
+  }
+}
+
+// Merges identical corners of the mesh's runs into shared vertices with an
+// open addressing table. Returns false on an out of range index.
+static bool buildMesh(const std::vector<const FaceRun *> &runs,
+                      const std::vector<float> &positions,
+                      const std::vector<float> &texCoords,
+                      const std::vector<float> &normals, MeshData &data) {
+  size_t cornerCount = 0;
+  for (size_t i = 0; i < runs.size(); i++) {
+    cornerCount += runs[i]->corners.size();
+  }
+  size_t capacity = 16;
+  while (capacity < cornerCount * 2) {
+    capacity <<= 1;
+  }
+  const size_t mask = capacity - 1;
+  // vertex index + 1 of each slot, 0 for empty
+  std::vector<unsigned int> slots(capacity, 0);
+  std::vector<Corner> unique;
+  unique.reserve(cornerCount / 2);
+  data.indices.resize(cornerCount);
+  unsigned int *index = cornerCount ? &data.indices[0] : NULL;
+
+  for (size_t i = 0; i < runs.size(); i++) {
+    const std::vector<Corner> &corners = runs[i]->corners;
+    for (size_t j = 0; j < corners.size(); j++) {
+      const Corner &corner = corners[j];
+      size_t slot = hashCorner(corner) & mask;
+      while (slots[slot] && !(unique[slots[slot] - 1] == corner)) {
+        slot = (slot + 1) & mask;
+      }
+      if (!slots[slot]) {
+        unique.push_back(corner);
+        slots[slot] = unique.size();
+      }
+      *index++ = slots[slot] - 1;
+    }
+  }
+
+  const size_t positionCount = positions.size() / 3;
+  const size_t texCoordCount = texCoords.size() / 2;
+  const size_t normalCount = normals.size() / 3;
+  data.vertices.resize(unique.size());
+  for (size_t i = 0; i < unique.size(); i++) {
+    const Corner &corner = unique[i];
+    Vertex &vertex = data.vertices[i];
+    if (corner.position < 0 || (size_t)corner.position >= positionCount ||
+        corner.texCoord >= (int)texCoordCount ||
+        corner.normal >= (int)normalCount) {
+      return false;
+    }
+    const float *position = &positions[3 * corner.position];
+    vertex.position = glm::vec3(position[0], position[1], position[2]);
+    if (corner.normal >= 0) {
+      const float *normal = &normals[3 * corner.normal];
+      vertex.normal = glm::vec3(normal[0], normal[1], normal[2]);
+    } else {
+      vertex.normal = glm::vec3(0.0f);
+    }
+    if (corner.texCoord >= 0) {
+      const float *texCoord = &texCoords[2 * corner.texCoord];
+      vertex.texCoords = glm::vec2(texCoord[0], texCoord[1]);
+    } else {
+      vertex.texCoords = glm::vec2(0.0f, 0.0f);
+    }
+    vertex.tangent = glm::vec3(0.0f);
+    vertex.bitangent = glm::vec3(0.0f);
+    for (unsigned int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+      vertex.boneIds[k] = 0;
+      vertex.weights[k] = 0.0f;
+    }
+  }
+
+  // tangents use the uvs as authored, like Assimp computes them before
+  // aiProcess_FlipUVs
+  computeTangents(data);
+  for (size_t i = 0; i < data.vertices.size(); i++) {
+    data.vertices[i].texCoords.y = 1.0f - data.vertices[i].texCoords.y;
+  }
+  return true;
+}
+
+bool loadObj(const std::string &path, ObjScene &scene, JobPool &pool) {
+  MappedFile file(path);
+  if (!file.data) {
+    std::cout << "ERROR::OBJ:: can't read " << path << std::endl;
+    return false;
+  }
+
+  // split the file into line aligned chunks, a few per thread to even out
+  // differences in how long chunks take
+  size_t chunkCount = (pool.size() + 1) * 4;
+  chunkCount = std::max<size_t>(
+      1, std::min(chunkCount, file.size / OBJ_MIN_CHUNK_SIZE));
+  std::vector<Chunk> chunks(chunkCount);
+  const char *end = file.data + file.size;
+  const char *begin = file.data;
+  for (size_t i = 0; i < chunkCount; i++) {
+    const char *split =
+        i + 1 == chunkCount ? end : file.data + file.size * (i + 1) / chunkCount;
+    if (split < begin) {
+      split = begin;
+    }
+    if (split < end) {
+      split = findLineEnd(split, end);
+      split = split < end ? split + 1 : end;
+    }
+    chunks[i].begin = begin;
+    chunks[i].end = split;
+    begin = split;
+  }
+
+  pool.parallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      countAttributes(chunks[i]);
+    }
+  });
+  size_t positionCount = 0, texCoordCount = 0, normalCount = 0;
+  for (size_t i = 0; i < chunkCount; i++) {
+    chunks[i].positionBase = positionCount;
+    chunks[i].texCoordBase = texCoordCount;
+    chunks[i].normalBase = normalCount;
+    positionCount += chunks[i].positionCount;
+    texCoordCount += chunks[i].texCoordCount;
+    normalCount += chunks[i].normalCount;
+  }
+  std::vector<float> positions(3 * positionCount);
+  std::vector<float> texCoords(2 * texCoordCount);
+  std::vector<float> normals(3 * normalCount);
+  float *positionData = positions.empty() ? NULL : &positions[0];
+  float *texCoordData = texCoords.empty() ? NULL : &texCoords[0];
+  float *normalData = normals.empty() ? NULL : &normals[0];
+  pool.parallelFor(chunkCount, 1, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      parseChunk(chunks[i], positionData, texCoordData, normalData);
+    }
+  });
+
+  // materials are resolved up front so meshes can refer to them by index
+  size_t slash = path.find_last_of('/');
+  std::string directory =
+      slash == std::string::npos ? "." : path.substr(0, slash);
+  std::map<std::string, int> materialIndices;
+  for (size_t i = 0; i < chunkCount; i++) {
+    for (size_t j = 0; j < chunks[i].libraries.size(); j++) {
+      loadMaterialLibrary(directory + '/' + chunks[i].libraries[j],
+                          scene.materials, materialIndices);
+    }
+  }
+
+  // carry object and material over chunk boundaries and gather the runs of
+  // each mesh, in the order the meshes first appear
+  std::map<std::string, size_t> meshIndices;
+  std::vector<std::vector<const FaceRun *> > meshRuns;
+  std::string object, material;
+  for (size_t i = 0; i < chunkCount; i++) {
+    for (size_t j = 0; j < chunks[i].runs.size(); j++) {
+      const FaceRun &run = chunks[i].runs[j];
+      if (run.objectSet) {
+        object = run.object;
+      }
+      if (run.materialSet) {
+        material = run.material;
+      }
+      if (run.corners.empty()) {
+        continue;
+      }
+      std::string key = object + '\n' + material;
+      std::map<std::string, size_t>::iterator found = meshIndices.find(key);
+      if (found == meshIndices.end()) {
+        found = meshIndices.insert(std::make_pair(key, meshRuns.size())).first;
+        meshRuns.push_back(std::vector<const FaceRun *>());
+        ObjMesh mesh;
+        mesh.name = object;
+        std::map<std::string, int>::iterator materialIndex =
+            materialIndices.find(material);
+        mesh.material =
+            materialIndex == materialIndices.end() ? -1 : materialIndex->second;
+        scene.meshes.push_back(mesh);
+      }
+      meshRuns[found->second].push_back(&run);
+    }
+  }
+
+  std::atomic<bool> valid(true);
+  pool.parallelFor(meshRuns.size(), 1, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++) {
+      if (!buildMesh(meshRuns[i], positions, texCoords, normals,
+                     scene.meshes[i].data)) {
+        valid = false;
+      }
+    }
+  });
+  if (!valid) {
+    std::cout << "ERROR::OBJ:: face index out of range in " << path
+              << std::endl;
+    scene.meshes.clear();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "job_pool.h"
+#include "model.h"
+
+// Texture file names of a material from a .mtl library, relative to the
+// model's directory. Empty when the material has no such map.
+struct ObjMaterial {
+  std::string name;
+  std::string diffuseMap;  // map_Kd
+  std::string specularMap; // map_Ks
+  std::string bumpMap;     // map_Bump / bump
+  std::string ambientMap;  // map_Ka
+};
+
+// One mesh per run of faces sharing an object name and a material, the same
+// split Assimp's OBJ importer makes
+struct ObjMesh {
+  std::string name;
+  // index into ObjScene::materials, -1 without usemtl
+  int material;
+  MeshData data;
+};
+
+struct ObjScene {
+  std::vector<ObjMesh> meshes;
+  std::vector<ObjMaterial> materials;
+};
+
+// Loads a Wavefront .obj file and the material libraries it references,
+// without going through Assimp. The file is memory mapped and parsed in
+// line-aligned chunks on pool; identical position/uv/normal corners are
+// merged into one vertex and tangents are computed from the uvs. Faces are
+// triangulated as fans and uvs are flipped, matching the Assimp import
+// flags. Nothing here touches OpenGL. Returns false if the file can't be
+// read or uses something this loader doesn't handle (the caller then falls
+// back to Assimp).
+bool loadObj(const std::string &path, ObjScene &scene, JobPool &pool);
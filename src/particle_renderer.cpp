@@ -0,0 +1,141 @@
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include "particle_renderer.h"
+#include "particles.h"
+#include "telemetry.h"
+
+// corners of the quad drawn per particle, as a triangle strip
+static const float QUAD_CORNERS[] = {
+    -0.5f, -0.5f, //
+    0.5f,  -0.5f, //
+    -0.5f, 0.5f,  //
+    0.5f,  0.5f,  //
+};
+
+ParticleRenderer::ParticleRenderer(unsigned int maxParticles)
+    : maxParticles(maxParticles), persistentMapping(GLAD_GL_VERSION_4_4 != 0),
+      mapping(NULL), section(0), instances(0) {
+  for (unsigned int i = 0; i < PARTICLE_RING_FRAMES; i++) {
+    fences[i] = 0;
+  }
+  glGenVertexArrays(1, &VAO);
+  glGenBuffers(1, &quadVBO);
+  glGenBuffers(1, &ringBuffer);
+
+  glBindVertexArray(VAO);
+  glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(QUAD_CORNERS), QUAD_CORNERS,
+               GL_STATIC_DRAW);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                        (void *)0);
+
+  // the attribute pointer is set to the section drawn, see draw()
+  glBindBuffer(GL_ARRAY_BUFFER, ringBuffer);
+  GLsizeiptr ringBytes = sectionBytes() * PARTICLE_RING_FRAMES;
+  if (persistentMapping) {
+    glBufferStorage(GL_ARRAY_BUFFER, ringBytes, NULL,
+                    GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT);
+    mapping = static_cast<float *>(glMapBufferRange(
+        GL_ARRAY_BUFFER, 0, ringBytes,
+        GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+            GL_MAP_FLUSH_EXPLICIT_BIT));
+    if (mapping == NULL) {
+      std::cout << "ERROR::PARTICLES:: mapping the particle buffer failed"
+                << std::endl;
+    }
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, ringBytes, NULL, GL_STREAM_DRAW);
+  }
+  glEnableVertexAttribArray(PARTICLE_INSTANCE_ATTRIBUTE);
+  glVertexAttribDivisor(PARTICLE_INSTANCE_ATTRIBUTE, 1);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+
+  telemetry().meshBytes += sizeof(QUAD_CORNERS) + ringBytes;
+}
+
+ParticleRenderer::~ParticleRenderer() {
+  for (unsigned int i = 0; i < PARTICLE_RING_FRAMES; i++) {
+    if (fences[i]) {
+      glDeleteSync(fences[i]);
+    }
+  }
+  // deleting the buffer unmaps it
+  glDeleteVertexArrays(1, &VAO);
+  glDeleteBuffers(1, &quadVBO);
+  glDeleteBuffers(1, &ringBuffer);
+  telemetry().meshBytes -=
+      sizeof(QUAD_CORNERS) + sectionBytes() * PARTICLE_RING_FRAMES;
+}
+
+GLsizeiptr ParticleRenderer::sectionBytes() const {
+  return (GLsizeiptr)maxParticles * PARTICLE_INSTANCE_FLOATS * sizeof(float);
+}
+
+float *ParticleRenderer::beginFrame() {
+  GLsync &fence = fences[section];
+  if (fence) {
+    // a second is far longer than any frame, it only guards against hangs
+    GLenum result =
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    if (result == GL_WAIT_FAILED) {
+      std::cout << "ERROR::PARTICLES:: waiting for a particle fence failed"
+                << std::endl;
+    }
+    glDeleteSync(fence);
+    fence = 0;
+  }
+  if (persistentMapping) {
+    return mapping ? mapping + section * sectionBytes() / sizeof(float)
+                   : NULL;
+  }
+  // the fence already kept the GPU off this section
+  glBindBuffer(GL_ARRAY_BUFFER, ringBuffer);
+  float *written = static_cast<float *>(glMapBufferRange(
+      GL_ARRAY_BUFFER, section * sectionBytes(), sectionBytes(),
+      GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+          GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return written;
+}
+
+void ParticleRenderer::endFrame(unsigned int count) {
+  instances = count;
+  GLsizeiptr written =
+      (GLsizeiptr)count * PARTICLE_INSTANCE_FLOATS * sizeof(float);
+  glBindBuffer(GL_ARRAY_BUFFER, ringBuffer);
+  if (persistentMapping) {
+    if (mapping && written > 0) {
+      glFlushMappedBufferRange(GL_ARRAY_BUFFER, section * sectionBytes(),
+                               written);
+    }
+  } else {
+    if (written > 0) {
+      glFlushMappedBufferRange(GL_ARRAY_BUFFER, 0, written);
+    }
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void ParticleRenderer::draw() {
+  if (instances > 0) {
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, ringBuffer);
+    glVertexAttribPointer(
+        PARTICLE_INSTANCE_ATTRIBUTE, PARTICLE_INSTANCE_FLOATS, GL_FLOAT,
+        GL_FALSE, PARTICLE_INSTANCE_FLOATS * sizeof(float),
+        (void *)(section * sectionBytes()));
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, instances);
+    glBindVertexArray(0);
+    renderStats.drawCalls++;
+    renderStats.stateChanges++;
+    renderStats.triangles += 2 * (uint64_t)instances;
+  }
+  fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  section = (section + 1) % PARTICLE_RING_FRAMES;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include "particles.h"
+
+// frames of particles the renderer's ring holds: the CPU writes one while
+// the GPU may still be reading the two before
+const unsigned int PARTICLE_RING_FRAMES = 3;
+// the attribute the particle instances are read from, see
+// shaders/particle.vert
+const unsigned int PARTICLE_INSTANCE_ATTRIBUTE = 1;
+
+// Streams a ParticleSystem's instances to the GPU every frame and draws them
+// as camera facing quads. The instances go into a ring of
+// PARTICLE_RING_FRAMES sections in one buffer, each guarded by a fence set
+// after the draw reading it, so the CPU only waits if it gets a whole ring
+// ahead.
+//
+// With OpenGL 4.4 the buffer is mapped once and stays mapped; before that
+// each section is mapped unsynchronized as it is written, relying on the
+// fences in the same way.
+class ParticleRenderer {
+public:
+  explicit ParticleRenderer(unsigned int maxParticles);
+  ~ParticleRenderer();
+
+  // whether the ring stays mapped, see above
+  bool persistent() const { return persistentMapping; }
+
+  // Waits until the GPU is done with the next section of the ring and
+  // returns it, room for maxParticles instances of PARTICLE_INSTANCE_FLOATS
+  float *beginFrame();
+  // makes the first count instances written since beginFrame the ones drawn
+  void endFrame(unsigned int count);
+
+  // draws the instances of the last endFrame with the shader in use
+  void draw();
+
+private:
+  unsigned int maxParticles;
+  bool persistentMapping;
+  unsigned int VAO, quadVBO, ringBuffer;
+  // the whole ring, if persistent
+  float *mapping;
+  // the section being written or drawn, and the instances in it
+  unsigned int section;
+  unsigned int instances;
+  GLsync fences[PARTICLE_RING_FRAMES];
+
+  GLsizeiptr sectionBytes() const;
+
+  ParticleRenderer(const ParticleRenderer &);
+  ParticleRenderer &operator=(const ParticleRenderer &);
+};
@@ -0,0 +1,303 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "frame_arena.h"
+#include "job_pool.h"
+#include "particles.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PARTICLES_AVX 1
+#include <immintrin.h>
+#endif
+
+// rounds value up to a multiple of alignment, a power of two
+static uintptr_t alignUp(uintptr_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+// the arrays of one particle set, the next array a cache line multiple on
+static float *allocateArrays(unsigned int capacity, unsigned int arrays,
+                             float **out) {
+  size_t stride = alignUp(capacity * sizeof(float), CACHE_LINE_SIZE);
+  void *block = malloc(stride * arrays + CACHE_LINE_SIZE);
+  unsigned char *start = reinterpret_cast<unsigned char *>(
+      alignUp(reinterpret_cast<uintptr_t>(block), CACHE_LINE_SIZE));
+  for (unsigned int i = 0; i < arrays; i++) {
+    out[i] = reinterpret_cast<float *>(start + i * stride);
+  }
+  return static_cast<float *>(block);
+}
+
+ParticleSystem::ParticleSystem(unsigned int capacity)
+    : maxParticles(capacity), count(0),
+      survivors((capacity + PARTICLE_GRAIN - 1) / PARTICLE_GRAIN),
+      random(0x9e3779b9u) {
+  blocks[0] = allocateArrays(capacity, PARTICLE_ARRAYS, arrays);
+  blocks[1] = allocateArrays(capacity, PARTICLE_ARRAYS, packed);
+}
+
+ParticleSystem::~ParticleSystem() {
+  free(blocks[0]);
+  free(blocks[1]);
+}
+
+float ParticleSystem::randomSigned() {
+  random ^= random << 13;
+  random ^= random >> 17;
+  random ^= random << 5;
+  // the top 24 bits, as many as a float holds exactly
+  return (random >> 8) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+unsigned int ParticleSystem::emit(const ParticleEmitter &emitter,
+                                  unsigned int emitted) {
+  emitted = std::min(emitted, maxParticles - count);
+  for (unsigned int i = count; i < count + emitted; i++) {
+    arrays[PARTICLE_POSITION_X][i] =
+        emitter.position.x + emitter.extent.x * randomSigned();
+    arrays[PARTICLE_POSITION_Y][i] =
+        emitter.position.y + emitter.extent.y * randomSigned();
+    arrays[PARTICLE_POSITION_Z][i] =
+        emitter.position.z + emitter.extent.z * randomSigned();
+    arrays[PARTICLE_VELOCITY_X][i] =
+        emitter.velocity.x + emitter.velocitySpread.x * randomSigned();
+    arrays[PARTICLE_VELOCITY_Y][i] =
+        emitter.velocity.y + emitter.velocitySpread.y * randomSigned();
+    arrays[PARTICLE_VELOCITY_Z][i] =
+        emitter.velocity.z + emitter.velocitySpread.z * randomSigned();
+    float lifetime = emitter.minLifetime + (emitter.maxLifetime -
+                                            emitter.minLifetime) *
+                                               (randomSigned() + 1.0f) * 0.5f;
+    arrays[PARTICLE_LIFE][i] = 0.0f;
+    arrays[PARTICLE_LIFE_RATE][i] = 1.0f / std::max(lifetime, 1e-3f);
+  }
+  count += emitted;
+  return emitted;
+}
+
+// The arguments of the two passes of an update over the particles from
+// begin to end. The first ages the particles and counts those still alive,
+// the second moves the live ones and packs them from offset on.
+struct ParticleRange {
+  float *const *in;
+  float *const *out;
+  size_t begin;
+  size_t end;
+  size_t offset;
+  float stepTime;
+  glm::vec3 acceleration;
+  float *instances;
+};
+
+static unsigned int ageRange(const ParticleRange &range) {
+  float *life = range.in[PARTICLE_LIFE];
+  const float *rate = range.in[PARTICLE_LIFE_RATE];
+  unsigned int alive = 0;
+  for (size_t i = range.begin; i < range.end; i++) {
+    life[i] += range.stepTime * rate[i];
+    alive += life[i] < 1.0f;
+  }
+  return alive;
+}
+
+// moves particle i and, if it is alive, copies it to the next output slot
+static void packParticle(const ParticleRange &range, size_t i,
+                         size_t &slot) {
+  float *const *in = range.in;
+  const glm::vec3 &acceleration = range.acceleration;
+  float step = range.stepTime;
+  float vx = in[PARTICLE_VELOCITY_X][i] + acceleration.x * step;
+  float vy = in[PARTICLE_VELOCITY_Y][i] + acceleration.y * step;
+  float vz = in[PARTICLE_VELOCITY_Z][i] + acceleration.z * step;
+  float px = in[PARTICLE_POSITION_X][i] + vx * step;
+  float py = in[PARTICLE_POSITION_Y][i] + vy * step;
+  float pz = in[PARTICLE_POSITION_Z][i] + vz * step;
+  if (!(in[PARTICLE_LIFE][i] < 1.0f)) {
+    return;
+  }
+  float *const *out = range.out;
+  out[PARTICLE_POSITION_X][slot] = px;
+  out[PARTICLE_POSITION_Y][slot] = py;
+  out[PARTICLE_POSITION_Z][slot] = pz;
+  out[PARTICLE_VELOCITY_X][slot] = vx;
+  out[PARTICLE_VELOCITY_Y][slot] = vy;
+  out[PARTICLE_VELOCITY_Z][slot] = vz;
+  out[PARTICLE_LIFE][slot] = in[PARTICLE_LIFE][i];
+  out[PARTICLE_LIFE_RATE][slot] = in[PARTICLE_LIFE_RATE][i];
+  if (range.instances) {
+    float *instance = range.instances + slot * PARTICLE_INSTANCE_FLOATS;
+    instance[0] = px;
+    instance[1] = py;
+    instance[2] = pz;
+    instance[3] = in[PARTICLE_LIFE][i];
+  }
+  slot++;
+}
+
+static void packRange(const ParticleRange &range) {
+  size_t slot = range.offset;
+  for (size_t i = range.begin; i < range.end; i++) {
+    packParticle(range, i, slot);
+  }
+}
+
+#ifdef PARTICLES_AVX
+__attribute__((target("avx"))) static unsigned int
+ageRangeAvx(const ParticleRange &range) {
+  float *life = range.in[PARTICLE_LIFE];
+  const float *rate = range.in[PARTICLE_LIFE_RATE];
+  const __m256 step = _mm256_set1_ps(range.stepTime);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  unsigned int alive = 0;
+  size_t i = range.begin;
+  for (; i + 8 <= range.end; i += 8) {
+    __m256 aged = _mm256_add_ps(
+        _mm256_loadu_ps(life + i),
+        _mm256_mul_ps(step, _mm256_loadu_ps(rate + i)));
+    _mm256_storeu_ps(life + i, aged);
+    alive += __builtin_popcount(
+        _mm256_movemask_ps(_mm256_cmp_ps(aged, one, _CMP_LT_OQ)));
+  }
+  ParticleRange tail = range;
+  tail.begin = i;
+  return alive + ageRange(tail);
+}
+
+__attribute__((target("avx"))) static inline __m256
+loadAvx(float *const *arrays, ParticleArray array, size_t i) {
+  return _mm256_loadu_ps(arrays[array] + i);
+}
+
+// Stores 8 particles' positions and lives as the 8 instances they make up.
+// Pairs are interleaved to [x y z life] within each 128-bit half, then the
+// halves are put in order.
+__attribute__((target("avx"))) static inline void
+storeInstancesAvx(float *out, __m256 x, __m256 y, __m256 z, __m256 life) {
+  __m256 xy0 = _mm256_unpacklo_ps(x, y);
+  __m256 xy1 = _mm256_unpackhi_ps(x, y);
+  __m256 zl0 = _mm256_unpacklo_ps(z, life);
+  __m256 zl1 = _mm256_unpackhi_ps(z, life);
+  // particles 0 and 4, 1 and 5, 2 and 6, 3 and 7
+  __m256 p04 = _mm256_shuffle_ps(xy0, zl0, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 p15 = _mm256_shuffle_ps(xy0, zl0, _MM_SHUFFLE(3, 2, 3, 2));
+  __m256 p26 = _mm256_shuffle_ps(xy1, zl1, _MM_SHUFFLE(1, 0, 1, 0));
+  __m256 p37 = _mm256_shuffle_ps(xy1, zl1, _MM_SHUFFLE(3, 2, 3, 2));
+  _mm256_storeu_ps(out, _mm256_permute2f128_ps(p04, p15, 0x20));
+  _mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(p26, p37, 0x20));
+  _mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(p04, p15, 0x31));
+  _mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(p26, p37, 0x31));
+}
+
+// Moves 8 particles at a time. Where all 8 live, as in most groups since
+// particles die a few at a time, they are stored as vectors; otherwise the
+// live ones are copied one by one.
+__attribute__((target("avx"))) static void
+packRangeAvx(const ParticleRange &range) {
+  float *const *in = range.in;
+  float *const *out = range.out;
+  const __m256 step = _mm256_set1_ps(range.stepTime);
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 ax = _mm256_set1_ps(range.acceleration.x * range.stepTime);
+  const __m256 ay = _mm256_set1_ps(range.acceleration.y * range.stepTime);
+  const __m256 az = _mm256_set1_ps(range.acceleration.z * range.stepTime);
+  size_t slot = range.offset;
+  size_t i = range.begin;
+  for (; i + 8 <= range.end; i += 8) {
+    __m256 life = loadAvx(in, PARTICLE_LIFE, i);
+    int alive = _mm256_movemask_ps(_mm256_cmp_ps(life, one, _CMP_LT_OQ));
+    if (alive != 0xff) {
+      for (size_t j = i; j < i + 8; j++) {
+        packParticle(range, j, slot);
+      }
+      continue;
+    }
+    __m256 vx = _mm256_add_ps(loadAvx(in, PARTICLE_VELOCITY_X, i), ax);
+    __m256 vy = _mm256_add_ps(loadAvx(in, PARTICLE_VELOCITY_Y, i), ay);
+    __m256 vz = _mm256_add_ps(loadAvx(in, PARTICLE_VELOCITY_Z, i), az);
+    __m256 px = _mm256_add_ps(loadAvx(in, PARTICLE_POSITION_X, i),
+                              _mm256_mul_ps(vx, step));
+    __m256 py = _mm256_add_ps(loadAvx(in, PARTICLE_POSITION_Y, i),
+                              _mm256_mul_ps(vy, step));
+    __m256 pz = _mm256_add_ps(loadAvx(in, PARTICLE_POSITION_Z, i),
+                              _mm256_mul_ps(vz, step));
+    _mm256_storeu_ps(out[PARTICLE_POSITION_X] + slot, px);
+    _mm256_storeu_ps(out[PARTICLE_POSITION_Y] + slot, py);
+    _mm256_storeu_ps(out[PARTICLE_POSITION_Z] + slot, pz);
+    _mm256_storeu_ps(out[PARTICLE_VELOCITY_X] + slot, vx);
+    _mm256_storeu_ps(out[PARTICLE_VELOCITY_Y] + slot, vy);
+    _mm256_storeu_ps(out[PARTICLE_VELOCITY_Z] + slot, vz);
+    _mm256_storeu_ps(out[PARTICLE_LIFE] + slot, life);
+    _mm256_storeu_ps(out[PARTICLE_LIFE_RATE] + slot,
+                     loadAvx(in, PARTICLE_LIFE_RATE, i));
+    if (range.instances) {
+      storeInstancesAvx(range.instances + slot * PARTICLE_INSTANCE_FLOATS,
+                        px, py, pz, life);
+    }
+    slot += 8;
+  }
+  for (; i < range.end; i++) {
+    packParticle(range, i, slot);
+  }
+}
+#endif
+
+void ParticleSystem::update(float stepTime, const glm::vec3 &acceleration,
+                            JobPool &pool, float *instances) {
+  if (count == 0) {
+    return;
+  }
+#ifdef PARTICLES_AVX
+  static const bool avx = __builtin_cpu_supports("avx");
+#endif
+  ParticleRange common;
+  common.in = arrays;
+  common.out = packed;
+  common.offset = 0;
+  common.stepTime = stepTime;
+  common.acceleration = acceleration;
+  common.instances = instances;
+
+  unsigned int *alive = &survivors[0];
+  pool.parallelFor(count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+    ParticleRange range = common;
+    range.begin = begin;
+    range.end = end;
+#ifdef PARTICLES_AVX
+    if (avx) {
+      alive[begin / PARTICLE_GRAIN] = ageRangeAvx(range);
+      return;
+    }
+#endif
+    alive[begin / PARTICLE_GRAIN] = ageRange(range);
+  });
+
+  // where each range's live particles go, after those of the ranges before
+  size_t ranges = (count + PARTICLE_GRAIN - 1) / PARTICLE_GRAIN;
+  size_t live = 0;
+  for (size_t i = 0; i < ranges; i++) {
+    unsigned int rangeAlive = alive[i];
+    alive[i] = live;
+    live += rangeAlive;
+  }
+
+  pool.parallelFor(count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+    ParticleRange range = common;
+    range.begin = begin;
+    range.end = end;
+    range.offset = alive[begin / PARTICLE_GRAIN];
+#ifdef PARTICLES_AVX
+    if (avx) {
+      packRangeAvx(range);
+      return;
+    }
+#endif
+    packRange(range);
+  });
+
+  std::swap(arrays, packed);
+  count = live;
+}
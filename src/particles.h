@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "job_pool.h"
+
+// particles updated per job, a multiple of the 8 handled at once with AVX
+const size_t PARTICLE_GRAIN = 16384;
+// floats per particle in the instance data written by update: the position
+// and how far through its life the particle is, from 0 to 1
+const unsigned int PARTICLE_INSTANCE_FLOATS = 4;
+
+// the arrays a ParticleSystem keeps, one value of each particle in each
+enum ParticleArray {
+  PARTICLE_POSITION_X,
+  PARTICLE_POSITION_Y,
+  PARTICLE_POSITION_Z,
+  PARTICLE_VELOCITY_X,
+  PARTICLE_VELOCITY_Y,
+  PARTICLE_VELOCITY_Z,
+  // how far through its life the particle is, dead from 1 on
+  PARTICLE_LIFE,
+  // life gained per second, the inverse of the lifetime
+  PARTICLE_LIFE_RATE,
+  PARTICLE_ARRAYS
+};
+
+// Where new particles start and how they move off
+struct ParticleEmitter {
+  glm::vec3 position;
+  // particles start anywhere in the box this far around position
+  glm::vec3 extent;
+  glm::vec3 velocity;
+  // up to this much is added to or taken from velocity along each axis
+  glm::vec3 velocitySpread;
+  float minLifetime;
+  float maxLifetime;
+};
+
+// Particles kept as a structure of arrays, one array per coordinate, so an
+// update reads and writes them in long runs that AVX handles 8 at a time.
+// Live particles are packed at the front: update drops the dead ones while
+// moving the rest into a second set of arrays, and emit appends to the end,
+// so neither allocates.
+class ParticleSystem {
+public:
+  explicit ParticleSystem(unsigned int capacity);
+  ~ParticleSystem();
+
+  unsigned int size() const { return count; }
+  unsigned int capacity() const { return maxParticles; }
+
+  // Adds up to count particles from emitter, as many as there is room for,
+  // and returns how many were added
+  unsigned int emit(const ParticleEmitter &emitter, unsigned int count);
+
+  // Moves the particles on by stepTime under acceleration, such as gravity,
+  // and removes those at the end of their lifetime. If instances isn't NULL,
+  // the remaining particles are also written to it, PARTICLE_INSTANCE_FLOATS
+  // each, in order. Split across pool, using AVX when the CPU supports it.
+  void update(float stepTime, const glm::vec3 &acceleration, JobPool &pool,
+              float *instances = NULL);
+
+  // one value of each live particle, in order
+  const float *values(ParticleArray array) const { return arrays[array]; }
+
+private:
+  unsigned int maxParticles;
+  unsigned int count;
+  // the live particles, and those update packs them into
+  float *arrays[PARTICLE_ARRAYS];
+  float *packed[PARTICLE_ARRAYS];
+  void *blocks[2];
+  // live particles in each range of PARTICLE_GRAIN after aging them
+  std::vector<unsigned int> survivors;
+  // xorshift state for emitting
+  uint32_t random;
+
+  // uniform in [-1, 1]
+  float randomSigned();
+
+  ParticleSystem(const ParticleSystem &);
+  ParticleSystem &operator=(const ParticleSystem &);
+};
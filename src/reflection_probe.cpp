@@ -0,0 +1,103 @@
+#include <functional>
+#include <iostream>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "reflection_probe.h"
+#include "telemetry.h"
+
+// view direction and up vector of each face, in the order of
+// GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, following the cubemap conventions
+static const glm::vec3 FACE_DIRECTIONS[6] = {
+    glm::vec3(1.0f, 0.0f, 0.0f),  glm::vec3(-1.0f, 0.0f, 0.0f),
+    glm::vec3(0.0f, 1.0f, 0.0f),  glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f)};
+static const glm::vec3 FACE_UPS[6] = {
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f),
+    glm::vec3(0.0f, 0.0f, 1.0f),  glm::vec3(0.0f, 0.0f, -1.0f),
+    glm::vec3(0.0f, -1.0f, 0.0f), glm::vec3(0.0f, -1.0f, 0.0f)};
+
+ReflectionProbe::ReflectionProbe(const glm::vec3 &position, int size)
+    : position(position), size(size), mipLevels(1), nextFace(0),
+      complete(false) {
+  while ((size >> mipLevels) > 0) {
+    mipLevels++;
+  }
+
+  glGenTextures(1, &cubemap);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+  for (int level = 0; level < mipLevels; level++) {
+    int levelSize = size >> level;
+    for (unsigned int i = 0; i < 6; i++) {
+      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, level, GL_RGBA8,
+                   levelSize, levelSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    }
+  }
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                  GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+  // blurry levels would show the face edges otherwise
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+
+  glGenRenderbuffers(1, &depth);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &FBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                         GL_TEXTURE_CUBE_MAP_POSITIVE_X, cubemap, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+    std::cout << "ERROR::FRAMEBUFFER:: Reflection probe is not complete!"
+              << std::endl;
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  telemetry().textures++;
+  telemetry().textureBytes += (int64_t)size * size * 6 * 4 * 4 / 3;
+}
+
+ReflectionProbe::~ReflectionProbe() {
+  glDeleteFramebuffers(1, &FBO);
+  glDeleteRenderbuffers(1, &depth);
+  glDeleteTextures(1, &cubemap);
+  telemetry().textures--;
+  telemetry().textureBytes -= (int64_t)size * size * 6 * 4 * 4 / 3;
+}
+
+void ReflectionProbe::renderNextFace(
+    const std::function<void(const glm::mat4 &, const glm::mat4 &)>
+        &drawScene) {
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                         GL_TEXTURE_CUBE_MAP_POSITIVE_X + nextFace, cubemap,
+                         0);
+  glViewport(0, 0, size, size);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  glm::mat4 view =
+      glm::lookAt(position, position + FACE_DIRECTIONS[nextFace],
+                  FACE_UPS[nextFace]);
+  glm::mat4 projection = glm::perspective(
+      glm::radians(90.0f), 1.0f, REFLECTION_PROBE_NEAR, REFLECTION_PROBE_FAR);
+  drawScene(view, projection);
+
+  nextFace++;
+  if (nextFace == 6) {
+    // a box filtered chain, a cheap stand-in for convolving each level
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+    glGenerateMipmap(GL_TEXTURE_CUBE_MAP);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    nextFace = 0;
+    complete = true;
+  }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <functional>
+
+#include <glm/glm.hpp>
+
+// Edge length of a probe's cubemap faces
+const int REFLECTION_PROBE_SIZE = 256;
+// Clip planes the probe renders its surroundings with
+const float REFLECTION_PROBE_NEAR = 0.1f;
+const float REFLECTION_PROBE_FAR = 50.0f;
+
+// An environment cubemap rendered from a point in the scene, for reflective
+// and refractive objects to sample instead of the static skybox. Only one
+// face is rendered per call, which bounds the per-frame cost at the price
+// of a six frame delay. The mip chain is rebuilt whenever all six faces
+// have been refreshed, so rough surfaces can sample blurrier levels.
+class ReflectionProbe {
+public:
+  glm::vec3 position;
+  // GL_TEXTURE_CUBE_MAP with a full mip chain
+  unsigned int cubemap;
+
+  explicit ReflectionProbe(const glm::vec3 &position,
+                           int size = REFLECTION_PROBE_SIZE);
+  ~ReflectionProbe();
+
+  // Renders the next face by calling drawScene(view, projection) into it,
+  // with the face's framebuffer bound and cleared. Leaves that framebuffer
+  // and viewport bound.
+  void renderNextFace(
+      const std::function<void(const glm::mat4 &, const glm::mat4 &)>
+          &drawScene);
+
+  // whether every face has been rendered at least once
+  bool ready() const { return complete; }
+
+  // highest mip level, for textureLod
+  float maxLod() const { return (float)(mipLevels - 1); }
+
+private:
+  unsigned int FBO;
+  unsigned int depth;
+  int size;
+  int mipLevels;
+  unsigned int nextFace;
+  bool complete;
+
+  ReflectionProbe(const ReflectionProbe &);
+  ReflectionProbe &operator=(const ReflectionProbe &);
+};
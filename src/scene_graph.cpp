@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <vector>
+
+#include <glm/glm.hpp>
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+
+#include "scene_graph.h"
+
+void multiplyMatrices(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+#if defined(__SSE__)
+  const float *left = &a[0][0];
+  const float *right = &b[0][0];
+  float *result = &out[0][0];
+  __m128 a0 = _mm_loadu_ps(left);
+  __m128 a1 = _mm_loadu_ps(left + 4);
+  __m128 a2 = _mm_loadu_ps(left + 8);
+  __m128 a3 = _mm_loadu_ps(left + 12);
+  // column j of the result is a's columns weighted by column j of b
+  for (int j = 0; j < 4; j++) {
+    __m128 column = _mm_mul_ps(a0, _mm_set1_ps(right[j * 4 + 0]));
+    column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(right[j * 4 + 1])));
+    column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(right[j * 4 + 2])));
+    column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(right[j * 4 + 3])));
+    _mm_storeu_ps(result + j * 4, column);
+  }
+#else
+  out = a * b;
+#endif
+}
+
+SceneGraph::SceneGraph() : firstDirty(0) {}
+
+unsigned int SceneGraph::addNode(int parent, const glm::mat4 &local) {
+  unsigned int node = parents.size();
+  parents.push_back(parent);
+  locals.push_back(local);
+  worlds.push_back(local);
+  dirty.push_back(1);
+  firstDirty = std::min(firstDirty, node);
+  return node;
+}
+
+void SceneGraph::reserve(unsigned int count) {
+  parents.reserve(count);
+  locals.reserve(count);
+  worlds.reserve(count);
+  dirty.reserve(count);
+}
+
+void SceneGraph::setLocal(unsigned int node, const glm::mat4 &local) {
+  locals[node] = local;
+  dirty[node] = 1;
+  firstDirty = std::min(firstDirty, node);
+}
+
+void SceneGraph::update() {
+  unsigned int count = parents.size();
+  for (unsigned int i = firstDirty; i < count; i++) {
+    int parent = parents[i];
+    // parents come first, so their flag is final by the time we get here and
+    // dirtiness flows down to the whole subtree
+    if (parent != NO_PARENT && dirty[parent]) {
+      dirty[i] = 1;
+    }
+    if (!dirty[i]) {
+      continue;
+    }
+    if (parent == NO_PARENT) {
+      worlds[i] = locals[i];
+    } else {
+      multiplyMatrices(worlds[parent], locals[i], worlds[i]);
+    }
+  }
+  std::fill(dirty.begin() + std::min(firstDirty, count), dirty.end(), 0);
+  firstDirty = count;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Computes out = a * b for column-major 4x4 matrices using SSE where
+// available. out may alias neither a nor b.
+void multiplyMatrices(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out);
+
+// A transform hierarchy stored as a structure of arrays. Nodes are kept in
+// topological order (a parent always precedes its children), so world
+// transforms are propagated in a single forward pass over contiguous arrays.
+// Only nodes whose local transform changed, and their descendants, are
+// recomputed by update().
+class SceneGraph {
+public:
+  static const int NO_PARENT = -1;
+
+  SceneGraph();
+
+  // Adds a node below parent (or a root if NO_PARENT) and returns its index.
+  // The parent must already exist, which keeps the arrays topologically
+  // sorted.
+  unsigned int addNode(int parent, const glm::mat4 &local = glm::mat4(1.0f));
+
+  void reserve(unsigned int count);
+
+  void setLocal(unsigned int node, const glm::mat4 &local);
+
+  const glm::mat4 &getLocal(unsigned int node) const { return locals[node]; }
+
+  // Only valid for clean nodes, i.e. after update()
+  const glm::mat4 &getWorld(unsigned int node) const { return worlds[node]; }
+
+  int getParent(unsigned int node) const { return parents[node]; }
+
+  unsigned int size() const { return parents.size(); }
+
+  // Propagates local transform changes to the world transforms of the changed
+  // nodes and their subtrees
+  void update();
+
+private:
+  std::vector<int> parents;
+  std::vector<glm::mat4> locals;
+  std::vector<glm::mat4> worlds;
+  // not vector<bool>: bytes are cheaper to test and write in the update loop
+  std::vector<unsigned char> dirty;
+  // lowest dirty index, nothing before it needs to be visited
+  unsigned int firstDirty;
+};
@@ -7,9 +7,11 @@
 #include <glm/glm.hpp>
 
 #include "shader.h"
+#include "telemetry.h"
 
 const std::string VERTEX = "VERTEX";
 const std::string FRAGMENT = "FRAGMENT";
+const std::string COMPUTE = "COMPUTE";
 const std::string PROGRAM = "PROGRAM";
 
 void checkCompileErrors(unsigned int shader, std::string type) {
@@ -37,7 +39,21 @@ void checkCompileErrors(unsigned int shader, std::string type) {
   }
 }
 
-Shader::Shader(const char *vertexPath, const char *fragmentPath) {
+// the #version directive has to stay the first line
+static std::string insertDefines(const std::string &code,
+                                 const std::string &defines) {
+  if (defines.empty()) {
+    return code;
+  }
+  size_t lineEnd = code.find('\n');
+  if (lineEnd == std::string::npos) {
+    return code + "\n" + defines;
+  }
+  return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+}
+
+Shader::Shader(const char *vertexPath, const char *fragmentPath,
+               const std::string &defines) {
   std::ifstream vShaderFile;
   std::ifstream fShaderFile;
   vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -52,8 +68,8 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath) {
     fShaderStream << fShaderFile.rdbuf();
     vShaderFile.close();
     fShaderFile.close();
-    vertexCode = vShaderStream.str();
-    fragmentCode = fShaderStream.str();
+    vertexCode = insertDefines(vShaderStream.str(), defines);
+    fragmentCode = insertDefines(fShaderStream.str(), defines);
   } catch (std::ifstream::failure e) {
     std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
   }
@@ -78,58 +94,91 @@ Shader::Shader(const char *vertexPath, const char *fragmentPath) {
 
   glDeleteShader(vertex);
   glDeleteShader(fragment);
+  telemetry().programs++;
+}
+
+Shader::Shader(const char *computePath) {
+  std::ifstream cShaderFile;
+  cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+  std::string computeCode;
+  try {
+    cShaderFile.open(computePath);
+    std::stringstream cShaderStream;
+    cShaderStream << cShaderFile.rdbuf();
+    cShaderFile.close();
+    computeCode = cShaderStream.str();
+  } catch (const std::ifstream::failure &e) {
+    std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+  }
+  const char *cShaderCode = computeCode.c_str();
+
+  unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+  glShaderSource(compute, 1, &cShaderCode, NULL);
+  glCompileShader(compute);
+  checkCompileErrors(compute, COMPUTE);
+
+  ID = glCreateProgram();
+  glAttachShader(ID, compute);
+  glLinkProgram(ID);
+  checkCompileErrors(ID, PROGRAM);
+
+  glDeleteShader(compute);
+  telemetry().programs++;
 }
 
-void Shader::use() { glUseProgram(ID); }
+void Shader::use() {
+  glUseProgram(ID);
+  renderStats.stateChanges++;
+}
 
-void Shader::setBool(const std::string &name, bool value) const {
-  glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+void Shader::setBool(const char *name, bool value) const {
+  glUniform1i(glGetUniformLocation(ID, name), (int)value);
 }
 
-void Shader::setInt(const std::string &name, int value) const {
-  glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setInt(const char *name, int value) const {
+  glUniform1i(glGetUniformLocation(ID, name), value);
 }
 
-void Shader::setFloat(const std::string &name, float value) const {
-  glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+void Shader::setFloat(const char *name, float value) const {
+  glUniform1f(glGetUniformLocation(ID, name), value);
 }
 
-void Shader::setVec2(const std::string &name, const glm::vec2 &value) const {
-  glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void Shader::setVec2(const char *name, const glm::vec2 &value) const {
+  glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
 }
 
-void Shader::setVec2(const std::string &name, float x, float y) const {
-  glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+void Shader::setVec2(const char *name, float x, float y) const {
+  glUniform2f(glGetUniformLocation(ID, name), x, y);
 }
 
-void Shader::setVec3(const std::string &name, const glm::vec3 &value) const {
-  glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void Shader::setVec3(const char *name, const glm::vec3 &value) const {
+  glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
 }
 
-void Shader::setVec3(const std::string &name, float x, float y, float z) const {
-  glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+void Shader::setVec3(const char *name, float x, float y, float z) const {
+  glUniform3f(glGetUniformLocation(ID, name), x, y, z);
 }
 
-void Shader::setVec4(const std::string &name, const glm::vec4 &value) const {
-  glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+void Shader::setVec4(const char *name, const glm::vec4 &value) const {
+  glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
 }
 
-void Shader::setVec4(const std::string &name, float x, float y, float z,
+void Shader::setVec4(const char *name, float x, float y, float z,
                      float w) const {
-  glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+  glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
 }
 
-void Shader::setMat2(const std::string &name, const glm::mat2 &mat) const {
-  glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+void Shader::setMat2(const char *name, const glm::mat2 &mat) const {
+  glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE,
                      &mat[0][0]);
 }
 
-void Shader::setMat3(const std::string &name, const glm::mat3 &mat) const {
-  glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+void Shader::setMat3(const char *name, const glm::mat3 &mat) const {
+  glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE,
                      &mat[0][0]);
 }
 
-void Shader::setMat4(const std::string &name, const glm::mat4 &mat) const {
-  glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
+void Shader::setMat4(const char *name, const glm::mat4 &mat) const {
+  glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE,
                      &mat[0][0]);
 }
@@ -11,21 +11,26 @@
 class Shader {
 public:
   unsigned int ID;
-  Shader(const char *vertexPath, const char *fragmentPath);
+  // defines are inserted after the #version line of both stages, e.g.
+  // "#define MATERIAL_ARRAYS\n"
+  Shader(const char *vertexPath, const char *fragmentPath,
+         const std::string &defines = "");
+  // a compute program, needs OpenGL 4.3
+  explicit Shader(const char *computePath);
   void use();
-  void setBool(const std::string &name, bool value) const;
-  void setInt(const std::string &name, int value) const;
-  void setFloat(const std::string &name, float value) const;
-  void setVec2(const std::string &name, const glm::vec2 &value) const;
-  void setVec2(const std::string &name, float x, float y) const;
-  void setVec3(const std::string &name, const glm::vec3 &value) const;
-  void setVec3(const std::string &name, float x, float y, float z) const;
-  void setVec4(const std::string &name, const glm::vec4 &value) const;
-  void setVec4(const std::string &name, float x, float y, float z,
+  void setBool(const char *name, bool value) const;
+  void setInt(const char *name, int value) const;
+  void setFloat(const char *name, float value) const;
+  void setVec2(const char *name, const glm::vec2 &value) const;
+  void setVec2(const char *name, float x, float y) const;
+  void setVec3(const char *name, const glm::vec3 &value) const;
+  void setVec3(const char *name, float x, float y, float z) const;
+  void setVec4(const char *name, const glm::vec4 &value) const;
+  void setVec4(const char *name, float x, float y, float z,
                float w) const;
-  void setMat2(const std::string &name, const glm::mat2 &mat) const;
-  void setMat3(const std::string &name, const glm::mat3 &mat) const;
-  void setMat4(const std::string &name, const glm::mat4 &mat) const;
+  void setMat2(const char *name, const glm::mat2 &mat) const;
+  void setMat3(const char *name, const glm::mat3 &mat) const;
+  void setMat4(const char *name, const glm::mat4 &mat) const;
 
 private:
 };
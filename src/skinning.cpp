@@ -0,0 +1,170 @@
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "job_pool.h"
+#include "mesh.h"
+#include "model.h"
+#include "skinning.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SKINNING_AVX 1
+#include <immintrin.h>
+#endif
+
+// vertices skinned per job
+const size_t SKINNING_GRAIN = 2048;
+
+static void finishVertex(const Vertex &in, Vertex &out) {
+  out.texCoords = in.texCoords;
+  for (unsigned int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+    out.boneIds[k] = 0;
+    out.weights[k] = 0.0f;
+  }
+}
+
+// whether an influence counts, ids outside the palette would read past it
+static inline bool influences(const Vertex &vertex, unsigned int k,
+                              size_t boneCount) {
+  return vertex.weights[k] != 0.0f && vertex.boneIds[k] >= 0 &&
+         (size_t)vertex.boneIds[k] < boneCount;
+}
+
+static void skinRange(const Vertex *in, const glm::mat4 *bones,
+                      size_t boneCount, Vertex *out, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const Vertex &vertex = in[i];
+    glm::mat4 skin(0.0f);
+    float total = 0.0f;
+    for (unsigned int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+      if (influences(vertex, k, boneCount)) {
+        skin += bones[vertex.boneIds[k]] * vertex.weights[k];
+        total += vertex.weights[k];
+      }
+    }
+    if (total == 0.0f) {
+      skin = glm::mat4(1.0f);
+    }
+    out[i].position = glm::vec3(skin * glm::vec4(vertex.position, 1.0f));
+    out[i].normal = glm::vec3(skin * glm::vec4(vertex.normal, 0.0f));
+    out[i].tangent = glm::vec3(skin * glm::vec4(vertex.tangent, 0.0f));
+    out[i].bitangent = glm::vec3(skin * glm::vec4(vertex.bitangent, 0.0f));
+    finishVertex(vertex, out[i]);
+  }
+}
+
+#ifdef SKINNING_AVX
+// The blended matrix is kept in two registers holding columns [0|1] and
+// [2|3]. Transforming a vector multiplies them by [x|y] and [z|w] and adds
+// the two 128-bit halves.
+__attribute__((target("avx"))) static inline glm::vec3
+transformAvx(__m256 columns01, __m256 columns23, const glm::vec3 &v,
+             float w) {
+  __m256 xy = _mm256_setr_ps(v.x, v.x, v.x, v.x, v.y, v.y, v.y, v.y);
+  __m256 zw = _mm256_setr_ps(v.z, v.z, v.z, v.z, w, w, w, w);
+  __m256 sum = _mm256_add_ps(_mm256_mul_ps(columns01, xy),
+                             _mm256_mul_ps(columns23, zw));
+  __m128 result = _mm_add_ps(_mm256_castps256_ps128(sum),
+                             _mm256_extractf128_ps(sum, 1));
+  float values[4];
+  _mm_storeu_ps(values, result);
+  return glm::vec3(values[0], values[1], values[2]);
+}
+
+__attribute__((target("avx"))) static void
+skinRangeAvx(const Vertex *in, const glm::mat4 *bones, size_t boneCount,
+             Vertex *out, size_t count) {
+  const __m256 identity01 = _mm256_setr_ps(1, 0, 0, 0, 0, 1, 0, 0);
+  const __m256 identity23 = _mm256_setr_ps(0, 0, 1, 0, 0, 0, 0, 1);
+  for (size_t i = 0; i < count; i++) {
+    const Vertex &vertex = in[i];
+    __m256 columns01 = _mm256_setzero_ps();
+    __m256 columns23 = _mm256_setzero_ps();
+    float total = 0.0f;
+    for (unsigned int k = 0; k < MAX_BONE_INFLUENCE; k++) {
+      if (!influences(vertex, k, boneCount)) {
+        continue;
+      }
+      float weight = vertex.weights[k];
+      const float *bone = &bones[vertex.boneIds[k]][0][0];
+      __m256 w = _mm256_set1_ps(weight);
+      columns01 =
+          _mm256_add_ps(columns01, _mm256_mul_ps(w, _mm256_loadu_ps(bone)));
+      columns23 = _mm256_add_ps(columns23,
+                                _mm256_mul_ps(w, _mm256_loadu_ps(bone + 8)));
+      total += weight;
+    }
+    if (total == 0.0f) {
+      columns01 = identity01;
+      columns23 = identity23;
+    }
+    out[i].position = transformAvx(columns01, columns23, vertex.position, 1.0f);
+    out[i].normal = transformAvx(columns01, columns23, vertex.normal, 0.0f);
+    out[i].tangent = transformAvx(columns01, columns23, vertex.tangent, 0.0f);
+    out[i].bitangent =
+        transformAvx(columns01, columns23, vertex.bitangent, 0.0f);
+    finishVertex(vertex, out[i]);
+  }
+}
+#endif
+
+void skinVertices(const std::vector<Vertex> &bindPose,
+                  const std::vector<glm::mat4> &bones,
+                  std::vector<Vertex> &out, JobPool &pool, bool allowAvx) {
+  if (bones.empty()) {
+    // nothing to deform by, the vertices only lose their bone weights
+    out = bindPose;
+    for (size_t i = 0; i < out.size(); i++) {
+      finishVertex(bindPose[i], out[i]);
+    }
+    return;
+  }
+  out.resize(bindPose.size());
+  if (bindPose.empty()) {
+    return;
+  }
+  const Vertex *in = &bindPose[0];
+  const glm::mat4 *palette = &bones[0];
+  size_t boneCount = bones.size();
+  Vertex *result = &out[0];
+
+#ifdef SKINNING_AVX
+  static const bool supported = __builtin_cpu_supports("avx");
+  bool avx = supported && allowAvx;
+#else
+  (void)allowAvx;
+#endif
+  pool.parallelFor(bindPose.size(), SKINNING_GRAIN,
+                   [=](size_t begin, size_t end) {
+#ifdef SKINNING_AVX
+                     if (avx) {
+                       skinRangeAvx(in + begin, palette, boneCount,
+                                    result + begin, end - begin);
+                       return;
+                     }
+#endif
+                     skinRange(in + begin, palette, boneCount,
+                               result + begin, end - begin);
+                   });
+}
+
+void skinModel(Model &model, const std::vector<glm::mat4> &bones,
+               std::vector<Vertex> &scratch, JobPool &pool) {
+  for (unsigned int i = 0; i < model.meshes.size(); i++) {
+    Mesh &mesh = model.meshes[i];
+    if (!mesh.skinned) {
+      continue;
+    }
+    skinVertices(mesh.vertices, bones, scratch, pool);
+    mesh.updateVertices(scratch);
+  }
+}
+
+void restoreBindPose(Model &model) {
+  for (unsigned int i = 0; i < model.meshes.size(); i++) {
+    Mesh &mesh = model.meshes[i];
+    if (mesh.skinned) {
+      mesh.updateVertices(mesh.vertices);
+    }
+  }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "job_pool.h"
+#include "mesh.h"
+#include "model.h"
+
+// Selects where skinned meshes are deformed. GPU skinning reads the bone
+// palette from a BoneBuffer in the vertex shader; CPU skinning deforms the
+// vertices on the job pool and re-uploads them every frame.
+enum SkinningMode { SKINNING_GPU, SKINNING_CPU };
+
+// Deforms bindPose by the bone palette into out, splitting the work across
+// pool. The output vertices carry no bone weights, so drawing them with the
+// skinning shaders does not apply the palette a second time. Influences of
+// bones outside the palette are ignored, an empty palette leaves the bind
+// pose. Uses AVX when the CPU supports it, unless allowAvx is false.
+void skinVertices(const std::vector<Vertex> &bindPose,
+                  const std::vector<glm::mat4> &bones,
+                  std::vector<Vertex> &out, JobPool &pool,
+                  bool allowAvx = true);
+
+// CPU skins every skinned mesh of model with the bone palette and uploads the
+// result. scratch is reused between calls to avoid reallocating.
+void skinModel(Model &model, const std::vector<glm::mat4> &bones,
+               std::vector<Vertex> &scratch, JobPool &pool);
+
+// Re-uploads the bind pose of every skinned mesh, for switching back to GPU
+// skinning after skinModel was used
+void restoreBindPose(Model &model);
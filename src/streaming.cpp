@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "frame_arena.h"
+#include "job_pool.h"
+#include "model.h"
+#include "streaming.h"
+#include "telemetry.h"
+
+StreamingManager::StreamingManager()
+    : cpuBudgetBytes(DEFAULT_STREAMING_CPU_BUDGET),
+      gpuBudgetBytes(DEFAULT_STREAMING_GPU_BUDGET),
+      loadDistance(DEFAULT_STREAMING_LOAD_DISTANCE),
+      unloadDistance(DEFAULT_STREAMING_UNLOAD_DISTANCE), textureArrays(false),
+      frame(0), importing(0), residentCpuBytes(0), residentGpuBytes(0),
+      loader(1) {}
+
+StreamingManager::~StreamingManager() {
+  loader.wait();
+  for (unsigned int i = 0; i < models.size(); i++) {
+    if (models[i]->state == RESIDENT) {
+      models[i]->model->release();
+    }
+  }
+  telemetry().loadQueueDepth -= importing;
+}
+
+unsigned int StreamingManager::add(const std::string &path,
+                                   const glm::mat4 &transform,
+                                   const AABB &bounds, float priority) {
+  std::unique_ptr<StreamedModel> streamed(new StreamedModel());
+  streamed->path = path;
+  streamed->transform = transform;
+  AABB placed = transformBounds(bounds, transform);
+  streamed->center = (placed.min + placed.max) * 0.5f;
+  streamed->radius = glm::length(placed.max - placed.min) * 0.5f;
+  streamed->priority = std::max(priority, 0.001f);
+  streamed->state = UNLOADED;
+  streamed->lastUsed = 0;
+  streamed->rank = 0.0f;
+  streamed->cpuBytes = 0;
+  streamed->gpuBytes = 0;
+  models.push_back(std::move(streamed));
+  return models.size() - 1;
+}
+
+Model *StreamingManager::use(unsigned int handle) {
+  StreamedModel &streamed = *models[handle];
+  if (streamed.state != RESIDENT) {
+    return NULL;
+  }
+  streamed.lastUsed = frame;
+  return streamed.model.get();
+}
+
+void StreamingManager::startImport(StreamedModel &streamed) {
+  streamed.model.reset(new Model());
+  streamed.model->textureArrays = textureArrays;
+  streamed.state = IMPORTING;
+  importing++;
+  telemetry().loadQueueDepth++;
+  StreamedModel *target = &streamed;
+  loader.submit([target]() {
+    bool imported = target->model->import(target->path);
+    target->state.store(imported ? IMPORTED : IMPORT_FAILED,
+                        std::memory_order_release);
+  });
+}
+
+void StreamingManager::finishImport(StreamedModel &streamed) {
+  importing--;
+  telemetry().loadQueueDepth--;
+  if (streamed.state == IMPORT_FAILED) {
+    // not retried, the file won't be any different next time
+    std::cout << "ERROR::STREAMING:: can't load " << streamed.path
+              << std::endl;
+    streamed.model.reset();
+    streamed.state = FAILED;
+    return;
+  }
+  streamed.cpuBytes = streamed.model->cpuBytes();
+  residentCpuBytes += streamed.cpuBytes;
+  streamed.state = READY;
+}
+
+void StreamingManager::unload(StreamedModel &streamed) {
+  if (streamed.state == RESIDENT) {
+    streamed.model->release();
+  }
+  streamed.model.reset();
+  residentCpuBytes -= streamed.cpuBytes;
+  residentGpuBytes -= streamed.gpuBytes;
+  streamed.cpuBytes = 0;
+  streamed.gpuBytes = 0;
+  streamed.state = UNLOADED;
+}
+
+bool StreamingManager::nearerFirst(const StreamedModel *a,
+                                   const StreamedModel *b) {
+  return a->rank < b->rank;
+}
+
+bool StreamingManager::enforceBudgets(size_t extraCpuBytes,
+                                      size_t extraGpuBytes,
+                                      const StreamedModel &candidate) {
+  while (residentCpuBytes + extraCpuBytes > cpuBudgetBytes ||
+         residentGpuBytes + extraGpuBytes > gpuBudgetBytes) {
+    // models drawn last frame stay, releasing them would only reload them
+    StreamedModel *oldest = NULL;
+    for (unsigned int i = 0; i < models.size(); i++) {
+      StreamedModel &streamed = *models[i];
+      if (streamed.state == RESIDENT && streamed.lastUsed + 1 < frame &&
+          (!oldest || streamed.lastUsed < oldest->lastUsed)) {
+        oldest = &streamed;
+      }
+    }
+    if (oldest) {
+      unload(*oldest);
+      continue;
+    }
+    if (residentCpuBytes + extraCpuBytes <= cpuBudgetBytes) {
+      return false;
+    }
+    // decoded imports only hold CPU memory. Those nearer than candidate
+    // stay, dropping them for it would just swap one for the other.
+    StreamedModel *farthest = NULL;
+    for (unsigned int i = 0; i < models.size(); i++) {
+      StreamedModel &streamed = *models[i];
+      if (streamed.state == READY && streamed.rank > candidate.rank &&
+          (!farthest || streamed.rank > farthest->rank)) {
+        farthest = &streamed;
+      }
+    }
+    if (!farthest) {
+      return false;
+    }
+    unload(*farthest);
+  }
+  return true;
+}
+
+void StreamingManager::update(const glm::vec3 &cameraPosition) {
+  frame++;
+
+  // distance from the camera to the bounding sphere, scaled by priority
+  for (unsigned int i = 0; i < models.size(); i++) {
+    StreamedModel &streamed = *models[i];
+    float distance = std::max(
+        glm::length(streamed.center - cameraPosition) - streamed.radius,
+        0.0f);
+    streamed.rank = distance / streamed.priority;
+  }
+
+  for (unsigned int i = 0; i < models.size(); i++) {
+    StreamedModel &streamed = *models[i];
+    int state = streamed.state.load(std::memory_order_acquire);
+    if (state == IMPORTED || state == IMPORT_FAILED) {
+      finishImport(streamed);
+    }
+    // models out of range go, unless they are still being imported
+    if ((streamed.state == READY || streamed.state == RESIDENT) &&
+        streamed.rank > unloadDistance) {
+      unload(streamed);
+    }
+  }
+
+  FrameVector<StreamedModel *> ready;
+  FrameVector<StreamedModel *> wanted;
+  for (unsigned int i = 0; i < models.size(); i++) {
+    StreamedModel &streamed = *models[i];
+    if (streamed.state == READY) {
+      ready.push_back(&streamed);
+    } else if (streamed.state == UNLOADED && streamed.rank < loadDistance) {
+      wanted.push_back(&streamed);
+    }
+  }
+
+  // uploads, the nearest first. Their video memory isn't known before they
+  // are uploaded, the decoded textures and vertices are a close estimate.
+  std::sort(ready.begin(), ready.end(), nearerFirst);
+  for (unsigned int i = 0; i < ready.size() && i < MAX_STREAMING_UPLOADS;
+       i++) {
+    StreamedModel &streamed = *ready[i];
+    // dropped to make room for a nearer one
+    if (streamed.state != READY) {
+      continue;
+    }
+    if (!enforceBudgets(0, streamed.cpuBytes, streamed)) {
+      // waits for memory to be freed, keeping what it has decoded
+      break;
+    }
+    streamed.model->upload();
+    residentCpuBytes -= streamed.cpuBytes;
+    streamed.cpuBytes = streamed.model->cpuBytes();
+    streamed.gpuBytes = streamed.model->gpuBytes();
+    residentCpuBytes += streamed.cpuBytes;
+    residentGpuBytes += streamed.gpuBytes;
+    streamed.state = RESIDENT;
+  }
+
+  // imports, the nearest first, as long as there's room for more
+  std::sort(wanted.begin(), wanted.end(), nearerFirst);
+  for (unsigned int i = 0;
+       i < wanted.size() && importing < MAX_STREAMING_IMPORTS; i++) {
+    if (!enforceBudgets(0, 0, *wanted[i])) {
+      break;
+    }
+    startImport(*wanted[i]);
+  }
+}
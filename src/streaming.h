@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "job_pool.h"
+#include "model.h"
+
+// Default memory budgets for streamed models
+const size_t DEFAULT_STREAMING_CPU_BUDGET = 512u << 20;
+const size_t DEFAULT_STREAMING_GPU_BUDGET = 512u << 20;
+// Models closer than this are requested, farther than the unload distance
+// they are released. The gap keeps models at the edge from reloading all the
+// time.
+const float DEFAULT_STREAMING_LOAD_DISTANCE = 30.0f;
+const float DEFAULT_STREAMING_UNLOAD_DISTANCE = 40.0f;
+// imports queued on the loader thread at once
+const unsigned int MAX_STREAMING_IMPORTS = 2;
+// models uploaded per frame, each one stalls the render thread
+const unsigned int MAX_STREAMING_UPLOADS = 1;
+
+// Loads and unloads models placed in the world as the camera moves. Imports
+// run on a loader thread of their own, only the uploads happen on the render
+// thread. The nearest models, weighted by priority, are loaded first; when
+// a budget is exceeded the least recently drawn ones are released, then
+// the farthest imports waiting for upload.
+class StreamingManager {
+public:
+  size_t cpuBudgetBytes;
+  size_t gpuBudgetBytes;
+  float loadDistance;
+  float unloadDistance;
+  // whether models are imported with their textures packed into arrays, see
+  // Model::textureArrays
+  bool textureArrays;
+
+  StreamingManager();
+  ~StreamingManager();
+
+  // Places a model whose meshes lie within bounds in its own space. Higher
+  // priorities load from farther away. Returns its handle.
+  unsigned int add(const std::string &path, const glm::mat4 &transform,
+                   const AABB &bounds, float priority = 1.0f);
+
+  unsigned int size() const { return models.size(); }
+  const glm::mat4 &transform(unsigned int handle) const {
+    return models[handle]->transform;
+  }
+  // the sphere around the placed model's bounds, in world space
+  const glm::vec3 &center(unsigned int handle) const {
+    return models[handle]->center;
+  }
+  float radius(unsigned int handle) const { return models[handle]->radius; }
+
+  // Starts imports, uploads finished ones and releases models. Call once per
+  // frame on the render thread.
+  void update(const glm::vec3 &cameraPosition);
+
+  // The model if it is resident, marking it as used this frame. NULL while
+  // it is loading or unloaded, a proxy has to be drawn instead.
+  Model *use(unsigned int handle);
+
+  // memory held by streamed models, including imports waiting for upload
+  size_t cpuBytes() const { return residentCpuBytes; }
+  size_t gpuBytes() const { return residentGpuBytes; }
+
+private:
+  // IMPORTED and IMPORT_FAILED are set by the loader thread, the render
+  // thread accounts for the result and moves on to READY or FAILED
+  enum State {
+    UNLOADED,
+    IMPORTING,
+    IMPORTED,
+    IMPORT_FAILED,
+    READY,
+    FAILED,
+    RESIDENT
+  };
+
+  struct StreamedModel {
+    std::string path;
+    glm::mat4 transform;
+    glm::vec3 center;
+    float radius;
+    float priority;
+    // written by the loader thread once the import is done
+    std::atomic<int> state;
+    std::unique_ptr<Model> model;
+    unsigned long long lastUsed;
+    // distance to the camera divided by priority, lower loads first
+    float rank;
+    size_t cpuBytes;
+    size_t gpuBytes;
+  };
+
+  std::vector<std::unique_ptr<StreamedModel> > models;
+  unsigned long long frame;
+  unsigned int importing;
+  size_t residentCpuBytes;
+  size_t residentGpuBytes;
+  // declared last, so it finishes the queued imports before the models go
+  JobPool loader;
+
+  static bool nearerFirst(const StreamedModel *a, const StreamedModel *b);
+  void startImport(StreamedModel &streamed);
+  void finishImport(StreamedModel &streamed);
+  void unload(StreamedModel &streamed);
+  // Releases the least recently used models until the budgets are met,
+  // keeping the ones drawn last frame. If the CPU budget is still exceeded,
+  // imports waiting for upload farther away than candidate are dropped, the
+  // farthest first. Returns false if that isn't enough.
+  bool enforceBudgets(size_t extraCpuBytes, size_t extraGpuBytes,
+                      const StreamedModel &candidate);
+
+  StreamingManager(const StreamingManager &);
+  StreamingManager &operator=(const StreamingManager &);
+};
@@ -0,0 +1,236 @@
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "telemetry.h"
+
+const double FRAME_TIME_BUCKET_BOUNDS[FRAME_TIME_BUCKETS] = {
+    0.002, 0.004, 0.008, 0.012, 0.0167, 0.025, 0.0333, 0.05, 0.1, 0.25};
+
+// how often the server checks whether it should stop, and how long it waits
+// for an HTTP request line before answering with bare text
+const int TELEMETRY_POLL_MILLISECONDS = 200;
+const int TELEMETRY_REQUEST_MILLISECONDS = 50;
+
+RenderStats renderStats = {0, 0, 0};
+
+Histogram::Histogram() : sumNanoseconds(0) {
+  for (unsigned int i = 0; i <= FRAME_TIME_BUCKETS; i++) {
+    buckets[i].store(0, std::memory_order_relaxed);
+  }
+}
+
+void Histogram::observe(double seconds) {
+  unsigned int bucket = 0;
+  while (bucket < FRAME_TIME_BUCKETS &&
+         seconds > FRAME_TIME_BUCKET_BOUNDS[bucket]) {
+    bucket++;
+  }
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  sumNanoseconds.fetch_add((uint64_t)(seconds * 1e9),
+                           std::memory_order_relaxed);
+}
+
+void Histogram::write(std::ostringstream &out, const char *name,
+                      const char *help) const {
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " histogram\n";
+  uint64_t cumulative = 0;
+  for (unsigned int i = 0; i <= FRAME_TIME_BUCKETS; i++) {
+    cumulative += buckets[i].load(std::memory_order_relaxed);
+    out << name << "_bucket{le=\"";
+    if (i < FRAME_TIME_BUCKETS) {
+      out << FRAME_TIME_BUCKET_BOUNDS[i];
+    } else {
+      out << "+Inf";
+    }
+    out << "\"} " << cumulative << "\n";
+  }
+  out << name << "_sum "
+      << sumNanoseconds.load(std::memory_order_relaxed) * 1e-9 << "\n";
+  // counted from the buckets so it always matches the +Inf bucket
+  out << name << "_count " << cumulative << "\n";
+}
+
+Telemetry::Telemetry()
+    : frames(0), drawCalls(0), stateChanges(0), triangles(0),
+      frameDrawCalls(0), frameStateChanges(0), frameTriangles(0), textures(0),
+      textureBytes(0), meshes(0), meshBytes(0), programs(0),
+      loadQueueDepth(0), frameArenaBytes(0), frameArenaPeakBytes(0),
+      frameArenaOverflows(0) {}
+
+void Telemetry::endFrame(double frameSeconds, double gpuSeconds) {
+  frameTime.observe(frameSeconds);
+  if (gpuSeconds >= 0.0) {
+    gpuFrameTime.observe(gpuSeconds);
+  }
+  frames.fetch_add(1, std::memory_order_relaxed);
+  drawCalls.fetch_add(renderStats.drawCalls, std::memory_order_relaxed);
+  stateChanges.fetch_add(renderStats.stateChanges, std::memory_order_relaxed);
+  triangles.fetch_add(renderStats.triangles, std::memory_order_relaxed);
+  frameDrawCalls.store(renderStats.drawCalls, std::memory_order_relaxed);
+  frameStateChanges.store(renderStats.stateChanges,
+                          std::memory_order_relaxed);
+  frameTriangles.store(renderStats.triangles, std::memory_order_relaxed);
+  renderStats.drawCalls = 0;
+  renderStats.stateChanges = 0;
+  renderStats.triangles = 0;
+}
+
+template <typename T>
+static void writeMetric(std::ostringstream &out, const char *name,
+                        const char *type, const char *help,
+                        const std::atomic<T> &value) {
+  out << "# HELP " << name << " " << help << "\n";
+  out << "# TYPE " << name << " " << type << "\n";
+  out << name << " " << value.load(std::memory_order_relaxed) << "\n";
+}
+
+std::string Telemetry::format() const {
+  std::ostringstream out;
+  frameTime.write(out, "learnopengl_frame_time_seconds",
+                  "CPU time between frames.");
+  gpuFrameTime.write(out, "learnopengl_gpu_frame_time_seconds",
+                     "GPU time spent rendering a frame.");
+  writeMetric(out, "learnopengl_frames_total", "counter",
+              "Frames rendered.", frames);
+  writeMetric(out, "learnopengl_draw_calls_total", "counter",
+              "Draw calls submitted.", drawCalls);
+  writeMetric(out, "learnopengl_state_changes_total", "counter",
+              "Program, vertex array and texture binds.", stateChanges);
+  writeMetric(out, "learnopengl_triangles_total", "counter",
+              "Triangles submitted.", triangles);
+  writeMetric(out, "learnopengl_frame_draw_calls", "gauge",
+              "Draw calls submitted in the last frame.", frameDrawCalls);
+  writeMetric(out, "learnopengl_frame_state_changes", "gauge",
+              "State changes in the last frame.", frameStateChanges);
+  writeMetric(out, "learnopengl_frame_triangles", "gauge",
+              "Triangles submitted in the last frame.", frameTriangles);
+  writeMetric(out, "learnopengl_textures", "gauge", "Resident textures.",
+              textures);
+  writeMetric(out, "learnopengl_texture_bytes", "gauge",
+              "Estimated video memory used by textures.", textureBytes);
+  writeMetric(out, "learnopengl_meshes", "gauge", "Resident meshes.",
+              meshes);
+  writeMetric(out, "learnopengl_mesh_bytes", "gauge",
+              "Video memory used by vertex and index buffers.", meshBytes);
+  writeMetric(out, "learnopengl_programs", "gauge",
+              "Linked shader programs.", programs);
+  writeMetric(out, "learnopengl_asset_load_queue_depth", "gauge",
+              "Assets requested but not loaded yet.", loadQueueDepth);
+  writeMetric(out, "learnopengl_frame_arena_bytes", "gauge",
+              "Frame arena memory used by the last frame.", frameArenaBytes);
+  writeMetric(out, "learnopengl_frame_arena_peak_bytes", "gauge",
+              "Most frame arena memory used by a frame.", frameArenaPeakBytes);
+  writeMetric(out, "learnopengl_frame_arena_overflows_total", "counter",
+              "Frame arena allocations that fell back to the heap.",
+              frameArenaOverflows);
+  return out.str();
+}
+
+Telemetry &telemetry() {
+  static Telemetry instance;
+  return instance;
+}
+
+TelemetryServer::TelemetryServer(const std::string &socketPath)
+    : socketPath(socketPath), listenSocket(-1), stopping(false) {
+  sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (socketPath.size() >= sizeof(address.sun_path)) {
+    std::cout << "ERROR::TELEMETRY:: socket path too long: " << socketPath
+              << std::endl;
+    return;
+  }
+  std::strcpy(address.sun_path, socketPath.c_str());
+
+  listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenSocket < 0) {
+    std::cout << "ERROR::TELEMETRY:: can't create socket: "
+              << std::strerror(errno) << std::endl;
+    return;
+  }
+  // a socket file left behind by a previous run would make bind fail
+  unlink(socketPath.c_str());
+  if (bind(listenSocket, (sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(listenSocket, 4) < 0) {
+    std::cout << "ERROR::TELEMETRY:: can't listen on " << socketPath << ": "
+              << std::strerror(errno) << std::endl;
+    close(listenSocket);
+    listenSocket = -1;
+    return;
+  }
+  std::cout << "Serving telemetry on " << socketPath << std::endl;
+  thread = std::thread(&TelemetryServer::serve, this);
+}
+
+TelemetryServer::~TelemetryServer() {
+  stopping = true;
+  if (thread.joinable()) {
+    thread.join();
+  }
+  if (listenSocket >= 0) {
+    close(listenSocket);
+    unlink(socketPath.c_str());
+  }
+}
+
+void TelemetryServer::serve() {
+  while (!stopping) {
+    pollfd listening = {listenSocket, POLLIN, 0};
+    if (poll(&listening, 1, TELEMETRY_POLL_MILLISECONDS) <= 0) {
+      continue;
+    }
+    int client = accept(listenSocket, NULL, NULL);
+    if (client < 0) {
+      continue;
+    }
+    respond(client);
+    close(client);
+  }
+}
+
+void TelemetryServer::respond(int client) {
+  // HTTP clients send their request right away, bare text clients nothing
+  char request[512];
+  ssize_t received = 0;
+  pollfd readable = {client, POLLIN, 0};
+  if (poll(&readable, 1, TELEMETRY_REQUEST_MILLISECONDS) > 0) {
+    received = recv(client, request, sizeof(request) - 1, 0);
+  }
+  bool http = received >= 4 && std::memcmp(request, "GET ", 4) == 0;
+
+  std::string body = telemetry().format();
+  std::string response;
+  if (http) {
+    std::ostringstream header;
+    header << "HTTP/1.0 200 OK\r\n"
+           << "Content-Type: text/plain; version=0.0.4\r\n"
+           << "Content-Length: " << body.size() << "\r\n"
+           << "Connection: close\r\n\r\n";
+    response = header.str();
+  }
+  response += body;
+
+  const char *data = response.data();
+  size_t remaining = response.size();
+  while (remaining > 0) {
+    ssize_t sent = send(client, data, remaining, MSG_NOSIGNAL);
+    if (sent <= 0) {
+      return;
+    }
+    data += sent;
+    remaining -= sent;
+  }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <sstream>
+#include <string>
+#include <thread>
+
+// Environment variable naming the Unix socket path to serve telemetry on.
+// Telemetry is only served when it is set.
+const char *const TELEMETRY_SOCKET_VARIABLE = "LEARNOPENGL_TELEMETRY_SOCKET";
+
+// Upper bounds of the frame time histogram buckets in seconds, an implicit
+// +Inf bucket follows
+const unsigned int FRAME_TIME_BUCKETS = 10;
+extern const double FRAME_TIME_BUCKET_BOUNDS[FRAME_TIME_BUCKETS];
+
+// Work submitted during the current frame. Only touched by the render
+// thread, so counting costs a plain increment; Telemetry::endFrame publishes
+// it once per frame.
+struct RenderStats {
+  unsigned int drawCalls;
+  // program, VAO and texture binds
+  unsigned int stateChanges;
+  uint64_t triangles;
+};
+
+extern RenderStats renderStats;
+
+// A Prometheus style histogram of durations. Observing is lock-free; the
+// buckets are relaxed atomics read one at a time, so a concurrent reader may
+// see a sum one observation ahead of the buckets.
+class Histogram {
+public:
+  Histogram();
+
+  void observe(double seconds);
+
+  // appends the histogram in the Prometheus text format
+  void write(std::ostringstream &out, const char *name,
+             const char *help) const;
+
+private:
+  // not cumulative, the last one is the +Inf bucket
+  std::atomic<uint64_t> buckets[FRAME_TIME_BUCKETS + 1];
+  std::atomic<uint64_t> sumNanoseconds;
+
+  Histogram(const Histogram &);
+  Histogram &operator=(const Histogram &);
+};
+
+// Process wide counters. Writers update them with relaxed atomic operations
+// and never wait for readers.
+struct Telemetry {
+  Histogram frameTime;
+  Histogram gpuFrameTime;
+
+  // totals since startup
+  std::atomic<uint64_t> frames;
+  std::atomic<uint64_t> drawCalls;
+  std::atomic<uint64_t> stateChanges;
+  std::atomic<uint64_t> triangles;
+  // of the last completed frame
+  std::atomic<uint64_t> frameDrawCalls;
+  std::atomic<uint64_t> frameStateChanges;
+  std::atomic<uint64_t> frameTriangles;
+
+  // resident GPU resources, with estimated sizes in bytes
+  std::atomic<int64_t> textures;
+  std::atomic<int64_t> textureBytes;
+  std::atomic<int64_t> meshes;
+  std::atomic<int64_t> meshBytes;
+  std::atomic<int64_t> programs;
+
+  // assets requested but not loaded yet
+  std::atomic<int64_t> loadQueueDepth;
+
+  // frame arena use, see resetFrameArenas
+  std::atomic<uint64_t> frameArenaBytes;
+  std::atomic<uint64_t> frameArenaPeakBytes;
+  std::atomic<uint64_t> frameArenaOverflows;
+
+  Telemetry();
+
+  // Publishes and resets renderStats. gpuSeconds is negative when no GPU
+  // time was measured for the frame.
+  void endFrame(double frameSeconds, double gpuSeconds);
+
+  // all counters in the Prometheus text exposition format
+  std::string format() const;
+
+private:
+  Telemetry(const Telemetry &);
+  Telemetry &operator=(const Telemetry &);
+};
+
+Telemetry &telemetry();
+
+// Serves telemetry().format() on a Unix domain socket from a thread of its
+// own. Every connection gets one snapshot. A plain HTTP response is sent when
+// the client speaks HTTP (curl --unix-socket, or a proxy Prometheus scrapes),
+// otherwise the bare text (socat, nc -U).
+class TelemetryServer {
+public:
+  explicit TelemetryServer(const std::string &socketPath);
+  ~TelemetryServer();
+
+  bool running() const { return listenSocket >= 0; }
+
+private:
+  std::string socketPath;
+  int listenSocket;
+  std::atomic<bool> stopping;
+  std::thread thread;
+
+  void serve();
+  void respond(int client);
+
+  TelemetryServer(const TelemetryServer &);
+  TelemetryServer &operator=(const TelemetryServer &);
+};
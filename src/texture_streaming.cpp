@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "frame_arena.h"
+#include "job_pool.h"
+#include "material_arrays.h"
+#include "model.h"
+#include "scene_graph.h"
+#include "telemetry.h"
+#include "texture_streaming.h"
+
+int requiredMipLevel(float uvDensity, int textureSize, float distance,
+                     float pixelScale) {
+  float texelsPerUnit = uvDensity * textureSize;
+  float pixelsPerUnit =
+      pixelScale / std::max(distance, MIN_TEXTURE_STREAMING_DISTANCE);
+  if (texelsPerUnit <= 0.0f) {
+    // no texture space to speak of, a single texel does
+    return 1 << 30;
+  }
+  if (texelsPerUnit <= pixelsPerUnit) {
+    return 0;
+  }
+  // trilinear filtering blends the level below log2 with the one above
+  return (int)std::floor(std::log2(texelsPerUnit / pixelsPerUnit));
+}
+
+TextureStreamer::TextureStreamer()
+    : budgetBytes(DEFAULT_TEXTURE_STREAMING_BUDGET), frame(0),
+      reservedBytes(0), loader(1) {}
+
+TextureStreamer::~TextureStreamer() {
+  loader.wait();
+  for (unsigned int i = 0; i < loads.size(); i++) {
+    telemetry().loadQueueDepth--;
+  }
+}
+
+TextureStreamer &textureStreamer() {
+  static TextureStreamer instance;
+  return instance;
+}
+
+void TextureStreamer::add(MaterialArrays &arrays) {
+  registered.push_back(&arrays);
+}
+
+void TextureStreamer::remove(MaterialArrays &arrays) {
+  registered.erase(std::remove(registered.begin(), registered.end(), &arrays),
+                   registered.end());
+  // the loads finish anyway, their levels are thrown away
+  for (unsigned int i = 0; i < loads.size(); i++) {
+    if (loads[i]->target == &arrays) {
+      loads[i]->target = NULL;
+    }
+  }
+}
+
+size_t TextureStreamer::residentBytes() const {
+  size_t total = 0;
+  for (unsigned int i = 0; i < registered.size(); i++) {
+    total += registered[i]->bytes();
+  }
+  return total;
+}
+
+void TextureStreamer::request(Model &model, const glm::mat4 &transform,
+                              const glm::vec3 &eye, float pixelScale,
+                              const Frustum *frustum) {
+  if (!model.textureArrays) {
+    return;
+  }
+  MaterialArrays &arrays = model.materialArrays;
+  glm::mat4 world;
+  for (unsigned int i = 0; i < model.meshes.size(); i++) {
+    const Mesh &mesh = model.meshes[i];
+    if (!mesh.layered) {
+      continue;
+    }
+    // the same transform Model::Draw uses
+    if (mesh.skinned) {
+      world = transform;
+    } else {
+      multiplyMatrices(transform, model.nodes.getWorld(model.meshNodes[i]),
+                       world);
+    }
+    AABB bounds = transformBounds(mesh.bounds, world);
+    if (frustum && !isVisible(*frustum, bounds)) {
+      continue;
+    }
+    // the nearest point of the bounds, the eye itself if it's inside
+    float distance =
+        glm::length(glm::clamp(eye, bounds.min, bounds.max) - eye);
+    float scale =
+        std::cbrt(std::abs(glm::determinant(glm::mat3(world))));
+    if (scale <= 0.0f) {
+      continue;
+    }
+    float density = mesh.uvDensity / scale;
+    for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPES; type++) {
+      MaterialArrays::Array &array = arrays.arrays[type];
+      if (array.texture == 0 ||
+          mesh.materialLayers[type] == NO_MATERIAL_LAYER) {
+        continue;
+      }
+      int level = requiredMipLevel(
+          density, std::max(array.width, array.height), distance, pixelScale);
+      array.neededLevel = std::min(array.neededLevel, level);
+      array.lastNeeded = frame;
+    }
+  }
+}
+
+void TextureStreamer::finishLoad(MipLoad &load) {
+  reservedBytes -= load.bytes;
+  telemetry().loadQueueDepth--;
+  if (!load.target) {
+    return;
+  }
+  MaterialArrays::Array &array = load.target->arrays[load.type];
+  array.loading = false;
+  // levels dropped while the load ran leave a gap to the base level
+  if (load.lastLevel + 1 < array.baseLevel) {
+    return;
+  }
+  // keeps the part that isn't resident already
+  int count = array.baseLevel - load.firstLevel;
+  if (count <= 0) {
+    return;
+  }
+  load.levels.resize(count);
+  load.target->uploadLevels(load.type, load.firstLevel, load.levels);
+}
+
+void TextureStreamer::startLoad(MaterialArrays &arrays, unsigned int type,
+                                int firstLevel) {
+  MaterialArrays::Array &array = arrays.arrays[type];
+  std::shared_ptr<MipLoad> load(new MipLoad());
+  load->target = &arrays;
+  load->type = type;
+  load->files = array.files;
+  load->width = array.width;
+  load->height = array.height;
+  load->firstLevel = firstLevel;
+  load->lastLevel = array.baseLevel - 1;
+  load->bytes = 0;
+  for (int level = firstLevel; level < array.baseLevel; level++) {
+    load->bytes += arrays.levelBytes(type, level);
+  }
+  load->done = false;
+  array.loading = true;
+  reservedBytes += load->bytes;
+  telemetry().loadQueueDepth++;
+  loads.push_back(load);
+  loader.submit([load]() {
+    decodeMipLevels(load->files, load->width, load->height, load->firstLevel,
+                    load->lastLevel, load->levels, sharedJobPool());
+    load->done.store(true, std::memory_order_release);
+  });
+}
+
+bool TextureStreamer::makeRoom(long long extraBytes) {
+  while ((long long)residentBytes() + reservedBytes + extraBytes >
+         (long long)budgetBytes) {
+    MaterialArrays *victim = NULL;
+    unsigned int victimType = 0;
+    for (unsigned int i = 0; i < registered.size(); i++) {
+      for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPES; type++) {
+        const MaterialArrays::Array &array = registered[i]->arrays[type];
+        if (array.texture == 0 || array.loading ||
+            array.baseLevel >= array.neededLevel ||
+            array.baseLevel + 1 >= array.levels) {
+          continue;
+        }
+        if (!victim ||
+            array.lastNeeded < victim->arrays[victimType].lastNeeded) {
+          victim = registered[i];
+          victimType = type;
+        }
+      }
+    }
+    if (!victim) {
+      return false;
+    }
+    victim->evictBaseLevel(victimType);
+  }
+  return true;
+}
+
+// an array waiting for finer levels, ordered by how many it lacks
+struct WantedLevels {
+  MaterialArrays *arrays;
+  unsigned int type;
+  int missing;
+};
+
+static bool mostMissingFirst(const WantedLevels &a, const WantedLevels &b) {
+  return a.missing > b.missing;
+}
+
+void TextureStreamer::update() {
+  for (unsigned int i = 0; i < loads.size();) {
+    if (loads[i]->done.load(std::memory_order_acquire)) {
+      finishLoad(*loads[i]);
+      loads.erase(loads.begin() + i);
+    } else {
+      i++;
+    }
+  }
+
+  // the requests made since the last update
+  FrameVector<WantedLevels> wanted;
+  for (unsigned int i = 0; i < registered.size(); i++) {
+    for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPES; type++) {
+      const MaterialArrays::Array &array = registered[i]->arrays[type];
+      if (array.texture != 0 && !array.loading &&
+          array.neededLevel < array.baseLevel) {
+        WantedLevels levels;
+        levels.arrays = registered[i];
+        levels.type = type;
+        levels.missing = array.baseLevel - array.neededLevel;
+        wanted.push_back(levels);
+      }
+    }
+  }
+  makeRoom(0);
+
+  std::sort(wanted.begin(), wanted.end(), mostMissingFirst);
+  for (unsigned int i = 0;
+       i < wanted.size() && loads.size() < MAX_TEXTURE_STREAMING_LOADS; i++) {
+    MaterialArrays &arrays = *wanted[i].arrays;
+    const MaterialArrays::Array &array = arrays.arrays[wanted[i].type];
+    // as many of the levels as fit, coarser ones first
+    int firstLevel = std::max(array.neededLevel, 0);
+    long long bytes = 0;
+    for (int level = firstLevel; level < array.baseLevel; level++) {
+      bytes += arrays.levelBytes(wanted[i].type, level);
+    }
+    while (firstLevel < array.baseLevel && !makeRoom(bytes)) {
+      bytes -= arrays.levelBytes(wanted[i].type, firstLevel);
+      firstLevel++;
+    }
+    if (firstLevel < array.baseLevel) {
+      startLoad(arrays, wanted[i].type, firstLevel);
+    }
+  }
+
+  frame++;
+  for (unsigned int i = 0; i < registered.size(); i++) {
+    for (unsigned int type = 0; type < MATERIAL_TEXTURE_TYPES; type++) {
+      MaterialArrays::Array &array = registered[i]->arrays[type];
+      array.neededLevel = array.levels;
+    }
+  }
+}
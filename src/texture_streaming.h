@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "culling.h"
+#include "job_pool.h"
+#include "material_arrays.h"
+#include "model.h"
+
+// Default video memory budget for the mip levels of all material arrays
+const size_t DEFAULT_TEXTURE_STREAMING_BUDGET = 256u << 20;
+// mip loads decoding on the loader thread at once
+const unsigned int MAX_TEXTURE_STREAMING_LOADS = 2;
+// closest distance a surface is assumed to be at, about the near plane
+const float MIN_TEXTURE_STREAMING_DISTANCE = 0.1f;
+
+// Finest mip level a texture of textureSize texels needs on a surface with
+// uvDensity texture coordinate units per unit of length, at distance from a
+// camera showing pixelScale pixels per unit of length at distance 1. The
+// surface is assumed to face the camera. 0 is the full size, the result may
+// exceed the levels the texture has.
+int requiredMipLevel(float uvDensity, int textureSize, float distance,
+                     float pixelScale);
+
+// Streams the mip levels of MaterialArrays. Models report the levels they
+// need as they are drawn, estimated on the CPU from the projected texel
+// density of their meshes. Finer levels are decoded from disk on a loader
+// thread and uploaded on the render thread. Under the budget, levels finer
+// than needed stay resident; above it the ones needed least recently go
+// first. Levels still needed are never dropped, loads wait for room instead.
+class TextureStreamer {
+public:
+  size_t budgetBytes;
+
+  TextureStreamer();
+  ~TextureStreamer();
+
+  // called by MaterialArrays as its arrays are uploaded and released
+  void add(MaterialArrays &arrays);
+  void remove(MaterialArrays &arrays);
+
+  // Asks for the levels the model's meshes need, drawn with transform and
+  // seen from eye with pixelScale pixels per unit of length at distance 1.
+  // Meshes outside frustum, if given, ask for nothing.
+  void request(Model &model, const glm::mat4 &transform, const glm::vec3 &eye,
+               float pixelScale, const Frustum *frustum = NULL);
+
+  // Uploads finished loads, frees levels over the budget and starts loads
+  // for the requests since the last update. Call once per frame on the
+  // render thread.
+  void update();
+
+  // video memory of the resident levels of all arrays
+  size_t residentBytes() const;
+
+private:
+  // levels firstLevel to lastLevel of one array, decoded by the loader
+  // thread. target is cleared if the arrays are released meanwhile.
+  struct MipLoad {
+    MaterialArrays *target;
+    unsigned int type;
+    std::vector<std::string> files;
+    int width;
+    int height;
+    int firstLevel;
+    int lastLevel;
+    long long bytes;
+    std::vector<LayerImages> levels;
+    std::atomic<bool> done;
+  };
+
+  std::vector<MaterialArrays *> registered;
+  std::vector<std::shared_ptr<MipLoad> > loads;
+  unsigned long long frame;
+  // video memory the loads in flight will take
+  long long reservedBytes;
+  // declared last, so it finishes the queued loads before the rest goes
+  JobPool loader;
+
+  void finishLoad(MipLoad &load);
+  void startLoad(MaterialArrays &arrays, unsigned int type, int firstLevel);
+  // drops levels finer than needed, the least recently needed first, until
+  // extraBytes fit the budget. Returns false if that isn't enough.
+  bool makeRoom(long long extraBytes);
+
+  TextureStreamer(const TextureStreamer &);
+  TextureStreamer &operator=(const TextureStreamer &);
+};
+
+// streamer of all MaterialArrays
+TextureStreamer &textureStreamer();